@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Defs.hpp"
+
+#include <memory>
+#include <new>
+#include <vector>
+#include <span>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+namespace FileFormats
+{
+
+//Deleter used for objects that may live in an Arena. Arena allocated objects
+//only get destroyed, their memory is released together with the arena.
+//Objects allocated with plain new (ArenaOwned == false) are deleted as usual.
+//
+//Only the objects themselves (constants, attributes) and copied bytes live in
+//the arena. Their destructors still run one by one, and the std::vectors they
+//hold (tables of attributes, methods, fields, the constant pool) still
+//allocate from the global heap. Moving those onto the arena would take
+//allocator aware (std::pmr) members throughout the public structs and isn't
+//done.
+struct ArenaDeleter
+{
+  bool ArenaOwned = false;
+
+  ArenaDeleter() = default;
+  ArenaDeleter(bool arenaOwned) : ArenaOwned{arenaOwned} {}
+
+  //allows converting std::unique_ptr's (e.g. from std::make_unique) to ArenaPtr's
+  template <typename T>
+  ArenaDeleter(const std::default_delete<T>&) {}
+
+  template <typename T>
+  void operator()(T* ptr) const
+  {
+    if (ArenaOwned)
+      ptr->~T();
+    else
+      delete ptr;
+  }
+};
+
+template <typename T>
+using ArenaPtr = std::unique_ptr<T, ArenaDeleter>;
+
+//Monotonic (bump pointer) allocator. Allocations are never freed
+//individually, all memory is released at once when the arena is destroyed,
+//or recycled for new allocations by Reset(). Not thread safe, use one arena
+//per thread.
+class Arena
+{
+  public:
+    static constexpr size_t DefaultBlockSize = 64 * 1024;
+
+    explicit Arena(size_t blockSize = DefaultBlockSize) : m_blockSize{blockSize} {}
+
+    Arena(Arena&&) noexcept = default;
+    Arena& operator=(Arena&&) noexcept = default;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+      if (m_current < m_blocks.size())
+      {
+        Block& block = m_blocks[m_current];
+
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.Data.get());
+        uintptr_t aligned = (base + m_offset + alignment - 1) & ~(uintptr_t{alignment} - 1);
+
+        if (aligned + size <= base + block.Size)
+        {
+          m_offset = (aligned + size) - base;
+          m_bytesAllocated += size;
+          return reinterpret_cast<void*>(aligned);
+        }
+      }
+
+      return this->AllocateSlow(size, alignment);
+    }
+
+    template <typename T, typename... Args>
+    ArenaPtr<T> New(Args&&... args)
+    {
+      void* mem = this->Allocate(sizeof(T), alignof(T));
+      return ArenaPtr<T>{ new (mem) T(std::forward<Args>(args)...), ArenaDeleter{true} };
+    }
+
+    //copies the given bytes into the arena
+    std::span<const U8> CopyBytes(std::span<const U8> bytes);
+    std::string_view CopyString(std::string_view str);
+
+    //Makes all memory available for new allocations again, without returning
+    //it to the system. Every object allocated from the arena has to be
+    //destroyed before calling this.
+    void Reset();
+
+    //Returns all memory to the system. Same requirements as Reset().
+    void Release();
+
+    //sum of the sizes of all allocations since the last Reset() / Release()
+    size_t GetBytesAllocated() const { return m_bytesAllocated; }
+
+    //total size of the blocks owned by the arena
+    size_t GetCapacity() const;
+
+  private:
+    void* AllocateSlow(size_t size, size_t alignment);
+
+    struct Block
+    {
+      std::unique_ptr<U8[]> Data;
+      size_t Size;
+    };
+
+    std::vector<Block> m_blocks;
+    size_t m_current{0};
+    size_t m_offset{0};
+
+    size_t m_blockSize;
+    size_t m_bytesAllocated{0};
+};
+
+} //namespace FileFormats
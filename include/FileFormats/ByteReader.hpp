@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Defs.hpp"
+
+#include <span>
+#include <cstddef>
+
+namespace FileFormats
+{
+
+//Read cursor over a contiguous byte range (e.g. a file loaded into memory or a
+//MappedFile). The reader never copies or owns the bytes, so the range must
+//outlive the reader and anything parsed from it that keeps views into it.
+//
+//The member functions are deliberately unchecked, the bounds checked reads
+//that report errors live in Util/IO.hpp as Read<ByteOrder>(ByteReader&, ...)
+//overloads next to their std::istream counterparts.
+class ByteReader
+{
+  public:
+    ByteReader(std::span<const U8> bytes) : m_bytes{bytes} {}
+
+    //offset of the cursor relative to the start of the range
+    size_t Tell() const { return m_pos; }
+    size_t Size() const { return m_bytes.size(); }
+    size_t Remaining() const { return m_bytes.size() - m_pos; }
+
+    bool CanRead(size_t n) const { return n <= this->Remaining(); }
+
+    //pointer to the byte under the cursor
+    const U8* Data() const { return m_bytes.data() + m_pos; }
+
+    //the whole underlying range, independent of the cursor position
+    std::span<const U8> GetBytes() const { return m_bytes; }
+
+    //Unchecked, callers have to make sure that CanRead(n) holds
+    void Advance(size_t n) { m_pos += n; }
+
+    //Unchecked, callers have to make sure that pos <= Size()
+    void Seek(size_t pos) { m_pos = pos; }
+
+  private:
+    std::span<const U8> m_bytes;
+    size_t m_pos{0};
+};
+
+} //namespace FileFormats
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Defs.hpp"
+
+#include <span>
+#include <cstddef>
+#include <cassert>
+
+namespace FileFormats
+{
+
+//Write cursor over a contiguous, caller-owned byte range. Unlike ByteReader
+//this cursor is unchecked (apart from debug asserts): it is meant to be used
+//on a range that was sized exactly beforehand, so the hot store path doesn't
+//pay for bounds checks. The Write<ByteOrder>(ByteWriter&, ...) overloads live
+//in Util/IO.hpp next to their std::ostream counterparts.
+class ByteWriter
+{
+  public:
+    ByteWriter(std::span<U8> bytes) : m_bytes{bytes} {}
+
+    //offset of the cursor relative to the start of the range
+    size_t Tell() const { return m_pos; }
+    size_t Size() const { return m_bytes.size(); }
+    size_t Remaining() const { return m_bytes.size() - m_pos; }
+
+    //pointer to the byte under the cursor
+    U8* Data() const { return m_bytes.data() + m_pos; }
+
+    void Advance(size_t n)
+    {
+      assert(n <= this->Remaining());
+      m_pos += n;
+    }
+
+  private:
+    std::span<U8> m_bytes;
+    size_t m_pos{0};
+};
+
+} //namespace FileFormats
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "./Bytecode.hpp"
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <span>
+#include <vector>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <cassert>
+
+namespace FileFormats::JVM
+{
+
+class ConstantPool;
+
+//Annotations are kept as the bytes of their attributes and read through the
+//cursors below, which decode a structure only when it's visited. The bytes
+//are validated once when they're set (see ValidateAnnotations()), so the
+//cursors don't check bounds.
+
+//Nesting of annotations & arrays deeper than this is rejected by validation,
+//which bounds the recursion of the cursors
+constexpr U32 MaxAnnotationDepth = 64;
+
+//count consecutive structures of type T, which are skipped over one by one
+//while iterating
+template <typename T>
+class CursorRange
+{
+  public:
+    class Iterator
+    {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = T;
+
+        Iterator() = default;
+        Iterator(const U8* bytes, U32 remaining) : m_bytes{bytes}, m_remaining{remaining} {}
+
+        T operator*() const { return T{m_bytes}; }
+
+        Iterator& operator++()
+        {
+          m_bytes += T::GetSize(m_bytes);
+          m_remaining--;
+          return *this;
+        }
+
+        Iterator operator++(int) { Iterator prev = *this; ++*this; return prev; }
+
+        bool operator==(const Iterator& other) const { return m_remaining == other.m_remaining; }
+
+      private:
+        const U8* m_bytes{nullptr};
+        U32 m_remaining{0};
+    };
+
+    CursorRange() = default;
+    CursorRange(const U8* bytes, U32 count) : m_bytes{bytes}, m_count{count} {}
+
+    Iterator begin() const { return { m_bytes, m_count }; }
+    Iterator end() const { return { nullptr, 0 }; }
+
+    U32 size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+
+  private:
+    const U8* m_bytes{nullptr};
+    U32 m_count{0};
+};
+
+class Annotation;
+
+//element_value
+class ElementValue
+{
+  public:
+    explicit ElementValue(const U8* bytes) : m_bytes{bytes} {}
+
+    //B C D F I J S Z s: constant, e: enum, c: class, @: annotation, [: array
+    char GetTag() const { return static_cast<char>(m_bytes[0]); }
+
+    bool IsConst() const;
+
+    //Index of the Integer / Float / Long / Double / UTF8 constant (B C D F I J
+    //S Z s)
+    U16 GetConstValueIndex() const { assert(this->IsConst()); return this->GetIndex(0); }
+
+    //e
+    U16 GetEnumTypeNameIndex() const { assert(this->GetTag() == 'e'); return this->GetIndex(0); }
+    U16 GetEnumConstNameIndex() const { assert(this->GetTag() == 'e'); return this->GetIndex(2); }
+
+    //c, the UTF8 return descriptor of the class
+    U16 GetClassInfoIndex() const { assert(this->GetTag() == 'c'); return this->GetIndex(0); }
+
+    //@
+    Annotation GetAnnotation() const;
+
+    //[
+    CursorRange<ElementValue> GetArray() const
+    {
+      assert(this->GetTag() == '[');
+      return { m_bytes + 3, this->GetIndex(0) };
+    }
+
+    //The UTF8 constant referenced by an s, e (the constants name) or c
+    //value, empty if the index doesn't reference one
+    std::string_view GetString(const ConstantPool&) const;
+
+    //size in bytes, found by skipping over nested values
+    static U32 GetSize(const U8* bytes);
+    U32 GetSize() const { return ElementValue::GetSize(m_bytes); }
+
+  private:
+    U16 GetIndex(size_t offset) const { return LoadBigEndian<U16>(m_bytes + 1 + offset); }
+
+    const U8* m_bytes;
+};
+
+//element_value_pairs entry
+class ElementValuePair
+{
+  public:
+    explicit ElementValuePair(const U8* bytes) : m_bytes{bytes} {}
+
+    U16 GetNameIndex() const { return LoadBigEndian<U16>(m_bytes); }
+    std::string_view GetName(const ConstantPool&) const;
+
+    ElementValue GetValue() const { return ElementValue{m_bytes + 2}; }
+
+    static U32 GetSize(const U8* bytes) { return 2 + ElementValue::GetSize(bytes + 2); }
+
+  private:
+    const U8* m_bytes;
+};
+
+class Annotation
+{
+  public:
+    explicit Annotation(const U8* bytes) : m_bytes{bytes} {}
+
+    //Index of the UTF8 field descriptor of the annotation type
+    U16 GetTypeIndex() const { return LoadBigEndian<U16>(m_bytes); }
+
+    //e.g. "Ljava/lang/Deprecated;", empty if the type index doesn't
+    //reference a UTF8 constant
+    std::string_view GetTypeName(const ConstantPool&) const;
+
+    CursorRange<ElementValuePair> GetPairs() const
+    {
+      return { m_bytes + 4, LoadBigEndian<U16>(m_bytes + 2) };
+    }
+
+    //The value of the element with the given name, if the annotation has one
+    std::optional<ElementValue> FindValue(const ConstantPool&, std::string_view name) const;
+
+    static U32 GetSize(const U8* bytes);
+    U32 GetSize() const { return Annotation::GetSize(m_bytes); }
+
+  private:
+    const U8* m_bytes;
+};
+
+inline Annotation ElementValue::GetAnnotation() const
+{
+  assert(this->GetTag() == '@');
+  return Annotation{m_bytes + 1};
+}
+
+//The annotations of a single parameter, a num_annotations followed by them
+class ParameterAnnotations
+{
+  public:
+    explicit ParameterAnnotations(const U8* bytes) : m_bytes{bytes} {}
+
+    CursorRange<Annotation> GetAnnotations() const
+    {
+      return { m_bytes + 2, LoadBigEndian<U16>(m_bytes) };
+    }
+
+    static U32 GetSize(const U8* bytes);
+
+  private:
+    const U8* m_bytes;
+};
+
+//Validate the body of a Runtime(In)VisibleAnnotations, a
+//Runtime(In)VisibleParameterAnnotations and an AnnotationDefault attribute:
+//the structures have to fit into the bytes, use known tags, nest at most
+//MaxAnnotationDepth deep and cover the bytes exactly. Constant indices
+//aren't checked.
+ErrorOr<void> ValidateAnnotations(std::span<const U8> bytes);
+ErrorOr<void> ValidateParameterAnnotations(std::span<const U8> bytes);
+ErrorOr<void> ValidateElementValue(std::span<const U8> bytes);
+
+//The bytes of an annotation attribute, either owned or referencing bytes
+//that outlive it (e.g. the parsed class file)
+class AnnotationBytes
+{
+  public:
+    AnnotationBytes() = default;
+
+    AnnotationBytes(const AnnotationBytes&) = delete;
+    AnnotationBytes& operator=(const AnnotationBytes&) = delete;
+
+    std::span<const U8> Get() const { return m_view; }
+
+    //The bytes have to be valid, see ValidateAnnotations()
+    void Set(std::vector<U8> bytes)
+    {
+      m_owned = std::move(bytes);
+      m_view = m_owned;
+    }
+
+    void SetView(std::span<const U8> bytes)
+    {
+      m_owned.clear();
+      m_view = bytes;
+    }
+
+  private:
+    std::vector<U8> m_owned;
+    std::span<const U8> m_view;
+};
+
+} //namespace FileFormats::JVM
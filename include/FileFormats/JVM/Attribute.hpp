@@ -1,16 +1,25 @@
 #pragma once
 
-#include "./Instruction.hpp"
+#include "./Bytecode.hpp"
+#include "./Annotation.hpp"
 
 #include "../Defs.hpp"
 #include "../Error.hpp"
+#include "../Arena.hpp"
 
 #include <string_view>
 #include <vector>
+#include <span>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <functional>
 
 namespace FileFormats::JVM
 {
 
+class ConstantPool;
+
 
 struct AttributeInfo
 {
@@ -19,21 +28,99 @@ struct AttributeInfo
     {
       ConstantValue,
       Code,
+      StackMapTable,
+      BootstrapMethods,
+      NestHost,
+      NestMembers,
+      PermittedSubclasses,
 
+      Exceptions,
+      InnerClasses,
+      EnclosingMethod,
+      Synthetic,
+      Signature,
+      Record,
       SourceFile,
+      LineNumberTable,
+      LocalVariableTable,
+      LocalVariableTypeTable,
+      Deprecated,
+      MethodParameters,
+      Module,
+      ModulePackages,
+      ModuleMainClass,
+      RuntimeVisibleAnnotations,
+      RuntimeInvisibleAnnotations,
+      RuntimeVisibleParameterAnnotations,
+      RuntimeInvisibleParameterAnnotations,
+      AnnotationDefault,
   
-      Raw, //Non standard 
+      Raw,  //Non standard 
+      Lazy, //Non standard 
     };
   
     static ErrorOr<Type> GetType(std::string_view);
-    static std::string_view GetTypeName(Type);
+
+    //GetType() without an error, Type::Raw for non standard names
+    static Type FindType(std::string_view);
+
+    static constexpr std::string_view GetTypeName(Type type)
+    {
+      switch (type)
+      {
+        case Type::ConstantValue:                        return "ConstantValue";
+        case Type::Code:                                 return "Code";
+        case Type::StackMapTable:                        return "StackMapTable";
+        case Type::BootstrapMethods:                     return "BootstrapMethods";
+        case Type::NestHost:                             return "NestHost";
+        case Type::NestMembers:                          return "NestMembers";
+        case Type::PermittedSubclasses:                  return "PermittedSubclasses";
+        case Type::Exceptions:                           return "Exceptions";
+        case Type::InnerClasses:                         return "InnerClasses";
+        case Type::EnclosingMethod:                      return "EnclosingMethod";
+        case Type::Synthetic:                            return "Synthetic";
+        case Type::Signature:                            return "Signature";
+        case Type::Record:                               return "Record";
+        case Type::SourceFile:                           return "SourceFile";
+        case Type::LineNumberTable:                      return "LineNumberTable";
+        case Type::LocalVariableTable:                   return "LocalVariableTable";
+        case Type::LocalVariableTypeTable:               return "LocalVariableTypeTable";
+        case Type::Deprecated:                           return "Deprecated";
+        case Type::MethodParameters:                     return "MethodParameters";
+        case Type::Module:                               return "Module";
+        case Type::ModulePackages:                       return "ModulePackages";
+        case Type::ModuleMainClass:                      return "ModuleMainClass";
+        case Type::RuntimeVisibleAnnotations:            return "RuntimeVisibleAnnotations";
+        case Type::RuntimeInvisibleAnnotations:          return "RuntimeInvisibleAnnotations";
+        case Type::RuntimeVisibleParameterAnnotations:   return "RuntimeVisibleParameterAnnotations";
+        case Type::RuntimeInvisibleParameterAnnotations: return "RuntimeInvisibleParameterAnnotations";
+        case Type::AnnotationDefault:                    return "AnnotationDefault";
+
+        case Type::Raw:                                  return "_Raw";
+        case Type::Lazy:                                 return "_Lazy";
+      }
+
+      return {};
+    }
   
     std::string_view GetName() const;
     Type GetType() const;
   
     U16 NameIndex;
+
+    //Computed on every call, nothing is cached. For attributes containing
+    //attributes (Code, Record) that includes the lengths of the nested ones.
     virtual U32 GetLength() const = 0;
 
+    //The bytes (header included) the attribute was parsed from, set when 
+    //parsing with ParseOptions::KeepOriginalBytes. While set, the writer 
+    //copies them instead of encoding the attribute, so they have to be 
+    //cleared through MarkModified() whenever the attribute is changed.
+    //Attributes containing modified, added, removed or reordered attributes
+    //(Code, Record) are encoded again as well.
+    std::span<const U8> OriginalBytes;
+    void MarkModified() { OriginalBytes = {}; }
+
     //returns the size of a base AttributeInfo that always preceeds an attribute 
     //(U16 NameIndex & U32 length). The serialized attribute_length, or in this 
     //codebase the returned value from GetLength() does NOT include these 6 bytes
@@ -74,19 +161,30 @@ struct CodeAttribute : public AttributeInfo
 
   U16 MaxStack;
   U16 MaxLocals;
-  std::vector<Instruction> Code;
+  Bytecode Code;
 
   struct ExceptionHandler
   {
+    //allows reading / writing the table as one flat, bulk byte swapped U16 array
+    using SwapUnit = U16;
+
     U16 StartPC;
     U16 EndPC;
     U16 HandlerPC;
     U16 CatchType;
   };
+  static_assert(sizeof(ExceptionHandler) == 4 * sizeof(U16));
   std::vector<ExceptionHandler> ExceptionTable;
 
-  std::vector< std::unique_ptr<AttributeInfo> > Attributes;
+  std::vector< ArenaPtr<AttributeInfo> > Attributes;
+
+  U32 GetCodeLength() const { return Code.GetSize(); }
 
+  //Recomputes the lengths of all nested attributes on every call. The writer
+  //computes each length once per write and doesn't call this, use
+  //ClassFileWriter::ComputeSerializedSize() to size a whole class the same 
+  //way. The lengths aren't cached between calls, as the nested attributes
+  //can be changed without the Code attribute knowing.
   U32 GetLength() const override 
   { 
     U32 len{0};
@@ -94,9 +192,7 @@ struct CodeAttribute : public AttributeInfo
     len += sizeof(MaxLocals);
 
     len += sizeof(U32); //serialized field: "code_length" 
-
-    for(const Instruction& instr : Code)
-      len += instr.GetLength();
+    len += this->GetCodeLength();
 
     len += sizeof(U16); //serialized field: "exception_table_length" 
     len += ExceptionTable.size() * sizeof(U16) * 4;
@@ -114,6 +210,427 @@ struct CodeAttribute : public AttributeInfo
 };
 
 
+//verification_type_info of a StackMapTable frame
+struct VerificationType
+{
+  enum class Tag : U8
+  {
+    Top               = 0,
+    Integer           = 1,
+    Float             = 2,
+    Double            = 3,
+    Long              = 4,
+    Null              = 5,
+    UninitializedThis = 6,
+    Object            = 7,
+    Uninitialized     = 8,
+  };
+
+  Tag TypeTag;
+
+  //Object: index of a Class constant, Uninitialized: offset of the NEW
+  //instruction that created the object, 0 otherwise
+  U16 Data;
+
+  bool HasData() const { return TypeTag == Tag::Object || TypeTag == Tag::Uninitialized; }
+  U32 GetLength() const { return this->HasData() ? 3 : 1; }
+
+  //Long & Double take two local variable slots
+  bool IsWide() const { return TypeTag == Tag::Long || TypeTag == Tag::Double; }
+
+  bool operator==(const VerificationType&) const = default;
+};
+
+struct StackMapFrame
+{
+  enum class Kind : U8
+  {
+    Same,                         //frame_type   0 - 63
+    SameLocals1StackItem,         //frame_type  64 - 127
+    SameLocals1StackItemExtended, //frame_type 247
+    Chop,                         //frame_type 248 - 250
+    SameExtended,                 //frame_type 251
+    Append,                       //frame_type 252 - 254
+    Full,                         //frame_type 255
+  };
+
+  //Kind of a valid frame_type, frame types 128 - 246 are reserved
+  static constexpr Kind GetKind(U8 frameType)
+  {
+    if (frameType < 64)   return Kind::Same;
+    if (frameType < 128)  return Kind::SameLocals1StackItem;
+    if (frameType == 247) return Kind::SameLocals1StackItemExtended;
+    if (frameType < 251)  return Kind::Chop;
+    if (frameType == 251) return Kind::SameExtended;
+    if (frameType < 255)  return Kind::Append;
+    return Kind::Full;
+  }
+
+  Kind GetKind() const { return StackMapFrame::GetKind(FrameType); }
+
+  //The serialized frame_type, which also encodes the offset delta of Same /
+  //SameLocals1StackItem frames and the number of chopped / appended locals
+  U8 FrameType;
+  U16 OffsetDelta;
+
+  //The frames verification types are stored in StackMapTableAttribute::Types,
+  //starting at TypesBegin: first the frames locals (the appended ones of an 
+  //Append frame, all of a Full frame), followed by its stack items
+  U32 TypesBegin;
+  U16 LocalsCount;
+  U16 StackCount;
+
+  U32 GetLength() const;
+};
+
+//The verification types of all frames are kept in one flat array instead of
+//a pair of vectors per frame
+struct StackMapTableAttribute : public AttributeInfo
+{
+  StackMapTableAttribute() : AttributeInfo(Type::StackMapTable) {}
+  U32 GetLength() const override;
+
+  std::span<const VerificationType> GetLocals(const StackMapFrame& frame) const
+  {
+    return std::span{Types}.subspan(frame.TypesBegin, frame.LocalsCount);
+  }
+
+  std::span<const VerificationType> GetStack(const StackMapFrame& frame) const
+  {
+    return std::span{Types}.subspan(frame.TypesBegin + frame.LocalsCount, frame.StackCount);
+  }
+
+  std::vector<StackMapFrame> Frames;
+  std::vector<VerificationType> Types;
+};
+
+
+//The variable length tables of the following attributes are stored the same
+//way: their fixed size entries in one vector, and the index lists of all
+//entries in a second, flat one the entries reference by range. Fixed size
+//tables of U16s declare a SwapUnit, so they are bulk read / written.
+
+struct BootstrapMethod
+{
+  U16 MethodRef; //MethodHandle constant
+  U16 ArgumentCount;
+  U32 ArgumentsBegin; //into BootstrapMethodsAttribute::Arguments
+};
+
+struct BootstrapMethodsAttribute : public AttributeInfo
+{
+  BootstrapMethodsAttribute() : AttributeInfo(Type::BootstrapMethods) {}
+  U32 GetLength() const override;
+
+  //loadable constants
+  std::span<const U16> GetArguments(const BootstrapMethod& method) const
+  {
+    return std::span{Arguments}.subspan(method.ArgumentsBegin, method.ArgumentCount);
+  }
+
+  std::vector<BootstrapMethod> Methods;
+  std::vector<U16> Arguments;
+};
+
+struct NestHostAttribute : public AttributeInfo
+{
+  NestHostAttribute() : AttributeInfo(Type::NestHost) {}
+  U32 GetLength() const override { return 2; }
+
+  U16 HostClassIndex;
+};
+
+struct NestMembersAttribute : public AttributeInfo
+{
+  NestMembersAttribute() : AttributeInfo(Type::NestMembers) {}
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U16) + Classes.size() * sizeof(U16)); }
+
+  std::vector<U16> Classes; //Class constants
+};
+
+struct PermittedSubclassesAttribute : public AttributeInfo
+{
+  PermittedSubclassesAttribute() : AttributeInfo(Type::PermittedSubclasses) {}
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U16) + Classes.size() * sizeof(U16)); }
+
+  std::vector<U16> Classes; //Class constants
+};
+
+struct ExceptionsAttribute : public AttributeInfo
+{
+  ExceptionsAttribute() : AttributeInfo(Type::Exceptions) {}
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U16) + ExceptionIndexTable.size() * sizeof(U16)); }
+
+  std::vector<U16> ExceptionIndexTable; //Class constants
+};
+
+struct InnerClass
+{
+  using SwapUnit = U16;
+
+  U16 InnerClassInfoIndex;
+  U16 OuterClassInfoIndex; //0 for local & anonymous classes
+  U16 InnerNameIndex;      //0 for anonymous classes
+  U16 InnerClassAccessFlags;
+};
+static_assert(sizeof(InnerClass) == 4 * sizeof(U16));
+
+struct InnerClassesAttribute : public AttributeInfo
+{
+  InnerClassesAttribute() : AttributeInfo(Type::InnerClasses) {}
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U16) + Classes.size() * sizeof(InnerClass)); }
+
+  std::vector<InnerClass> Classes;
+};
+
+struct EnclosingMethodAttribute : public AttributeInfo
+{
+  EnclosingMethodAttribute() : AttributeInfo(Type::EnclosingMethod) {}
+  U32 GetLength() const override { return 4; }
+
+  U16 ClassIndex;
+  U16 MethodIndex; //NameAndType constant, 0 if not enclosed by a method
+};
+
+struct SyntheticAttribute : public AttributeInfo
+{
+  SyntheticAttribute() : AttributeInfo(Type::Synthetic) {}
+  U32 GetLength() const override { return 0; }
+};
+
+struct SignatureAttribute : public AttributeInfo
+{
+  SignatureAttribute() : AttributeInfo(Type::Signature) {}
+  U32 GetLength() const override { return 2; }
+
+  U16 SignatureIndex;
+};
+
+struct RecordComponent
+{
+  U16 NameIndex;
+  U16 DescriptorIndex;
+  std::vector< ArenaPtr<AttributeInfo> > Attributes;
+};
+
+struct RecordAttribute : public AttributeInfo
+{
+  RecordAttribute() : AttributeInfo(Type::Record) {}
+  U32 GetLength() const override;
+
+  std::vector<RecordComponent> Components;
+};
+
+struct LineNumberEntry
+{
+  using SwapUnit = U16;
+
+  U16 StartPC;
+  U16 LineNumber;
+};
+static_assert(sizeof(LineNumberEntry) == 2 * sizeof(U16));
+
+struct LineNumberTableAttribute : public AttributeInfo
+{
+  LineNumberTableAttribute() : AttributeInfo(Type::LineNumberTable) {}
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U16) + LineNumbers.size() * sizeof(LineNumberEntry)); }
+
+  std::vector<LineNumberEntry> LineNumbers;
+};
+
+//An entry of a LocalVariableTable, or of a LocalVariableTypeTable in which
+//case DescriptorIndex is the index of the variables signature
+struct LocalVariable
+{
+  using SwapUnit = U16;
+
+  U16 StartPC;
+  U16 Length;
+  U16 NameIndex;
+  U16 DescriptorIndex;
+  U16 Index;
+};
+static_assert(sizeof(LocalVariable) == 5 * sizeof(U16));
+
+struct LocalVariableTableAttribute : public AttributeInfo
+{
+  LocalVariableTableAttribute() : AttributeInfo(Type::LocalVariableTable) {}
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U16) + LocalVariables.size() * sizeof(LocalVariable)); }
+
+  std::vector<LocalVariable> LocalVariables;
+};
+
+struct LocalVariableTypeTableAttribute : public AttributeInfo
+{
+  LocalVariableTypeTableAttribute() : AttributeInfo(Type::LocalVariableTypeTable) {}
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U16) + LocalVariableTypes.size() * sizeof(LocalVariable)); }
+
+  std::vector<LocalVariable> LocalVariableTypes;
+};
+
+struct DeprecatedAttribute : public AttributeInfo
+{
+  DeprecatedAttribute() : AttributeInfo(Type::Deprecated) {}
+  U32 GetLength() const override { return 0; }
+};
+
+struct MethodParameter
+{
+  using SwapUnit = U16;
+
+  U16 NameIndex; //0 for a parameter without name
+  U16 AccessFlags;
+};
+static_assert(sizeof(MethodParameter) == 2 * sizeof(U16));
+
+struct MethodParametersAttribute : public AttributeInfo
+{
+  MethodParametersAttribute() : AttributeInfo(Type::MethodParameters) {}
+
+  //the parameter count is a single byte
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U8) + Parameters.size() * sizeof(MethodParameter)); }
+
+  std::vector<MethodParameter> Parameters;
+};
+
+struct ModuleRequires
+{
+  using SwapUnit = U16;
+
+  U16 RequiresIndex; //Module constant
+  U16 RequiresFlags;
+  U16 RequiresVersionIndex;
+};
+static_assert(sizeof(ModuleRequires) == 3 * sizeof(U16));
+
+//An exports or opens entry
+struct ModulePackage
+{
+  U16 Index; //Package constant
+  U16 Flags;
+  U16 ToCount;
+  U32 ToBegin; //Module constants in ModuleAttribute::Indices
+};
+
+struct ModuleProvides
+{
+  U16 Index; //Class constant of the service interface
+  U16 WithCount;
+  U32 WithBegin; //Class constants in ModuleAttribute::Indices
+};
+
+struct ModuleAttribute : public AttributeInfo
+{
+  ModuleAttribute() : AttributeInfo(Type::Module) {}
+  U32 GetLength() const override;
+
+  std::span<const U16> GetTo(const ModulePackage& package) const
+  {
+    return std::span{Indices}.subspan(package.ToBegin, package.ToCount);
+  }
+
+  std::span<const U16> GetWith(const ModuleProvides& provides) const
+  {
+    return std::span{Indices}.subspan(provides.WithBegin, provides.WithCount);
+  }
+
+  U16 ModuleNameIndex;
+  U16 ModuleFlags;
+  U16 ModuleVersionIndex;
+
+  std::vector<ModuleRequires> Requires;
+  std::vector<ModulePackage> Exports;
+  std::vector<ModulePackage> Opens;
+  std::vector<U16> Uses; //Class constants
+  std::vector<ModuleProvides> Provides;
+
+  //the to / with lists of all exports, opens & provides
+  std::vector<U16> Indices;
+};
+
+struct ModulePackagesAttribute : public AttributeInfo
+{
+  ModulePackagesAttribute() : AttributeInfo(Type::ModulePackages) {}
+  U32 GetLength() const override { return static_cast<U32>(sizeof(U16) + PackageIndex.size() * sizeof(U16)); }
+
+  std::vector<U16> PackageIndex; //Package constants
+};
+
+struct ModuleMainClassAttribute : public AttributeInfo
+{
+  ModuleMainClassAttribute() : AttributeInfo(Type::ModuleMainClass) {}
+  U32 GetLength() const override { return 2; }
+
+  U16 MainClassIndex;
+};
+
+//The annotation attributes keep their bytes, which are read through the
+//cursors of Annotation.hpp
+struct AnnotationsAttribute : public AttributeInfo
+{
+  U32 GetLength() const override { return static_cast<U32>(Bytes.Get().size()); }
+
+  CursorRange<Annotation> GetAnnotations() const
+  {
+    auto bytes = Bytes.Get();
+    return bytes.empty() ? CursorRange<Annotation>{} : CursorRange<Annotation>{ bytes.data() + 2, LoadBigEndian<U16>(bytes.data()) };
+  }
+
+  AnnotationBytes Bytes; //see ValidateAnnotations()
+
+  protected:
+    AnnotationsAttribute(Type type) : AttributeInfo(type) {}
+};
+
+struct RuntimeVisibleAnnotationsAttribute : public AnnotationsAttribute
+{
+  RuntimeVisibleAnnotationsAttribute() : AnnotationsAttribute(Type::RuntimeVisibleAnnotations) {}
+};
+
+struct RuntimeInvisibleAnnotationsAttribute : public AnnotationsAttribute
+{
+  RuntimeInvisibleAnnotationsAttribute() : AnnotationsAttribute(Type::RuntimeInvisibleAnnotations) {}
+};
+
+struct ParameterAnnotationsAttribute : public AttributeInfo
+{
+  U32 GetLength() const override { return static_cast<U32>(Bytes.Get().size()); }
+
+  //per parameter
+  CursorRange<ParameterAnnotations> GetParameters() const
+  {
+    auto bytes = Bytes.Get();
+    return bytes.empty() ? CursorRange<ParameterAnnotations>{} : CursorRange<ParameterAnnotations>{ bytes.data() + 1, bytes[0] };
+  }
+
+  AnnotationBytes Bytes; //see ValidateParameterAnnotations()
+
+  protected:
+    ParameterAnnotationsAttribute(Type type) : AttributeInfo(type) {}
+};
+
+struct RuntimeVisibleParameterAnnotationsAttribute : public ParameterAnnotationsAttribute
+{
+  RuntimeVisibleParameterAnnotationsAttribute() : ParameterAnnotationsAttribute(Type::RuntimeVisibleParameterAnnotations) {}
+};
+
+struct RuntimeInvisibleParameterAnnotationsAttribute : public ParameterAnnotationsAttribute
+{
+  RuntimeInvisibleParameterAnnotationsAttribute() : ParameterAnnotationsAttribute(Type::RuntimeInvisibleParameterAnnotations) {}
+};
+
+struct AnnotationDefaultAttribute : public AttributeInfo
+{
+  AnnotationDefaultAttribute() : AttributeInfo(Type::AnnotationDefault) {}
+  U32 GetLength() const override { return static_cast<U32>(Bytes.Get().size()); }
+
+  //Bytes mustn't be empty
+  ElementValue GetDefaultValue() const { return ElementValue{ Bytes.Get().data() }; }
+
+  AnnotationBytes Bytes; //see ValidateElementValue()
+};
+
+
 //Non standard attribute type, used for parsing unknown or unimplemented attributes as a byte array
 struct RawAttribute : public AttributeInfo
 {
@@ -123,4 +640,57 @@ struct RawAttribute : public AttributeInfo
   std::vector<U8> Bytes;
 };
 
+//Non standard attribute type, produced when parsing with 
+//ParseOptions::LazyAttributes. It only references the attributes body in the 
+//parsed bytes and decodes it into the typed attribute on first access, so 
+//those bytes have to outlive it. Until then it is written back verbatim.
+struct LazyAttribute : public AttributeInfo
+{
+  LazyAttribute(Type bodyType, std::span<const U8> body) 
+    : AttributeInfo(Type::Lazy), Body{body}, m_bodyType{bodyType} {}
+
+  U32 GetLength() const override;
+
+  //The type the body decodes to, known without decoding it
+  Type GetBodyType() const { return m_bodyType; }
+
+  //Decodes the body on the first call and returns the decoded attribute on 
+  //every call. Safe to call concurrently, the body is decoded exactly once.
+  ErrorOr< std::reference_wrapper<AttributeInfo> > Decode(const ConstantPool&) const;
+
+  template <class T>
+  ErrorOr< std::reference_wrapper<T> > Decode(const ConstantPool& constPool) const
+  {
+    auto errOrAttr = this->Decode(constPool);
+    if (errOrAttr.IsError())
+      return errOrAttr.GetError();
+
+    T* ptr = dynamic_cast<T*>( &errOrAttr.Get().get() );
+
+    if (ptr == nullptr)
+    {
+      return Error::FromFormatStr("LazyAttribute.Decode<%s>() failed to convert decoded attribute to requested type (dynamic cast failed)", 
+          typeid(T).name());
+    }
+
+    return *ptr;
+  }
+
+  //nullptr until the body has been decoded
+  AttributeInfo* GetDecoded() const { return m_decodedPtr.load(std::memory_order_acquire); }
+
+  //Returns attr itself, or the decoded attribute if attr is a LazyAttribute
+  static ErrorOr< std::reference_wrapper<AttributeInfo> > Resolve(AttributeInfo& attr, const ConstantPool&);
+
+  std::span<const U8> Body;
+
+  private:
+    Type m_bodyType;
+
+    mutable std::once_flag m_decodeFlag;
+    mutable ArenaPtr<AttributeInfo> m_decoded;
+    mutable std::optional<Error> m_decodeError;
+    mutable std::atomic<AttributeInfo*> m_decodedPtr{nullptr};
+};
+
 } //namespace FileFormats::JVM
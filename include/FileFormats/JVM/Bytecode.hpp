@@ -0,0 +1,289 @@
+#pragma once
+
+#include "./Instruction.hpp"
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <span>
+#include <vector>
+#include <array>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <cassert>
+#include <cstddef>
+
+namespace FileFormats::JVM
+{
+
+//Reads a big endian value from (unaligned) instruction operand bytes
+template <typename T>
+T LoadBigEndian(const U8* bytes)
+{
+  if constexpr (std::is_enum_v<T>)
+    return static_cast<T>( LoadBigEndian< std::underlying_type_t<T> >(bytes) );
+  else
+  {
+    std::make_unsigned_t<T> value{0};
+
+    for (size_t i = 0; i < sizeof(T); i++)
+      value = static_cast< std::make_unsigned_t<T> >((value << 8) | bytes[i]);
+
+    return static_cast<T>(value);
+  }
+}
+
+//View of a big endian array inside of the code, e.g. the jump offsets of a
+//TABLESWITCH
+template <typename T>
+class BigEndianArrayView
+{
+  public:
+    BigEndianArrayView(const U8* bytes, size_t size) : m_bytes{bytes}, m_size{size} {}
+
+    size_t Size() const { return m_size; }
+    bool IsEmpty() const { return m_size == 0; }
+
+    T operator[](size_t index) const
+    {
+      assert(index < m_size);
+      return LoadBigEndian<T>(m_bytes + index * sizeof(T));
+    }
+
+  private:
+    const U8* m_bytes;
+    size_t m_size;
+};
+
+//A single instruction inside a Bytecode, decoded on demand from its bytes
+class InstructionView
+{
+  public:
+    InstructionView(const U8* bytes, U32 offset, U32 length)
+      : m_bytes{bytes}, m_offset{offset}, m_length{length} {}
+
+    //offset of the instruction relative to the start of the code array (pc)
+    U32 GetOffset() const { return m_offset; }
+    U8 GetOpCode() const { return m_bytes[0]; }
+
+    //size in bytes, including the padding of TABLESWITCH / LOOKUPSWITCH
+    U32 GetLength() const { return m_length; }
+
+    //opcode followed by the operand bytes
+    std::span<const U8> GetBytes() const { return { m_bytes, m_length }; }
+
+    const OpCodeInfo& GetInfo() const { return GetOpCodeInfo(this->GetOpCode()); }
+    OperandLayout GetOperandLayout() const { return this->GetInfo().Layout; }
+
+    //Reads an operand, offset = byte offset relative to the end of the opcode
+    template <typename T>
+    T GetOperand(size_t offset = 0) const
+    {
+      assert(1 + offset + sizeof(T) <= m_length);
+      return LoadBigEndian<T>(m_bytes + 1 + offset);
+    }
+
+    //Whether this is an instance of the given instruction type, e.g.
+    //Is<Instructions::INVOKEVIRTUAL>()
+    template <typename InstrT>
+    bool Is() const
+    {
+      if (this->GetOpCode() != InstrT::StaticOpCode)
+        return false;
+
+      if constexpr (std::is_same_v<InstrT, Instructions::WIDE>)
+        return m_bytes[1] != OP_IINC;
+      else if constexpr (std::is_same_v<InstrT, Instructions::WIDE_IINC>)
+        return m_bytes[1] == OP_IINC;
+      else
+        return true;
+    }
+
+    //Decodes the instruction into the given instruction type, which it has to
+    //be an instance of (see Is<InstrT>()), e.g. As<Instructions::INVOKEVIRTUAL>()
+    template <typename InstrT>
+    InstrT As() const
+    {
+      assert(this->Is<InstrT>());
+
+      const U8* operands = m_bytes + 1;
+
+      if constexpr (std::is_same_v<InstrT, Instructions::TABLESWITCH>)
+      {
+        operands += GetSwitchPadding(m_offset);
+
+        S32 def  = LoadBigEndian<S32>(operands);
+        S32 low  = LoadBigEndian<S32>(operands + 4);
+        S32 high = LoadBigEndian<S32>(operands + 8);
+
+        std::vector<S32> offsets(static_cast<size_t>(static_cast<S64>(high) - low + 1));
+        for (size_t i = 0; i < offsets.size(); i++)
+          offsets[i] = LoadBigEndian<S32>(operands + 12 + i * 4);
+
+        return InstrT{ def, low, std::move(offsets) };
+      }
+      else if constexpr (std::is_same_v<InstrT, Instructions::LOOKUPSWITCH>)
+      {
+        operands += GetSwitchPadding(m_offset);
+
+        S32 def    = LoadBigEndian<S32>(operands);
+        S32 nPairs = LoadBigEndian<S32>(operands + 4);
+
+        std::vector<S32> pairs(static_cast<size_t>(nPairs) * 2);
+        for (size_t i = 0; i < pairs.size(); i++)
+          pairs[i] = LoadBigEndian<S32>(operands + 8 + i * 4);
+
+        return InstrT{ def, std::move(pairs) };
+      }
+      else if constexpr (std::is_same_v<InstrT, Instructions::WIDE>)
+        return InstrT{ operands[0], LoadBigEndian<U16>(operands + 1) };
+      else if constexpr (std::is_same_v<InstrT, Instructions::WIDE_IINC>)
+        return InstrT{ LoadBigEndian<U16>(operands + 1), LoadBigEndian<U16>(operands + 3) };
+      else if constexpr (requires { typename InstrT::SecondArgT; })
+      {
+        using FirstT  = typename InstrT::FirstArgT;
+        using SecondT = typename InstrT::SecondArgT;
+
+        return InstrT{ LoadBigEndian<FirstT>(operands), LoadBigEndian<SecondT>(operands + sizeof(FirstT)) };
+      }
+      else if constexpr (requires { typename InstrT::FirstArgT; })
+        return InstrT{ LoadBigEndian<typename InstrT::FirstArgT>(operands) };
+      else
+        return InstrT{};
+    }
+
+  private:
+    const U8* m_bytes;
+    U32 m_offset;
+    U32 m_length;
+};
+
+//The code array of a Code attribute, stored as its packed bytes (so roughly
+//its on disk size) and decoded on demand. The bytes are validated when a
+//Bytecode is created, so iterating & decoding it can't fail.
+class Bytecode
+{
+  public:
+    class Iterator
+    {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = InstructionView;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = InstructionView;
+
+        Iterator() = default;
+        Iterator(std::span<const U8> code, U32 offset) : m_code{code}, m_offset{offset}
+        {
+          if (m_offset < m_code.size())
+            m_length = Bytecode::GetLengthUnchecked(m_code.data(), m_offset);
+        }
+
+        InstructionView operator*() const { return { m_code.data() + m_offset, m_offset, m_length }; }
+
+        Iterator& operator++()
+        {
+          m_offset += m_length;
+
+          if (m_offset < m_code.size())
+            m_length = Bytecode::GetLengthUnchecked(m_code.data(), m_offset);
+
+          return *this;
+        }
+
+        Iterator operator++(int) { Iterator prev = *this; ++*this; return prev; }
+
+        bool operator==(const Iterator& other) const { return m_offset == other.m_offset; }
+
+      private:
+        std::span<const U8> m_code;
+        U32 m_offset{0};
+        U32 m_length{0};
+    };
+
+    Bytecode() = default;
+
+    //Takes ownership of the bytes
+    static ErrorOr<Bytecode> FromBytes(std::vector<U8> bytes);
+
+    //References the bytes, which have to outlive the Bytecode
+    static ErrorOr<Bytecode> FromView(std::span<const U8> bytes);
+
+    //Checks that the bytes are a sequence of complete, valid instructions
+    static ErrorOr<void> Validate(std::span<const U8> bytes);
+
+    Bytecode(const Bytecode&);
+    Bytecode(Bytecode&&) noexcept;
+    Bytecode& operator=(const Bytecode&);
+    Bytecode& operator=(Bytecode&&) noexcept;
+
+    std::span<const U8> GetBytes() const { return m_bytes; }
+    U32 GetSize() const { return static_cast<U32>(m_bytes.size()); }
+    bool IsEmpty() const { return m_bytes.empty(); }
+
+    //Whether the bytes are owned, or reference the parsed bytes / an Arena
+    bool IsOwned() const { return m_isOwned; }
+
+    Iterator begin() const { return { m_bytes, 0 }; }
+    Iterator end() const { return { m_bytes, this->GetSize() }; }
+
+    //Offsets of all instructions in ascending order. Built on first use of
+    //this or any of the functions below, which is not thread safe, so call
+    //it once before sharing a Bytecode between threads.
+    const std::vector<U32>& GetInstructionOffsets() const;
+
+    size_t GetInstructionCount() const { return this->GetInstructionOffsets().size(); }
+    InstructionView GetInstruction(size_t index) const;
+
+    //The instruction starting at the given offset, nullopt if no instruction
+    //starts there
+    std::optional<InstructionView> At(U32 offset) const;
+
+    //Index of the instruction starting at the given offset
+    std::optional<size_t> GetInstructionIndex(U32 offset) const;
+
+    //Size of the (validated) instruction at the given offset
+    static U32 GetLengthUnchecked(const U8* code, U32 offset)
+    {
+      U8 opCode = code[offset];
+
+      if (U32 length = OpCodeInfoTable[opCode].Length)
+        return length;
+
+      switch (opCode)
+      {
+        case OP_TABLESWITCH:
+        {
+          const U8* operands = code + offset + 1 + GetSwitchPadding(offset);
+          S64 count = S64{LoadBigEndian<S32>(operands + 8)} - LoadBigEndian<S32>(operands + 4) + 1;
+          return static_cast<U32>(1 + GetSwitchPadding(offset) + 12 + count * 4);
+        }
+
+        case OP_LOOKUPSWITCH:
+        {
+          const U8* operands = code + offset + 1 + GetSwitchPadding(offset);
+          S64 nPairs = LoadBigEndian<S32>(operands + 4);
+          return static_cast<U32>(1 + GetSwitchPadding(offset) + 8 + nPairs * 8);
+        }
+
+        case OP_WIDE:
+          return code[offset + 1] == OP_IINC ? 6 : 4;
+      }
+
+      return 1;
+    }
+
+  private:
+    void BuildIndex() const;
+
+    std::span<const U8> m_bytes;
+    std::vector<U8> m_owned;
+    bool m_isOwned{false};
+
+    mutable std::vector<U32> m_offsets;
+    mutable bool m_indexed{false};
+};
+
+} //namespace FileFormats::JVM
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Defs.hpp"
+#include "../Arena.hpp"
 #include "ConstantPool.hpp"
 #include "Attribute.hpp"
 
@@ -12,11 +13,22 @@ struct FieldMethodInfo
   U16 AccessFlags;
   U16 NameIndex;
   U16 DescriptorIndex;
-  std::vector< std::unique_ptr<AttributeInfo> > Attributes;
+  std::vector< ArenaPtr<AttributeInfo> > Attributes;
+
+  //The bytes the field / method was parsed from, see 
+  //AttributeInfo::OriginalBytes. Changes to the members above (including 
+  //added, removed or reordered attributes) are detected by the writer, only
+  //the attributes themselves have to be marked as modified.
+  std::span<const U8> OriginalBytes;
 };
 
 struct ClassFile 
 {
+  //Set when the class file was parsed with ParseOptions::UseArena, owns the
+  //memory of the classes constants & attributes. Declared first so it is
+  //destroyed last.
+  std::unique_ptr<Arena> OwnedArena;
+
   U32 Magic;
   U16 MinorVersion;
   U16 MajorVersion;
@@ -27,7 +39,7 @@ struct ClassFile
   std::vector<U16> Interfaces;
   std::vector<FieldMethodInfo> Fields;
   std::vector<FieldMethodInfo> Methods;
-  std::vector< std::unique_ptr<AttributeInfo> > Attributes;
+  std::vector< ArenaPtr<AttributeInfo> > Attributes;
 };
 
 
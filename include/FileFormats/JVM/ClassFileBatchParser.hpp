@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ClassFileParser.hpp"
+#include "../Zip/ZipArchive.hpp"
+
+#include <span>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace FileFormats::JVM
+{
+
+struct BatchParseOptions
+{
+  //Options every class is parsed with. When parsing files, LazyAttributes,
+  //ZeroCopyStrings and KeepOriginalBytes are ignored, as the files are
+  //unmapped right after parsing. TargetArena is always ignored, an arena
+  //can't be shared by the threads (see ReuseWorkerArenas, or UseArena for
+  //an arena per class).
+  ParseOptions Parse;
+
+  //Parse the classes of every thread into an arena owned by it, which is
+  //reset after each callback returns, so no memory is allocated per class
+  //once the arenas have grown. The results then must not outlive the 
+  //callback. Ignored by the overloads returning the results.
+  bool ReuseWorkerArenas = false;
+
+  //Number of threads to parse on (including the calling thread), 0 = one per
+  //hardware thread. Never more than there are inputs.
+  unsigned ThreadCount = 0;
+};
+
+struct BatchParseStats
+{
+  size_t ClassCount = 0; //successfully parsed
+  size_t ErrorCount = 0;
+  U64 ByteCount = 0;     //total size of all inputs
+  unsigned ThreadCount = 0;
+  double Seconds = 0;
+
+  double GetBytesPerSecond() const { return Seconds > 0 ? ByteCount / Seconds : 0; }
+  double GetClassesPerSecond() const { return Seconds > 0 ? (ClassCount + ErrorCount) / Seconds : 0; }
+};
+
+//Parses many class files on multiple threads. The inputs are distributed
+//evenly (by size) across the threads, which steal half of the remaining
+//inputs of another thread once they run out.
+class ClassFileBatchParser
+{
+  public:
+    //index = index of the input the result belongs to. The callback is called
+    //concurrently from all threads, in no particular order.
+    using Callback = std::function<void(size_t index, ErrorOr<ClassFile>&& result)>;
+
+    static BatchParseStats Parse(std::span<const std::span<const U8>> inputs,
+        const Callback& callback, const BatchParseOptions& = {});
+    static BatchParseStats ParseFiles(std::span<const std::string> paths,
+        const Callback& callback, const BatchParseOptions& = {});
+
+    //Parses the class file entries of the archive, index = index of the entry 
+    //in archive.GetEntries(). LazyAttributes, ZeroCopyStrings and
+    //KeepOriginalBytes only apply to stored entries, the archive has to
+    //outlive their results.
+    static BatchParseStats ParseArchive(const Zip::ZipArchive& archive,
+        const Callback& callback, const BatchParseOptions& = {});
+
+    //Return the results in the order of the inputs
+    static std::vector< ErrorOr<ClassFile> > Parse(std::span<const std::span<const U8>> inputs,
+        const BatchParseOptions& = {}, BatchParseStats* stats = nullptr);
+    static std::vector< ErrorOr<ClassFile> > ParseFiles(std::span<const std::string> paths,
+        const BatchParseOptions& = {}, BatchParseStats* stats = nullptr);
+};
+
+} //namespace FileFormats::JVM
@@ -2,21 +2,138 @@
 
 #include "ClassFile.hpp"
 #include "../Error.hpp"
+#include "../ByteReader.hpp"
+
+#include <span>
+#include <initializer_list>
 
 namespace FileFormats::JVM
 {
 
+//Set of attribute types, a bit per AttributeInfo::Type
+using AttributeMask = U32;
+
+static_assert(static_cast<U32>(AttributeInfo::Type::Lazy) < 32, "AttributeMask has a bit per type");
+
+constexpr AttributeMask GetAttributeMask(std::initializer_list<AttributeInfo::Type> types)
+{
+  AttributeMask mask{0};
+
+  for (auto type : types)
+    mask |= AttributeMask{1} << static_cast<U32>(type);
+
+  return mask;
+}
+
+constexpr bool HasAttributeType(AttributeMask mask, AttributeInfo::Type type)
+{
+  return (mask & GetAttributeMask({ type })) != 0;
+}
+
+constexpr AttributeMask AllAttributes = ~AttributeMask{0};
+
+constexpr AttributeMask DebugAttributes = GetAttributeMask({ 
+    AttributeInfo::Type::SourceFile,
+    AttributeInfo::Type::LineNumberTable,
+    AttributeInfo::Type::LocalVariableTable,
+    AttributeInfo::Type::LocalVariableTypeTable });
+
+struct ParseOptions
+{
+  //Don't decode attribute bodies while parsing. Every attribute is stored as a
+  //LazyAttribute that references its body in the parsed bytes and is decoded
+  //on first access, so the parsed bytes have to outlive the ClassFile.
+  bool LazyAttributes = false;
+
+  //Allocate the parsed constants & attributes from an Arena owned by the
+  //ClassFile (ClassFile::OwnedArena), so they are released in one go. The
+  //tables they hold still use the heap, see ArenaDeleter.
+  bool UseArena = false;
+
+  //Arena to allocate from instead of the heap, has to outlive the parsed
+  //objects. Takes precedence over UseArena. 
+  Arena* TargetArena = nullptr;
+
+  //Make UTF8 constants and the bodies of annotation attributes reference the 
+  //parsed bytes instead of copying them, so the parsed bytes have to outlive 
+  //the ClassFile (and its ConstantPool).
+  bool ZeroCopyStrings = false;
+
+  //Keep the bytes every field, method & attribute was parsed from (see 
+  //AttributeInfo::OriginalBytes), so writing the class copies the ones that
+  //weren't modified instead of encoding them again. The parsed bytes have to
+  //outlive the ClassFile.
+  bool KeepOriginalBytes = false;
+
+  //Attributes not to parse, per location. Skipped attributes are seeked over
+  //using their length, without being allocated or decoded, and are missing
+  //from the parsed ClassFile. All non standard attributes have Type::Raw.
+  //e.g. GetAttributeMask({ AttributeInfo::Type::Code }) for the methods drops
+  //all code, ~GetAttributeMask({ AttributeInfo::Type::Signature }) keeps only
+  //the signatures, DebugAttributes drops the debug info.
+  //The attributes of record components aren't filtered, neither are the ones
+  //of Code attributes decoded lazily (see LazyAttributes).
+  AttributeMask SkipClassAttributes = 0;
+  AttributeMask SkipFieldAttributes = 0;
+  AttributeMask SkipMethodAttributes = 0;
+  AttributeMask SkipCodeAttributes = 0;
+};
+
 class ClassFileParser
 {
   public:
+    static ErrorOr<ClassFile> ParseClassFile(std::span<const U8>, const ParseOptions& = {});
+    static ErrorOr<ClassFile> ParseClassFile(ByteReader&, const ParseOptions& = {});
+
+    //Allocates the classes constants & attributes from the given arena 
+    //instead of the heap. The arena has to outlive the returned ClassFile.
+    static ErrorOr<ClassFile> ParseClassFile(std::span<const U8>, Arena&, const ParseOptions& = {});
+    static ErrorOr<ConstantPool> ParseConstantPool(ByteReader&, const ParseOptions& = {});
+    static ErrorOr< ArenaPtr<CPInfo> > ParseConstant(ByteReader&, const ParseOptions& = {});
+
+    static ErrorOr<FieldMethodInfo> ParseFieldMethodInfo(ByteReader&, const ConstantPool&, const ParseOptions& = {});
+    static ErrorOr< ArenaPtr<AttributeInfo> > ParseAttribute(ByteReader&, const ConstantPool&, const ParseOptions& = {});
+
+    //Parses an attribute table (count followed by the attributes) into 
+    //attributes, seeking over the ones whose type is in skip
+    static ErrorOr<void> ParseAttributes(ByteReader&, const ConstantPool&, AttributeMask skip, 
+        std::vector< ArenaPtr<AttributeInfo> >& attributes, const ParseOptions& = {});
+
+    //Parses the body of an attribute whose header (name index & length) has
+    //already been read
+    static ErrorOr< ArenaPtr<AttributeInfo> > ParseAttributeBody(ByteReader&, 
+        const ConstantPool&, U16 nameIndex, U32 length, const ParseOptions& = {});
+
+    //Decodes codeLength bytes of bytecode (a Code attributes code array) into 
+    //instruction objects. CodeAttribute keeps its code packed instead (see 
+    //Bytecode), this is for when the instructions are to be edited.
+    static ErrorOr< std::vector< ArenaPtr<Instruction> > > ParseCode(ByteReader&, 
+        U32 codeLength, const ParseOptions& = {});
+
+    //codeOffset = offset of the instruction relative to the start of the 
+    //code array, which determines the padding of TABLESWITCH / LOOKUPSWITCH
+    static ErrorOr< ArenaPtr<Instruction> > ParseInstruction(ByteReader&, 
+        U32 codeOffset, const ParseOptions& = {});
+
+    //std::istream adapters of the above, which parse the read bytes with a
+    //ByteReader. As the bytes don't outlive the call, these always use the 
+    //default ParseOptions.
+    //ParseClassFile() buffers the remainder of the stream and seeks it to 
+    //just past the class file afterwards, which requires a seekable stream if
+    //the caller wants to continue reading from it. The others read exactly 
+    //the bytes of the parsed structure, so they can be called in a loop on
+    //any stream.
     static ErrorOr<ClassFile> ParseClassFile(std::istream&);
     static ErrorOr<ConstantPool> ParseConstantPool(std::istream&);
-    static ErrorOr< std::unique_ptr<CPInfo> > ParseConstant(std::istream&);
+    static ErrorOr< ArenaPtr<CPInfo> > ParseConstant(std::istream&);
 
     static ErrorOr<FieldMethodInfo> ParseFieldMethodInfo(std::istream&, const ConstantPool&);
-    static ErrorOr< std::unique_ptr<AttributeInfo> > ParseAttribute(std::istream&, const ConstantPool&);
+    static ErrorOr< ArenaPtr<AttributeInfo> > ParseAttribute(std::istream&, const ConstantPool&);
+
+    static ErrorOr< ArenaPtr<Instruction> > ParseInstruction(std::istream&, U32 codeOffset);
 
-    static ErrorOr<Instruction> ParseInstruction(std::istream&);
+  private:
+    static AttributeInfo::Type GetAttributeType(const ConstantPool&, U16 nameIndex);
 };
 
 
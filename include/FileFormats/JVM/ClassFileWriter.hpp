@@ -3,21 +3,53 @@
 #include "ClassFile.hpp"
 #include "../Error.hpp"
 
+#include <span>
+#include <vector>
+
 namespace FileFormats::JVM
 {
 
+struct WriteOptions
+{
+  //Recompute the max_stack & max_locals of every Code attribute with a
+  //MaxsComputer before writing, e.g. after the code got edited. The
+  //attributes of the ClassFile are updated in place.
+  bool ComputeMaxs = false;
+};
+
 class ClassFileWriter
 {
   public:
     static ErrorOr<void> WriteClassFile(std::ostream&, const ClassFile&);
+    static ErrorOr<void> WriteClassFile(std::ostream&, ClassFile&, const WriteOptions&);
     static ErrorOr<void> WriteConstantPool(std::ostream&, const ConstantPool&);
     static ErrorOr<void> WriteConstant(std::ostream&, const CPInfo&);
 
     static ErrorOr<void> WriteFieldMethod(std::ostream&, const FieldMethodInfo&);
     static ErrorOr<void> WriteAttribute(std::ostream&, const AttributeInfo&);
 
-    static ErrorOr<void> WriteInstruction(std::ostream&, const Instruction&);
+    //codeOffset = offset of the instruction relative to the start of the 
+    //code array, which determines the padding of TABLESWITCH / LOOKUPSWITCH
+    static ErrorOr<void> WriteInstruction(std::ostream&, const Instruction&, U32 codeOffset);
+
+    //Encodes instructions into a code array, e.g. to turn the result of 
+    //ClassFileParser::ParseCode() back into a Bytecode
+    static ErrorOr< std::vector<U8> > WriteCode(std::span<const ArenaPtr<Instruction>>);
+
+    //Exact size of the serialized class file, e.g. to preallocate a buffer.
+    //Every attribute length is computed once, nested ones included.
+    static size_t ComputeSerializedSize(const ClassFile&);
+
+    //Computes the exact serialized size of the class file first, then 
+    //serializes it with a single allocation and unchecked stores. The
+    //attribute lengths of the sizing pass are reused for the headers.
+    static ErrorOr< std::vector<U8> > WriteClassFileToBuffer(const ClassFile&);
+    static ErrorOr< std::vector<U8> > WriteClassFileToBuffer(ClassFile&, const WriteOptions&);
+
+    //Same as above, but serializes into the given caller-provided buffer, 
+    //which has to be large enough to hold the class file. Returns the number 
+    //of bytes written.
+    static ErrorOr<size_t> WriteClassFileToBuffer(std::span<U8>, const ClassFile&);
 };
 
 } //namespace FileFormats::JVM
-
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "./Attribute.hpp"
+#include "./Bytecode.hpp"
+#include "./Instruction.hpp"
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <span>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <type_traits>
+#include <cassert>
+
+namespace FileFormats::JVM
+{
+
+//A position in the code built by a CodeBuilder
+struct Label
+{
+  U32 Id;
+};
+
+//Assembles code in which branches, switches and exception handlers reference
+//Labels instead of offsets. Build() lays out the code, computing the branch
+//offsets & switch padding, and widens branches whose target is out of S16
+//range: GOTO -> GOTO_W, JSR -> JSR_W and IF<cond> -> IF<!cond> over a GOTO_W.
+//Branches only ever get widened, so the layout converges after at most one
+//pass per branch (in practice after two or three).
+class CodeBuilder
+{
+  public:
+    Label NewLabel();
+
+    //Binds the label to the current end of the code
+    void Bind(Label);
+
+    //Appends an instruction that isn't a branch or switch, with its operands
+    //given in order, e.g. Emit(OP_INVOKEVIRTUAL, U16{methodIndex}). The
+    //operand types have to match the instructions operand sizes.
+    template <typename... OperandTs>
+    void Emit(U8 opCode, OperandTs... operands)
+    {
+      assert(!GetOpCodeInfo(opCode).IsBranch());
+      assert(GetOpCodeInfo(opCode).Length == 0 || GetOpCodeInfo(opCode).Length == 1 + (0 + ... + sizeof(OperandTs)));
+
+      U8* bytes = this->AppendRaw(1 + (0 + ... + sizeof(OperandTs)));
+      *bytes++ = opCode;
+
+      ((bytes = storeBigEndian(bytes, operands)), ...);
+    }
+
+    //Copies an instruction that isn't a branch or switch
+    void Emit(const InstructionView&);
+
+    //IF*, GOTO(_W), JSR(_W)
+    void EmitBranch(U8 opCode, Label target);
+
+    //targets[i] = target of the case low + i
+    void EmitTableSwitch(Label defaultTarget, S32 low, std::span<const Label> targets);
+
+    //The cases don't have to be sorted
+    void EmitLookupSwitch(Label defaultTarget, std::span<const std::pair<S32, Label>> cases);
+
+    //Code between start (inclusive) and end (exclusive) is handled by handler
+    void AddExceptionHandler(Label start, Label end, Label handler, U16 catchType);
+
+    //Lays out and encodes the code into attr.Code and attr.ExceptionTable.
+    //Fails if a used label isn't bound or the code exceeds 65535 bytes.
+    ErrorOr<void> Build(CodeAttribute& attr);
+
+    //Lays out the code like Build() without encoding it, returning whether
+    //a conditional branch has to be replaced by IF<!cond> over a GOTO_W. The
+    //instruction after the GOTO_W then is a new branch target, which code
+    //with a StackMapTable needs a frame for.
+    ErrorOr<bool> InvertsBranches();
+
+    //Offset of a label in the code produced by the last Build()
+    std::optional<U32> GetOffset(Label) const;
+
+    //Clears the code, keeping the allocated memory for reuse
+    void Reset();
+
+  private:
+    template <typename T>
+    static U8* storeBigEndian(U8* dest, T value)
+    {
+      static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "operands have to be integers");
+
+      if constexpr (std::is_enum_v<T>)
+        return storeBigEndian(dest, static_cast< std::underlying_type_t<T> >(value));
+      else
+      {
+        auto bits = static_cast< std::make_unsigned_t<T> >(value);
+
+        for (size_t i = 0; i < sizeof(T); i++)
+          dest[i] = static_cast<U8>(bits >> (8 * (sizeof(T) - 1 - i)));
+
+        return dest + sizeof(T);
+      }
+    }
+
+    struct Item
+    {
+      enum class Kind : U8
+      {
+        Raw,          //instructions without labels
+        Branch,
+        TableSwitch,
+        LookupSwitch,
+      };
+
+      Kind ItemKind;
+      U8 OpCode;
+      bool IsWide;
+
+      U32 Target; //label id of the branch target / switch default
+      U32 Begin;  //range into m_bytes (Raw) or m_cases (switches)
+      U32 End;
+    };
+
+    struct Handler
+    {
+      U32 Start;
+      U32 End;
+      U32 HandlerLabel;
+      U16 CatchType;
+    };
+
+    static constexpr U32 Unbound = ~U32{0};
+
+    U8* AppendRaw(size_t size);
+    ErrorOr<void> CheckLabel(U32 label) const;
+    ErrorOr<void> CheckItems() const;
+
+    U32 GetItemSize(const Item&, U32 pc) const;
+    U32 Layout();
+    void Encode(std::vector<U8>& code) const;
+
+    std::vector<Item> m_items;
+    std::vector<U8> m_bytes;
+    std::vector< std::pair<S32, U32> > m_cases; //match, label id
+    std::vector<Handler> m_handlers;
+
+    std::vector<U32> m_labelItems;  //index of the item each label is bound before
+    std::vector<U32> m_itemOffsets; //offset of each item (+ end of code) in the current layout
+
+    bool m_rawOpen{false}; //whether the next raw bytes can be appended to the last item
+};
+
+} //namespace FileFormats::JVM
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "./Bytecode.hpp"
+#include "./Instruction.hpp"
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <span>
+
+namespace FileFormats::JVM
+{
+
+//Decodes instructions straight from the code bytes and passes their operands
+//to a callback per instruction family, without creating Instruction objects
+//or allocating. Derive from it (CRTP) and define the callbacks of the
+//families you are interested in, all others do nothing:
+//
+//  struct CallScanner : CodeVisitor<CallScanner>
+//  {
+//    void VisitInvoke(U32 pc, U8 opCode, U16 methodIndex) { ... }
+//  };
+//
+//pc = offset of the instruction into the code. Branch offsets are relative to
+//the pc of the branch, like in the bytecode. Callbacks have to be public (or
+//CodeVisitor a friend).
+template <typename Derived>
+class CodeVisitor
+{
+  public:
+    void Visit(const Bytecode& code) { this->VisitUnchecked(code.GetBytes()); }
+
+    //Validates the code first, the callbacks are only called for valid code
+    ErrorOr<void> Visit(std::span<const U8> code)
+    {
+      auto result = Bytecode::Validate(code);
+      if (result.IsError())
+        return result;
+
+      this->VisitUnchecked(code);
+      return {};
+    }
+
+    //Instructions without operands (arithmetic, conversions, array accesses,
+    //returns, DUP / POP, ...) except the xLOAD_n / xSTORE_n ones
+    void VisitSimple(U32 pc, U8 opCode) {}
+
+    //xLOAD / xSTORE / RET, including the xLOAD_n / xSTORE_n forms and WIDE.
+    //opCode is the load / store / RET opcode, not OP_WIDE.
+    void VisitLocal(U32 pc, U8 opCode, U16 index) {}
+
+    //IINC, including WIDE
+    void VisitIInc(U32 pc, U16 index, S16 value) {}
+
+    //BIPUSH / SIPUSH
+    void VisitPush(U32 pc, U8 opCode, S16 value) {}
+
+    //LDC / LDC_W / LDC2_W
+    void VisitConstant(U32 pc, U8 opCode, U16 constantIndex) {}
+
+    //GETSTATIC / PUTSTATIC / GETFIELD / PUTFIELD
+    void VisitField(U32 pc, U8 opCode, U16 fieldrefIndex) {}
+
+    //INVOKE*, methodIndex references a (Interface)Methodref or, for
+    //INVOKEDYNAMIC, an InvokeDynamic constant
+    void VisitInvoke(U32 pc, U8 opCode, U16 methodIndex) {}
+
+    //NEW / ANEWARRAY / CHECKCAST / INSTANCEOF
+    void VisitType(U32 pc, U8 opCode, U16 classIndex) {}
+
+    void VisitNewArray(U32 pc, AType type) {}
+    void VisitMultiANewArray(U32 pc, U16 classIndex, U8 dimensions) {}
+
+    //IF*, GOTO(_W), JSR(_W)
+    void VisitBranch(U32 pc, U8 opCode, S32 offset) {}
+
+    //offsets[i] = offset of the case low + i
+    void VisitTableSwitch(U32 pc, S32 defaultOffset, S32 low, BigEndianArrayView<S32> offsets) {}
+
+    //match, offset pairs, sorted by match (same layout as LOOKUPSWITCH::Pairs)
+    void VisitLookupSwitch(U32 pc, S32 defaultOffset, BigEndianArrayView<S32> pairs) {}
+
+  private:
+    Derived& GetDerived() { return static_cast<Derived&>(*this); }
+
+    void VisitUnchecked(std::span<const U8> code)
+    {
+      const U8* bytes = code.data();
+      U32 size = static_cast<U32>(code.size());
+
+      for (U32 pc = 0; pc < size; )
+      {
+        pc += this->VisitInstruction(bytes, pc);
+      }
+    }
+
+    //returns the length of the instruction
+    U32 VisitInstruction(const U8* code, U32 pc)
+    {
+      const U8* bytes = code + pc;
+      U8 opCode = bytes[0];
+
+      switch (opCode)
+      {
+        case OP_ILOAD:  case OP_LLOAD:  case OP_FLOAD:  case OP_DLOAD:  case OP_ALOAD:
+        case OP_ISTORE: case OP_LSTORE: case OP_FSTORE: case OP_DSTORE: case OP_ASTORE:
+        case OP_RET:
+          this->GetDerived().VisitLocal(pc, opCode, bytes[1]);
+          return 2;
+
+        case OP_ILOAD_0:  case OP_ILOAD_1:  case OP_ILOAD_2:  case OP_ILOAD_3:
+        case OP_LLOAD_0:  case OP_LLOAD_1:  case OP_LLOAD_2:  case OP_LLOAD_3:
+        case OP_FLOAD_0:  case OP_FLOAD_1:  case OP_FLOAD_2:  case OP_FLOAD_3:
+        case OP_DLOAD_0:  case OP_DLOAD_1:  case OP_DLOAD_2:  case OP_DLOAD_3:
+        case OP_ALOAD_0:  case OP_ALOAD_1:  case OP_ALOAD_2:  case OP_ALOAD_3:
+          this->GetDerived().VisitLocal(pc, opCode, static_cast<U16>((opCode - OP_ILOAD_0) % 4));
+          return 1;
+
+        case OP_ISTORE_0: case OP_ISTORE_1: case OP_ISTORE_2: case OP_ISTORE_3:
+        case OP_LSTORE_0: case OP_LSTORE_1: case OP_LSTORE_2: case OP_LSTORE_3:
+        case OP_FSTORE_0: case OP_FSTORE_1: case OP_FSTORE_2: case OP_FSTORE_3:
+        case OP_DSTORE_0: case OP_DSTORE_1: case OP_DSTORE_2: case OP_DSTORE_3:
+        case OP_ASTORE_0: case OP_ASTORE_1: case OP_ASTORE_2: case OP_ASTORE_3:
+          this->GetDerived().VisitLocal(pc, opCode, static_cast<U16>((opCode - OP_ISTORE_0) % 4));
+          return 1;
+
+        case OP_IINC:
+          this->GetDerived().VisitIInc(pc, bytes[1], static_cast<S8>(bytes[2]));
+          return 3;
+
+        case OP_BIPUSH:
+          this->GetDerived().VisitPush(pc, opCode, static_cast<S8>(bytes[1]));
+          return 2;
+
+        case OP_SIPUSH:
+          this->GetDerived().VisitPush(pc, opCode, LoadBigEndian<S16>(bytes + 1));
+          return 3;
+
+        case OP_LDC:
+          this->GetDerived().VisitConstant(pc, opCode, bytes[1]);
+          return 2;
+
+        case OP_LDC_W: case OP_LDC2_W:
+          this->GetDerived().VisitConstant(pc, opCode, LoadBigEndian<U16>(bytes + 1));
+          return 3;
+
+        case OP_GETSTATIC: case OP_PUTSTATIC: case OP_GETFIELD: case OP_PUTFIELD:
+          this->GetDerived().VisitField(pc, opCode, LoadBigEndian<U16>(bytes + 1));
+          return 3;
+
+        case OP_INVOKEVIRTUAL: case OP_INVOKESPECIAL: case OP_INVOKESTATIC:
+          this->GetDerived().VisitInvoke(pc, opCode, LoadBigEndian<U16>(bytes + 1));
+          return 3;
+
+        case OP_INVOKEINTERFACE: case OP_INVOKEDYNAMIC:
+          this->GetDerived().VisitInvoke(pc, opCode, LoadBigEndian<U16>(bytes + 1));
+          return 5;
+
+        case OP_NEW: case OP_ANEWARRAY: case OP_CHECKCAST: case OP_INSTANCEOF:
+          this->GetDerived().VisitType(pc, opCode, LoadBigEndian<U16>(bytes + 1));
+          return 3;
+
+        case OP_NEWARRAY:
+          this->GetDerived().VisitNewArray(pc, static_cast<AType>(bytes[1]));
+          return 2;
+
+        case OP_MULTIANEWARRAY:
+          this->GetDerived().VisitMultiANewArray(pc, LoadBigEndian<U16>(bytes + 1), bytes[3]);
+          return 4;
+
+        case OP_IFEQ:      case OP_IFNE:      case OP_IFLT:      case OP_IFGE:
+        case OP_IFGT:      case OP_IFLE:      case OP_IF_ICMPEQ: case OP_IF_ICMPNE:
+        case OP_IF_ICMPLT: case OP_IF_ICMPGE: case OP_IF_ICMPGT: case OP_IF_ICMPLE:
+        case OP_IF_ACMPEQ: case OP_IF_ACMPNE: case OP_GOTO:      case OP_JSR:
+        case OP_IFNULL:    case OP_IFNONNULL:
+          this->GetDerived().VisitBranch(pc, opCode, LoadBigEndian<S16>(bytes + 1));
+          return 3;
+
+        case OP_GOTO_W: case OP_JSR_W:
+          this->GetDerived().VisitBranch(pc, opCode, LoadBigEndian<S32>(bytes + 1));
+          return 5;
+
+        case OP_TABLESWITCH:
+        {
+          U32 padding = GetSwitchPadding(pc);
+          const U8* operands = bytes + 1 + padding;
+
+          S32 def  = LoadBigEndian<S32>(operands);
+          S32 low  = LoadBigEndian<S32>(operands + 4);
+          S32 high = LoadBigEndian<S32>(operands + 8);
+          size_t count = static_cast<size_t>(static_cast<S64>(high) - low + 1);
+
+          this->GetDerived().VisitTableSwitch(pc, def, low, BigEndianArrayView<S32>{ operands + 12, count });
+          return static_cast<U32>(1 + padding + 12 + count * 4);
+        }
+
+        case OP_LOOKUPSWITCH:
+        {
+          U32 padding = GetSwitchPadding(pc);
+          const U8* operands = bytes + 1 + padding;
+
+          S32 def = LoadBigEndian<S32>(operands);
+          size_t nPairs = static_cast<size_t>(LoadBigEndian<S32>(operands + 4));
+
+          this->GetDerived().VisitLookupSwitch(pc, def, BigEndianArrayView<S32>{ operands + 8, nPairs * 2 });
+          return static_cast<U32>(1 + padding + 8 + nPairs * 8);
+        }
+
+        case OP_WIDE:
+        {
+          U8 modified = bytes[1];
+          U16 index = LoadBigEndian<U16>(bytes + 2);
+
+          if (modified == OP_IINC)
+          {
+            this->GetDerived().VisitIInc(pc, index, LoadBigEndian<S16>(bytes + 4));
+            return 6;
+          }
+
+          this->GetDerived().VisitLocal(pc, modified, index);
+          return 4;
+        }
+
+        default:
+          this->GetDerived().VisitSimple(pc, opCode);
+          return 1;
+      }
+    }
+};
+
+//Runs the visitor over validated code
+template <typename VisitorT>
+void VisitCode(const Bytecode& code, VisitorT&& visitor)
+{
+  visitor.Visit(code);
+}
+
+//Validates the code first, the visitor is only called for valid code
+template <typename VisitorT>
+ErrorOr<void> VisitCode(std::span<const U8> code, VisitorT&& visitor)
+{
+  return visitor.Visit(code);
+}
+
+} //namespace FileFormats::JVM
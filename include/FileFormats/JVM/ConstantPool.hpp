@@ -2,11 +2,16 @@
 
 #include "../Defs.hpp"
 #include "../Error.hpp"
+#include "../Arena.hpp"
 
 #include <vector>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <functional>
+#include <cassert>
+#include <typeinfo>
 
 namespace FileFormats::JVM
 {
@@ -29,8 +34,33 @@ struct CPInfo
     MethodHandle       = 15,
     MethodType         = 16,
     InvokeDynamic      = 18,
+
+    Unusable           = 0, //Non standard, index 0 & entries after Long / Double
   };
-  static std::string_view GetTypeName(Type type);
+  static constexpr std::string_view GetTypeName(Type type)
+  {
+    switch (type)
+    {
+      case Type::Class:              return "Class";
+      case Type::Fieldref:           return "Fieldref";
+      case Type::Methodref:          return "Methodref";
+      case Type::InterfaceMethodref: return "InterfaceMethodref";
+      case Type::String:             return "String";
+      case Type::Integer:            return "Integer";
+      case Type::Float:              return "Float";
+      case Type::Long:               return "Long";
+      case Type::Double:             return "Double";
+      case Type::NameAndType:        return "NameAndType";
+      case Type::UTF8:               return "UTF8";
+      case Type::MethodHandle:       return "MethodHandle";
+      case Type::MethodType:         return "MethodType";
+      case Type::InvokeDynamic:      return "InvokeDynamic";
+
+      case Type::Unusable:           return "_Unusable";
+    }
+
+    return {};
+  }
 
   std::string_view GetName() const;
   Type GetType() const;
@@ -110,12 +140,41 @@ struct NameAndTypeInfo : public CPInfo
   U16 DescriptorIndex;
 };
 
+//Holds either a view of bytes owned by someone else (e.g. the parsed class 
+//file or the constant pool) or its own copy. The view is only copied when the
+//string is mutated through GetMutable() / Set().
+//The bytes are in the JVM's Modified UTF-8 encoding, see DecodeModifiedUTF8().
 struct UTF8Info : public CPInfo
 {
   UTF8Info() : CPInfo(Type::UTF8) {}
-  std::string String;
+  UTF8Info(std::string_view view) : CPInfo(Type::UTF8), m_view{view} {}
+
+  std::string_view Get() const { return m_isOwned ? std::string_view{m_owned} : m_view; }
+
+  //Makes the info reference the given bytes, which have to outlive it
+  void SetView(std::string_view view);
+  void Set(std::string str);
+
+  std::string& GetMutable();
+
+  bool IsOwned() const { return m_isOwned; }
+
+  //See DecodeModifiedUTF8()
+  std::string_view GetDecoded(std::string& scratch) const;
+
+  private:
+  std::string_view m_view;
+  std::string m_owned;
+  bool m_isOwned{false};
 };
 
+//Converts the JVM's Modified UTF-8 (NUL encoded as 0xC0 0x80, supplementary 
+//characters encoded as two 3 byte surrogates) to standard UTF-8. Most strings
+//don't contain any of these, in which case the input itself is returned. 
+//Otherwise the converted string is written into and returned as a view of 
+//scratch. Unpaired surrogates are replaced by U+FFFD.
+std::string_view DecodeModifiedUTF8(std::string_view str, std::string& scratch);
+
 struct MethodHandleInfo : public CPInfo
 {
   MethodHandleInfo() : CPInfo(Type::MethodHandle) {}
@@ -136,62 +195,282 @@ struct InvokeDynamicInfo : public CPInfo
   U16 NameAndTypeIndex;
 };
 
+//The pool is stored flat: a tag per index plus one fixed width 8 byte slot 
+//holding the constants numeric value or indices, with UTF8 payloads stored out
+//of line. Lookups are a couple of array loads, no per constant objects or RTTI
+//involved. The CPInfo structs above are only used as values to add constants 
+//or to get a copy of one through Get<T>() / operator[].
+//
+//A class file can't hold more than 65535 entries (including index 0), adding
+//constants beyond that fails.
 class ConstantPool
 {
   public:
+    //constant_pool_count is a U16, index 0 included
+    static constexpr unsigned MaxCount = 0xFFFF;
+
     ConstantPool(U16 n=0);
+
+    ConstantPool(ConstantPool&&) = default;
+    ConstantPool& operator=(ConstantPool&&) = default;
+
     void Reserve(U16 n);
 
+    //Arena that copies of UTF8 payloads are stored in. By default the pool 
+    //allocates its own. Has to be set before any constant is added.
+    //UTF8 constants parsed with ParseOptions::ZeroCopyStrings aren't copied,
+    //they reference the parsed bytes until they're changed by SetUTF8().
+    void SetStringStorage(Arena& storage);
+
     //Returns either the name of the constant, if the given const type has a 
     //name (such as in the case of UTF8 or any class that has a name field 
     //pointing to a UTF8), OR returns the stringified version of the const type
     std::string_view GetConstNameOrTypeStr(U16 index) const;
 
-    void Add(std::unique_ptr<CPInfo>&& info);
-    void Add(CPInfo* info);
-
+    //Returns the index of the added constant
+    ErrorOr<U16> Add(const CPInfo& info);
+
+    //nullptr adds an unusable entry (as required after Long & Double constants)
+    ErrorOr<void> Add(ArenaPtr<CPInfo>&& info);
+    ErrorOr<void> Add(CPInfo* info);
+
+    //Reverse lookups, return the index of the first constant equal to the 
+    //given one, 0 if there is none. Constants referencing other constants 
+    //are compared by their indices.
+    //The first lookup builds a hash index of the pool, which is kept up to 
+    //date by all following modifications.
+    U16 Find(const CPInfo& info);
+    U16 FindUTF8(std::string_view str);
+
+    //Return the index of an equal constant, adding it if there is none. 
+    //Unlike Add() these also add the unusable entry after Long & Double.
+    ErrorOr<U16> FindOrAdd(const CPInfo& info);
+    ErrorOr<U16> FindOrAddUTF8(std::string_view str);
+    ErrorOr<U16> FindOrAddString(std::string_view str);
+    ErrorOr<U16> FindOrAddClass(std::string_view name);
+    ErrorOr<U16> FindOrAddNameAndType(std::string_view name, std::string_view descriptor);
+    ErrorOr<U16> FindOrAddFieldref(std::string_view className, std::string_view name, std::string_view descriptor);
+    ErrorOr<U16> FindOrAddMethodref(std::string_view className, std::string_view name, std::string_view descriptor);
+    ErrorOr<U16> FindOrAddInterfaceMethodref(std::string_view className, std::string_view name, std::string_view descriptor);
+
+    //Compatibility wrappers for code written against the pool of CPInfo 
+    //objects. The constant is copied into a CPInfo object on first access, 
+    //which is kept until the constant is changed (see SetUTF8()), so changes
+    //have to go through the pool and these aren't thread safe. The typed 
+    //accessors below don't allocate.
     template <class T = CPInfo>
-    ErrorOr< std::reference_wrapper<T> > Get(U16 index) const
+    ErrorOr< std::reference_wrapper<const T> > Get(U16 index) const
     {
-      if(index >= m_pool.size() || index == 0)
+      if(index >= m_tags.size() || index == 0)
       {
         return Error::FromFormatStr("ConstantPool.Get(%u) failed because given index is outside the pools range (1-%u)", 
             static_cast<unsigned int>(index), 
             static_cast<unsigned int>(this->Count()));
       }
 
-      if (m_pool[index].get() == nullptr)
+      const CPInfo* info = this->GetInfo(index);
+
+      if (info == nullptr)
       {
-        return Error::FromFormatStr("ConstantPool.Get(%u) failed because constant at given index is nullptr", 
+        return Error::FromFormatStr("ConstantPool.Get(%u) failed because constant at given index is unusable", 
             static_cast<unsigned int>(index));
       }
 
-      T* ptr = dynamic_cast<T*>( m_pool[index].get() );
+      const T* ptr = dynamic_cast<const T*>(info);
 
       if (ptr == nullptr)
       {
-        return Error::FromFormatStr("ConstantPool.Get<%s>(%u) failed to convert CPInfo to requested type (dynamic cast failed)", 
+        return Error::FromFormatStr("ConstantPool.Get<%s>(%u) failed because the constant at given index is of type %.*s", 
             typeid(T).name(), 
-            static_cast<unsigned int>(index));
+            static_cast<unsigned int>(index),
+            static_cast<int>(CPInfo::GetTypeName(m_tags[index]).size()), CPInfo::GetTypeName(m_tags[index]).data());
       }
 
-      return *ptr;
+      return std::cref(*ptr);
     }
 
-    CPInfo* operator[](U16 index)
+    //nullptr for index 0, unusable entries and out of range indices
+    const CPInfo* operator[](U16 index) const
     {
-      return m_pool[index].get();
+      return this->GetInfo(index);
     }
 
-    const CPInfo* operator[](U16 index) const
+    //Type of the constant at index, Type::Unusable for index 0, the entries
+    //following Long & Double constants and out of range indices
+    CPInfo::Type GetType(U16 index) const
+    {
+      return index < m_tags.size() ? m_tags[index] : CPInfo::Type::Unusable;
+    }
+
+    bool Is(U16 index, CPInfo::Type type) const { return this->GetType(index) == type; }
+
+    //Typed accessors. The index & type of the constant are checked, so they
+    //are safe on indices read from a class file: if the constant isn't of
+    //the given type, the string accessors return an empty string and the
+    //others 0. Use Is() / GetType() to tell these apart from actual values.
+
+    //UTF8
+    std::string_view GetUTF8(U16 index) const
+    {
+      if (!this->Is(index, CPInfo::Type::UTF8))
+        return {};
+
+      return m_utf8[ static_cast<size_t>(m_slots[index]) ];
+    }
+
+    //UTF8 converted to standard UTF-8, see DecodeModifiedUTF8()
+    std::string_view GetDecodedUTF8(U16 index, std::string& scratch) const
+    {
+      return DecodeModifiedUTF8(this->GetUTF8(index), scratch);
+    }
+
+    //Replaces the value of a UTF8 constant. The new value is copied into the
+    //pools string storage. Fails if the constant isn't a UTF8 constant.
+    ErrorOr<void> SetUTF8(U16 index, std::string_view str);
+
+    //Class: name index, String: string index, MethodType: descriptor index,
+    //Fieldref / Methodref / InterfaceMethodref: class index, 
+    //NameAndType: name index, InvokeDynamic: bootstrap method attr index,
+    //MethodHandle: reference kind
+    U16 GetFirstIndex(U16 index) const
+    {
+      return hasIndices(this->GetType(index)) ? static_cast<U16>(m_slots[index]) : 0;
+    }
+
+    //Fieldref / Methodref / InterfaceMethodref / InvokeDynamic: name and type 
+    //index, NameAndType: descriptor index, MethodHandle: reference index
+    U16 GetSecondIndex(U16 index) const
+    {
+      return hasIndices(this->GetType(index)) ? static_cast<U16>(m_slots[index] >> 16) : 0;
+    }
+
+    //Integer & Float: Bytes
+    U32 GetU32(U16 index) const
+    {
+      if (!this->Is(index, CPInfo::Type::Integer) && !this->Is(index, CPInfo::Type::Float))
+        return 0;
+
+      return static_cast<U32>(m_slots[index]);
+    }
+
+    //Long & Double: (HighBytes << 32) | LowBytes
+    U64 GetU64(U16 index) const
+    {
+      if (!this->Is(index, CPInfo::Type::Long) && !this->Is(index, CPInfo::Type::Double))
+        return 0;
+
+      return m_slots[index];
+    }
+
+    //Name of a Class constant
+    std::string_view GetClassName(U16 index) const
     {
-      return m_pool[index].get();
+      return this->GetUTF8(this->GetFirstIndex(index));
     }
 
     //Count = number of constants + 1
     U16 Count() const;
+
   private:
-    std::vector< std::unique_ptr<CPInfo> > m_pool;
+    friend class ClassFileParser;
+
+    static constexpr bool hasIndices(CPInfo::Type type)
+    {
+      switch (type)
+      {
+        case CPInfo::Type::Class:
+        case CPInfo::Type::String:
+        case CPInfo::Type::MethodType:
+        case CPInfo::Type::Fieldref:
+        case CPInfo::Type::Methodref:
+        case CPInfo::Type::InterfaceMethodref:
+        case CPInfo::Type::NameAndType:
+        case CPInfo::Type::InvokeDynamic:
+        case CPInfo::Type::MethodHandle:
+          return true;
+
+        default:
+          return false;
+      }
+    }
+
+    ErrorOr<U16> AddSlot(CPInfo::Type type, U64 slot);
+    ErrorOr<U16> AddIndices(CPInfo::Type type, U16 first, U16 second = 0);
+    ErrorOr<U16> AddUTF8Slot(std::string_view str);
+
+    //Adds the string without copying it, it has to outlive the pool
+    ErrorOr<U16> AddUTF8View(std::string_view str);
+
+    Arena& GetStringStorage();
+
+    //AttributeInfo::Type of the attributes named by the UTF8 constant at
+    //index, Type::Raw for non standard names
+    U8 GetAttributeType(U16 index) const
+    {
+      assert(this->Is(index, CPInfo::Type::UTF8));
+      return m_utf8AttributeTypes[ static_cast<size_t>(m_slots[index]) ];
+    }
+
+    const CPInfo* GetInfo(U16 index) const;
+
+    template <class T>
+    std::unique_ptr<CPInfo> LoadInfo(U16 index) const;
+
+    void BuildIndex();
+    void AddToIndex(U16 index);
+
+    ErrorOr<U16> FindOrAddSlot(CPInfo::Type type, U64 slot);
+    ErrorOr<U16> FindOrAddMemberref(CPInfo::Type type, std::string_view className, std::string_view name, std::string_view descriptor);
+
+    void Load(U16 index, ClassInfo& info) const;
+    void Load(U16 index, FieldrefInfo& info) const;
+    void Load(U16 index, MethodrefInfo& info) const;
+    void Load(U16 index, InterfaceMethodrefInfo& info) const;
+    void Load(U16 index, StringInfo& info) const;
+    void Load(U16 index, IntegerInfo& info) const;
+    void Load(U16 index, FloatInfo& info) const;
+    void Load(U16 index, LongInfo& info) const;
+    void Load(U16 index, DoubleInfo& info) const;
+    void Load(U16 index, NameAndTypeInfo& info) const;
+    void Load(U16 index, UTF8Info& info) const;
+    void Load(U16 index, MethodHandleInfo& info) const;
+    void Load(U16 index, MethodTypeInfo& info) const;
+    void Load(U16 index, InvokeDynamicInfo& info) const;
+
+    std::vector<CPInfo::Type> m_tags;
+    std::vector<U64> m_slots;
+    std::vector<std::string_view> m_utf8;
+
+    //per UTF8 constant, classified once when it's added or changed so the
+    //parser dispatches attributes without comparing their names
+    std::vector<U8> m_utf8AttributeTypes;
+
+    //copies handed out by Get() / operator[], per index
+    mutable std::vector< std::unique_ptr<CPInfo> > m_infos;
+
+    struct ValueKey
+    {
+      CPInfo::Type Tag;
+      U64 Slot;
+
+      bool operator==(const ValueKey&) const = default;
+    };
+
+    struct ValueKeyHash
+    {
+      size_t operator()(const ValueKey& key) const
+      {
+        return std::hash<U64>{}(key.Slot * 0x9E3779B97F4A7C15ull ^ static_cast<U64>(key.Tag));
+      }
+    };
+
+    //reverse lookup index, only built once it's needed (see Find())
+    bool m_indexed{false};
+    std::unordered_map<ValueKey, U16, ValueKeyHash> m_valueIndex;
+    std::unordered_map<std::string_view, U16> m_utf8Index;
+
+    Arena* m_stringStorage{nullptr};
+    std::unique_ptr<Arena> m_ownedStringStorage;
 };
 
 }  //namespace FileFormats::JVM
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "./Attribute.hpp"
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <span>
+#include <vector>
+#include <optional>
+
+namespace FileFormats::JVM
+{
+
+struct CFGEdge
+{
+  enum class Type : U8
+  {
+    FallThrough,
+    Branch,    //branch, switch or JSR target
+    Exception, //from a block inside of a try range to its handler
+  };
+
+  //index of the successor, or in predecessor lists of the predecessor
+  U32 Block;
+  Type EdgeType;
+};
+
+struct BasicBlock
+{
+  U32 StartPC;
+  U32 EndPC; //exclusive
+  U32 LastInstructionPC;
+
+  //index ranges into the graphs successor / predecessor arrays
+  U32 SuccessorsBegin;
+  U32 SuccessorsEnd;
+  U32 PredecessorsBegin;
+  U32 PredecessorsEnd;
+
+  bool IsExceptionHandler;
+};
+
+//Basic block control flow graph of a methods code. Block 0 is the entry.
+//Blocks and edges are stored in flat arrays, blocks reference their edges by
+//index ranges.
+//
+//A block ending with JSR has a branch edge to the subroutine, the instruction
+//following the JSR starts a new block. RET blocks have no successors, as
+//where they continue isn't known statically.
+class ControlFlowGraph
+{
+  public:
+    //Same as using a ControlFlowGraphBuilder once
+    static ErrorOr<ControlFlowGraph> Build(const CodeAttribute&);
+
+    const std::vector<BasicBlock>& GetBlocks() const { return m_blocks; }
+    size_t GetBlockCount() const { return m_blocks.size(); }
+
+    std::span<const CFGEdge> GetSuccessors(U32 blockIndex) const
+    {
+      const BasicBlock& block = m_blocks[blockIndex];
+      return std::span<const CFGEdge>{m_successors}.subspan(block.SuccessorsBegin,
+          block.SuccessorsEnd - block.SuccessorsBegin);
+    }
+
+    std::span<const CFGEdge> GetPredecessors(U32 blockIndex) const
+    {
+      const BasicBlock& block = m_blocks[blockIndex];
+      return std::span<const CFGEdge>{m_predecessors}.subspan(block.PredecessorsBegin,
+          block.PredecessorsEnd - block.PredecessorsBegin);
+    }
+
+    //Index of the block containing the given pc, nullopt if it is out of range
+    std::optional<U32> GetBlockIndex(U32 pc) const;
+
+  private:
+    friend class ControlFlowGraphBuilder;
+
+    std::vector<BasicBlock> m_blocks;
+    std::vector<CFGEdge> m_successors;
+    std::vector<CFGEdge> m_predecessors;
+};
+
+//Builds control flow graphs in a linear pass over the code. Keeps its scratch
+//buffers (and reuses the storage of the graph it builds into) between builds,
+//so building many graphs with one builder doesn't allocate once the buffers
+//have grown large enough. Not thread safe, use one builder per thread.
+class ControlFlowGraphBuilder
+{
+  public:
+    ErrorOr<void> Build(const CodeAttribute&, ControlFlowGraph& cfg);
+
+  private:
+    struct PendingEdge
+    {
+      U32 From; //pc of the branch instruction, later the block index
+      U32 To;   //target pc, later the block index
+      CFGEdge::Type EdgeType;
+    };
+
+    ErrorOr<void> FindLeaders(const CodeAttribute&);
+    ErrorOr<void> AddBranchTarget(U32 pc, S64 target, U32 codeLength);
+    void CreateBlocks(const CodeAttribute&, ControlFlowGraph& cfg);
+    void CreateEdges(const CodeAttribute&, ControlFlowGraph& cfg);
+
+    enum PCFlag : U8
+    {
+      PCF_INSTRUCTION = 1 << 0, //an instruction starts here
+      PCF_LEADER      = 1 << 1, //a block starts here
+      PCF_HANDLER     = 1 << 2, //an exception handler starts here
+    };
+
+    std::vector<U8> m_pcFlags;        //PCFlag's per pc, + 1 for the end of the code
+    std::vector<U32> m_blockOf;       //block index per pc
+    std::vector<PendingEdge> m_edges;
+    std::vector<U32> m_counts;
+    std::vector<U32> m_stamps;        //per block, for deduplicating edges
+};
+
+} //namespace FileFormats::JVM
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <string_view>
+#include <iterator>
+#include <cstddef>
+
+namespace FileFormats::JVM
+{
+
+//Number of local variable / operand stack slots a value of the type starting
+//with the given descriptor character takes: 2 for long & double, 0 for void
+constexpr U8 GetDescriptorSlotCount(char descriptorChar)
+{
+  switch (descriptorChar)
+  {
+    case 'J': case 'D': return 2;
+    case 'V':           return 0;
+    default:            return 1;
+  }
+}
+
+//Length of the field type (e.g. "I", "Ljava/lang/String;" or "[[J") at the
+//start of str, 0 if str doesn't start with a valid field type
+size_t GetFieldTypeLength(std::string_view str);
+
+inline bool IsValidFieldDescriptor(std::string_view str)
+{
+  return !str.empty() && GetFieldTypeLength(str) == str.size();
+}
+
+//A method descriptor, e.g. "(ILjava/lang/String;)V". Only references the
+//descriptor string, which has to outlive it. The parameter types are iterated
+//without allocating:
+//
+//  for (std::string_view param : descriptor) ...
+class MethodDescriptor
+{
+  public:
+    class Iterator
+    {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::string_view;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = std::string_view;
+
+        Iterator() = default;
+        Iterator(std::string_view rest) : m_rest{rest} {}
+
+        std::string_view operator*() const { return m_rest.substr(0, GetFieldTypeLength(m_rest)); }
+
+        Iterator& operator++()
+        {
+          m_rest.remove_prefix(GetFieldTypeLength(m_rest));
+          return *this;
+        }
+
+        Iterator operator++(int) { Iterator prev = *this; ++*this; return prev; }
+
+        bool operator==(const Iterator& other) const { return m_rest.size() == other.m_rest.size(); }
+
+      private:
+        std::string_view m_rest;
+    };
+
+    MethodDescriptor() = default;
+
+    static ErrorOr<MethodDescriptor> Parse(std::string_view descriptor);
+
+    //The parameter types without the parentheses
+    std::string_view GetParameters() const { return m_parameters; }
+
+    //A field type or "V"
+    std::string_view GetReturnType() const { return m_returnType; }
+
+    U16 GetParameterCount() const { return m_parameterCount; }
+
+    //Local variable slots taken by the parameters, not counting "this"
+    U16 GetParameterSlots() const { return m_parameterSlots; }
+
+    //Operand stack slots taken by the return value
+    U8 GetReturnSlots() const { return GetDescriptorSlotCount(m_returnType[0]); }
+
+    Iterator begin() const { return { m_parameters }; }
+    Iterator end() const { return { m_parameters.substr(m_parameters.size()) }; }
+
+  private:
+    std::string_view m_parameters;
+    std::string_view m_returnType{"V"};
+    U16 m_parameterCount{0};
+    U16 m_parameterSlots{0};
+};
+
+} //namespace FileFormats::JVM
@@ -5,6 +5,7 @@
 
 #include <string_view>
 #include <vector>
+#include <array>
 
 namespace FileFormats::JVM
 {
@@ -219,18 +220,397 @@ enum OpCode : U8
   OP_IMPDEP2        = 0XFF,
 };
 
-ErrorOr<std::string_view> GetOpCodeMnemonic(U8);
+//How the operands following an opcode are encoded
+enum class OperandLayout : U8
+{
+  None,
+  UByte,           //U8 (local variable / constant pool index)
+  SByte,           //S8
+  UShort,          //U16 (constant pool index)
+  SShort,          //S16 (branch offset / constant)
+  SInt,            //S32 (wide branch offset)
+  AType,           //NEWARRAY
+  IInc,            //U8 index, S8 const
+  MultiANewArray,  //U16 index, U8 dimensions
+  InvokeInterface, //U16 index, U8 count, U8 0
+  InvokeDynamic,   //U16 index, U8 0, U8 0
+  TableSwitch,     //variable length
+  LookupSwitch,    //variable length
+  Wide,            //variable length
+  Invalid,         //undefined opcode
+};
+
+//Number of operand bytes of the fixed length layouts
+constexpr size_t GetOperandLength(OperandLayout layout)
+{
+  switch (layout)
+  {
+    case OperandLayout::UByte:
+    case OperandLayout::SByte:
+    case OperandLayout::AType:           return 1;
+    case OperandLayout::UShort:
+    case OperandLayout::SShort:
+    case OperandLayout::IInc:            return 2;
+    case OperandLayout::MultiANewArray:  return 3;
+    case OperandLayout::SInt:
+    case OperandLayout::InvokeInterface:
+    case OperandLayout::InvokeDynamic:   return 4;
+    default:                             return 0;
+  }
+}
+
+enum OpCodeFlag : U8
+{
+  OPF_BRANCH      = 1 << 0, //has (a) branch target(s), including switches & JSR
+  OPF_CONDITIONAL = 1 << 1, //branch that may also continue with the next instruction
+  OPF_SWITCH      = 1 << 2, //TABLESWITCH & LOOKUPSWITCH
+  OPF_SUBROUTINE  = 1 << 3, //JSR, JSR_W & RET
+  OPF_INVOKE      = 1 << 4, //INVOKE*
+  OPF_FIELD       = 1 << 5, //GET/PUT FIELD/STATIC
+  OPF_RETURN      = 1 << 6, //*RETURN
+  OPF_THROW       = 1 << 7, //ATHROW
+};
+
+//Stack effect that depends on the operands (the referenced descriptor, the 
+//WIDE modified opcode or the MULTIANEWARRAY dimensions)
+inline constexpr S8 VariableStackEffect = -1;
+
+struct OpCodeInfo
+{
+  //e.g. "INVOKEVIRTUAL", empty for undefined opcodes
+  std::string_view Mnemonic;
+  OperandLayout Layout = OperandLayout::Invalid;
+
+  //opcode + operand bytes, 0 for variable length instructions & undefined opcodes
+  U8 Length = 0;
+
+  //stack slots (long & double take two) popped & pushed, or VariableStackEffect
+  S8 Pops = 0;
+  S8 Pushes = 0;
+
+  U8 Flags = 0; //OpCodeFlag's
+
+  constexpr bool IsDefined() const { return Layout != OperandLayout::Invalid; }
+
+  constexpr bool IsBranch() const { return Flags & OPF_BRANCH; }
+  constexpr bool IsConditionalBranch() const { return Flags & OPF_CONDITIONAL; }
+  constexpr bool IsSwitch() const { return Flags & OPF_SWITCH; }
+  constexpr bool IsSubroutine() const { return Flags & OPF_SUBROUTINE; }
+  constexpr bool IsInvoke() const { return Flags & OPF_INVOKE; }
+  constexpr bool IsFieldAccess() const { return Flags & OPF_FIELD; }
+  constexpr bool IsReturn() const { return Flags & OPF_RETURN; }
+  constexpr bool IsThrow() const { return Flags & OPF_THROW; }
+
+  //Whether execution can continue with the next instruction. JSR counts as 
+  //an unconditional branch, the subroutines RET continues after it.
+  constexpr bool CanFallThrough() const
+  {
+    if (Flags & (OPF_RETURN | OPF_THROW))
+      return false;
+
+    if (Flags & OPF_BRANCH)
+      return Flags & OPF_CONDITIONAL;
+
+    return !(Flags & OPF_SUBROUTINE); //RET
+  }
+};
+
+constexpr std::array<OpCodeInfo, 256> MakeOpCodeInfoTable()
+{
+  std::array<OpCodeInfo, 256> table{};
+
+  constexpr S8 V = VariableStackEffect;
+
+  auto set = [&table](U8 opCode, std::string_view mnemonic, S8 pops, S8 pushes, U8 flags = 0)
+  {
+    table[opCode].Mnemonic = mnemonic;
+    table[opCode].Layout = OperandLayout::None;
+    table[opCode].Pops = pops;
+    table[opCode].Pushes = pushes;
+    table[opCode].Flags = flags;
+  };
+
+  set(OP_NOP,             "NOP",             0, 0);
+  set(OP_ACONST_NULL,     "ACONST_NULL",     0, 1);
+  set(OP_ICONST_M1,       "ICONST_M1",       0, 1);
+  set(OP_ICONST_0,        "ICONST_0",        0, 1);
+  set(OP_ICONST_1,        "ICONST_1",        0, 1);
+  set(OP_ICONST_2,        "ICONST_2",        0, 1);
+  set(OP_ICONST_3,        "ICONST_3",        0, 1);
+  set(OP_ICONST_4,        "ICONST_4",        0, 1);
+  set(OP_ICONST_5,        "ICONST_5",        0, 1);
+  set(OP_LCONST_0,        "LCONST_0",        0, 2);
+  set(OP_LCONST_1,        "LCONST_1",        0, 2);
+  set(OP_FCONST_0,        "FCONST_0",        0, 1);
+  set(OP_FCONST_1,        "FCONST_1",        0, 1);
+  set(OP_FCONST_2,        "FCONST_2",        0, 1);
+  set(OP_DCONST_0,        "DCONST_0",        0, 2);
+  set(OP_DCONST_1,        "DCONST_1",        0, 2);
+  set(OP_BIPUSH,          "BIPUSH",          0, 1);
+  set(OP_SIPUSH,          "SIPUSH",          0, 1);
+  set(OP_LDC,             "LDC",             0, 1);
+  set(OP_LDC_W,           "LDC_W",           0, 1);
+  set(OP_LDC2_W,          "LDC2_W",          0, 2);
+  set(OP_ILOAD,           "ILOAD",           0, 1);
+  set(OP_LLOAD,           "LLOAD",           0, 2);
+  set(OP_FLOAD,           "FLOAD",           0, 1);
+  set(OP_DLOAD,           "DLOAD",           0, 2);
+  set(OP_ALOAD,           "ALOAD",           0, 1);
+  set(OP_ILOAD_0,         "ILOAD_0",         0, 1);
+  set(OP_ILOAD_1,         "ILOAD_1",         0, 1);
+  set(OP_ILOAD_2,         "ILOAD_2",         0, 1);
+  set(OP_ILOAD_3,         "ILOAD_3",         0, 1);
+  set(OP_LLOAD_0,         "LLOAD_0",         0, 2);
+  set(OP_LLOAD_1,         "LLOAD_1",         0, 2);
+  set(OP_LLOAD_2,         "LLOAD_2",         0, 2);
+  set(OP_LLOAD_3,         "LLOAD_3",         0, 2);
+  set(OP_FLOAD_0,         "FLOAD_0",         0, 1);
+  set(OP_FLOAD_1,         "FLOAD_1",         0, 1);
+  set(OP_FLOAD_2,         "FLOAD_2",         0, 1);
+  set(OP_FLOAD_3,         "FLOAD_3",         0, 1);
+  set(OP_DLOAD_0,         "DLOAD_0",         0, 2);
+  set(OP_DLOAD_1,         "DLOAD_1",         0, 2);
+  set(OP_DLOAD_2,         "DLOAD_2",         0, 2);
+  set(OP_DLOAD_3,         "DLOAD_3",         0, 2);
+  set(OP_ALOAD_0,         "ALOAD_0",         0, 1);
+  set(OP_ALOAD_1,         "ALOAD_1",         0, 1);
+  set(OP_ALOAD_2,         "ALOAD_2",         0, 1);
+  set(OP_ALOAD_3,         "ALOAD_3",         0, 1);
+  set(OP_IALOAD,          "IALOAD",          2, 1);
+  set(OP_LALOAD,          "LALOAD",          2, 2);
+  set(OP_FALOAD,          "FALOAD",          2, 1);
+  set(OP_DALOAD,          "DALOAD",          2, 2);
+  set(OP_AALOAD,          "AALOAD",          2, 1);
+  set(OP_BALOAD,          "BALOAD",          2, 1);
+  set(OP_CALOAD,          "CALOAD",          2, 1);
+  set(OP_SALOAD,          "SALOAD",          2, 1);
+  set(OP_ISTORE,          "ISTORE",          1, 0);
+  set(OP_LSTORE,          "LSTORE",          2, 0);
+  set(OP_FSTORE,          "FSTORE",          1, 0);
+  set(OP_DSTORE,          "DSTORE",          2, 0);
+  set(OP_ASTORE,          "ASTORE",          1, 0);
+  set(OP_ISTORE_0,        "ISTORE_0",        1, 0);
+  set(OP_ISTORE_1,        "ISTORE_1",        1, 0);
+  set(OP_ISTORE_2,        "ISTORE_2",        1, 0);
+  set(OP_ISTORE_3,        "ISTORE_3",        1, 0);
+  set(OP_LSTORE_0,        "LSTORE_0",        2, 0);
+  set(OP_LSTORE_1,        "LSTORE_1",        2, 0);
+  set(OP_LSTORE_2,        "LSTORE_2",        2, 0);
+  set(OP_LSTORE_3,        "LSTORE_3",        2, 0);
+  set(OP_FSTORE_0,        "FSTORE_0",        1, 0);
+  set(OP_FSTORE_1,        "FSTORE_1",        1, 0);
+  set(OP_FSTORE_2,        "FSTORE_2",        1, 0);
+  set(OP_FSTORE_3,        "FSTORE_3",        1, 0);
+  set(OP_DSTORE_0,        "DSTORE_0",        2, 0);
+  set(OP_DSTORE_1,        "DSTORE_1",        2, 0);
+  set(OP_DSTORE_2,        "DSTORE_2",        2, 0);
+  set(OP_DSTORE_3,        "DSTORE_3",        2, 0);
+  set(OP_ASTORE_0,        "ASTORE_0",        1, 0);
+  set(OP_ASTORE_1,        "ASTORE_1",        1, 0);
+  set(OP_ASTORE_2,        "ASTORE_2",        1, 0);
+  set(OP_ASTORE_3,        "ASTORE_3",        1, 0);
+  set(OP_IASTORE,         "IASTORE",         3, 0);
+  set(OP_LASTORE,         "LASTORE",         4, 0);
+  set(OP_FASTORE,         "FASTORE",         3, 0);
+  set(OP_DASTORE,         "DASTORE",         4, 0);
+  set(OP_AASTORE,         "AASTORE",         3, 0);
+  set(OP_BASTORE,         "BASTORE",         3, 0);
+  set(OP_CASTORE,         "CASTORE",         3, 0);
+  set(OP_SASTORE,         "SASTORE",         3, 0);
+  set(OP_POP,             "POP",             1, 0);
+  set(OP_POP2,            "POP2",            2, 0);
+  set(OP_DUP,             "DUP",             1, 2);
+  set(OP_DUP_X1,          "DUP_X1",          2, 3);
+  set(OP_DUP_X2,          "DUP_X2",          3, 4);
+  set(OP_DUP2,            "DUP2",            2, 4);
+  set(OP_DUP2_X1,         "DUP2_X1",         3, 5);
+  set(OP_DUP2_X2,         "DUP2_X2",         4, 6);
+  set(OP_SWAP,            "SWAP",            2, 2);
+  set(OP_IADD,            "IADD",            2, 1);
+  set(OP_LADD,            "LADD",            4, 2);
+  set(OP_FADD,            "FADD",            2, 1);
+  set(OP_DADD,            "DADD",            4, 2);
+  set(OP_ISUB,            "ISUB",            2, 1);
+  set(OP_LSUB,            "LSUB",            4, 2);
+  set(OP_FSUB,            "FSUB",            2, 1);
+  set(OP_DSUB,            "DSUB",            4, 2);
+  set(OP_IMUL,            "IMUL",            2, 1);
+  set(OP_LMUL,            "LMUL",            4, 2);
+  set(OP_FMUL,            "FMUL",            2, 1);
+  set(OP_DMUL,            "DMUL",            4, 2);
+  set(OP_IDIV,            "IDIV",            2, 1);
+  set(OP_LDIV,            "LDIV",            4, 2);
+  set(OP_FDIV,            "FDIV",            2, 1);
+  set(OP_DDIV,            "DDIV",            4, 2);
+  set(OP_IREM,            "IREM",            2, 1);
+  set(OP_LREM,            "LREM",            4, 2);
+  set(OP_FREM,            "FREM",            2, 1);
+  set(OP_DREM,            "DREM",            4, 2);
+  set(OP_INEG,            "INEG",            1, 1);
+  set(OP_LNEG,            "LNEG",            2, 2);
+  set(OP_FNEG,            "FNEG",            1, 1);
+  set(OP_DNEG,            "DNEG",            2, 2);
+  set(OP_ISHL,            "ISHL",            2, 1);
+  set(OP_LSHL,            "LSHL",            3, 2);
+  set(OP_ISHR,            "ISHR",            2, 1);
+  set(OP_LSHR,            "LSHR",            3, 2);
+  set(OP_IUSHR,           "IUSHR",           2, 1);
+  set(OP_LUSHR,           "LUSHR",           3, 2);
+  set(OP_IAND,            "IAND",            2, 1);
+  set(OP_LAND,            "LAND",            4, 2);
+  set(OP_IOR,             "IOR",             2, 1);
+  set(OP_LOR,             "LOR",             4, 2);
+  set(OP_IXOR,            "IXOR",            2, 1);
+  set(OP_LXOR,            "LXOR",            4, 2);
+  set(OP_IINC,            "IINC",            0, 0);
+  set(OP_I2L,             "I2L",             1, 2);
+  set(OP_I2F,             "I2F",             1, 1);
+  set(OP_I2D,             "I2D",             1, 2);
+  set(OP_L2I,             "L2I",             2, 1);
+  set(OP_L2F,             "L2F",             2, 1);
+  set(OP_L2D,             "L2D",             2, 2);
+  set(OP_F2I,             "F2I",             1, 1);
+  set(OP_F2L,             "F2L",             1, 2);
+  set(OP_F2D,             "F2D",             1, 2);
+  set(OP_D2I,             "D2I",             2, 1);
+  set(OP_D2L,             "D2L",             2, 2);
+  set(OP_D2F,             "D2F",             2, 1);
+  set(OP_I2B,             "I2B",             1, 1);
+  set(OP_I2C,             "I2C",             1, 1);
+  set(OP_I2S,             "I2S",             1, 1);
+  set(OP_LCMP,            "LCMP",            4, 1);
+  set(OP_FCMPL,           "FCMPL",           2, 1);
+  set(OP_FCMPG,           "FCMPG",           2, 1);
+  set(OP_DCMPL,           "DCMPL",           4, 1);
+  set(OP_DCMPG,           "DCMPG",           4, 1);
+  set(OP_IFEQ,            "IFEQ",            1, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IFNE,            "IFNE",            1, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IFLT,            "IFLT",            1, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IFGE,            "IFGE",            1, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IFGT,            "IFGT",            1, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IFLE,            "IFLE",            1, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IF_ICMPEQ,       "IF_ICMPEQ",       2, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IF_ICMPNE,       "IF_ICMPNE",       2, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IF_ICMPLT,       "IF_ICMPLT",       2, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IF_ICMPGE,       "IF_ICMPGE",       2, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IF_ICMPGT,       "IF_ICMPGT",       2, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IF_ICMPLE,       "IF_ICMPLE",       2, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IF_ACMPEQ,       "IF_ACMPEQ",       2, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IF_ACMPNE,       "IF_ACMPNE",       2, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_GOTO,            "GOTO",            0, 0, OPF_BRANCH);
+  set(OP_JSR,             "JSR",             0, 1, OPF_BRANCH | OPF_SUBROUTINE);
+  set(OP_RET,             "RET",             0, 0, OPF_SUBROUTINE);
+  set(OP_TABLESWITCH,     "TABLESWITCH",     1, 0, OPF_BRANCH | OPF_SWITCH);
+  set(OP_LOOKUPSWITCH,    "LOOKUPSWITCH",    1, 0, OPF_BRANCH | OPF_SWITCH);
+  set(OP_IRETURN,         "IRETURN",         1, 0, OPF_RETURN);
+  set(OP_LRETURN,         "LRETURN",         2, 0, OPF_RETURN);
+  set(OP_FRETURN,         "FRETURN",         1, 0, OPF_RETURN);
+  set(OP_DRETURN,         "DRETURN",         2, 0, OPF_RETURN);
+  set(OP_ARETURN,         "ARETURN",         1, 0, OPF_RETURN);
+  set(OP_RETURN,          "RETURN",          0, 0, OPF_RETURN);
+  set(OP_GETSTATIC,       "GETSTATIC",       0, V, OPF_FIELD);
+  set(OP_PUTSTATIC,       "PUTSTATIC",       V, 0, OPF_FIELD);
+  set(OP_GETFIELD,        "GETFIELD",        1, V, OPF_FIELD);
+  set(OP_PUTFIELD,        "PUTFIELD",        V, 0, OPF_FIELD);
+  set(OP_INVOKEVIRTUAL,   "INVOKEVIRTUAL",   V, V, OPF_INVOKE);
+  set(OP_INVOKESPECIAL,   "INVOKESPECIAL",   V, V, OPF_INVOKE);
+  set(OP_INVOKESTATIC,    "INVOKESTATIC",    V, V, OPF_INVOKE);
+  set(OP_INVOKEINTERFACE, "INVOKEINTERFACE", V, V, OPF_INVOKE);
+  set(OP_INVOKEDYNAMIC,   "INVOKEDYNAMIC",   V, V, OPF_INVOKE);
+  set(OP_NEW,             "NEW",             0, 1);
+  set(OP_NEWARRAY,        "NEWARRAY",        1, 1);
+  set(OP_ANEWARRAY,       "ANEWARRAY",       1, 1);
+  set(OP_ARRAYLENGTH,     "ARRAYLENGTH",     1, 1);
+  set(OP_ATHROW,          "ATHROW",          1, 0, OPF_THROW);
+  set(OP_CHECKCAST,       "CHECKCAST",       1, 1);
+  set(OP_INSTANCEOF,      "INSTANCEOF",      1, 1);
+  set(OP_MONITORENTER,    "MONITORENTER",    1, 0);
+  set(OP_MONITOREXIT,     "MONITOREXIT",     1, 0);
+  set(OP_WIDE,            "WIDE",            V, V);
+  set(OP_MULTIANEWARRAY,  "MULTIANEWARRAY",  V, 1);
+  set(OP_IFNULL,          "IFNULL",          1, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_IFNONNULL,       "IFNONNULL",       1, 0, OPF_BRANCH | OPF_CONDITIONAL);
+  set(OP_GOTO_W,          "GOTO_W",          0, 0, OPF_BRANCH);
+  set(OP_JSR_W,           "JSR_W",           0, 1, OPF_BRANCH | OPF_SUBROUTINE);
+  set(OP_BREAKPOINT,      "BREAKPOINT",      0, 0);
+  set(OP_IMPDEP1,         "IMPDEP1",         0, 0);
+  set(OP_IMPDEP2,         "IMPDEP2",         0, 0);
+
+  for (U8 opCode : { OP_LDC, OP_ILOAD, OP_LLOAD, OP_FLOAD, OP_DLOAD, OP_ALOAD, 
+                     OP_ISTORE, OP_LSTORE, OP_FSTORE, OP_DSTORE, OP_ASTORE, OP_RET })
+    table[opCode].Layout = OperandLayout::UByte;
+
+  for (U8 opCode : { OP_LDC_W, OP_LDC2_W, OP_GETSTATIC, OP_PUTSTATIC, OP_GETFIELD, 
+                     OP_PUTFIELD, OP_INVOKEVIRTUAL, OP_INVOKESPECIAL, OP_INVOKESTATIC, 
+                     OP_NEW, OP_ANEWARRAY, OP_CHECKCAST, OP_INSTANCEOF })
+    table[opCode].Layout = OperandLayout::UShort;
+
+  for (U8 opCode : { OP_SIPUSH, OP_IFEQ, OP_IFNE, OP_IFLT, OP_IFGE, OP_IFGT, OP_IFLE, 
+                     OP_IF_ICMPEQ, OP_IF_ICMPNE, OP_IF_ICMPLT, OP_IF_ICMPGE, OP_IF_ICMPGT, 
+                     OP_IF_ICMPLE, OP_IF_ACMPEQ, OP_IF_ACMPNE, OP_GOTO, OP_JSR, 
+                     OP_IFNULL, OP_IFNONNULL })
+    table[opCode].Layout = OperandLayout::SShort;
+
+  table[OP_BIPUSH].Layout          = OperandLayout::SByte;
+  table[OP_GOTO_W].Layout          = OperandLayout::SInt;
+  table[OP_JSR_W].Layout           = OperandLayout::SInt;
+  table[OP_NEWARRAY].Layout        = OperandLayout::AType;
+  table[OP_IINC].Layout            = OperandLayout::IInc;
+  table[OP_MULTIANEWARRAY].Layout  = OperandLayout::MultiANewArray;
+  table[OP_INVOKEINTERFACE].Layout = OperandLayout::InvokeInterface;
+  table[OP_INVOKEDYNAMIC].Layout   = OperandLayout::InvokeDynamic;
+  table[OP_TABLESWITCH].Layout     = OperandLayout::TableSwitch;
+  table[OP_LOOKUPSWITCH].Layout    = OperandLayout::LookupSwitch;
+  table[OP_WIDE].Layout            = OperandLayout::Wide;
+
+  for (auto& info : table)
+  {
+    switch (info.Layout)
+    {
+      case OperandLayout::TableSwitch:
+      case OperandLayout::LookupSwitch:
+      case OperandLayout::Wide:
+      case OperandLayout::Invalid:
+        break;
+
+      default:
+        info.Length = static_cast<U8>(1 + GetOperandLength(info.Layout));
+    }
+  }
+
+  return table;
+}
+
+inline constexpr std::array<OpCodeInfo, 256> OpCodeInfoTable = MakeOpCodeInfoTable();
+
+constexpr const OpCodeInfo& GetOpCodeInfo(U8 opCode) { return OpCodeInfoTable[opCode]; }
+
+//empty for undefined opcodes
+constexpr std::string_view GetOpCodeMnemonic(U8 opCode) { return OpCodeInfoTable[opCode].Mnemonic; }
+
+//Padding between a TABLESWITCH / LOOKUPSWITCH opcode at codeOffset and its 
+//operands, which are 4 byte aligned relative to the start of the code
+constexpr U32 GetSwitchPadding(U32 codeOffset)
+{
+  return 3 - (codeOffset % 4);
+}
 
 struct Instruction
 {
   U8 OpCode;
 
-  //TODO: get rid of ErrorOr once we replace U8 with OpCode enum
-  ErrorOr<std::string_view> GetMnemonic() const;
+  const OpCodeInfo& GetInfo() const { return GetOpCodeInfo(OpCode); }
+
+  //empty for undefined opcodes
+  std::string_view GetMnemonic() const { return GetOpCodeMnemonic(OpCode); }
 
   //returns total instruction size in bytes (opcode + operand bytes)
   virtual size_t GetLength() const;
 
+  //Same as GetLength() but includes the alignment padding of instructions 
+  //(TABLESWITCH & LOOKUPSWITCH) placed at the given offset into the code
+  virtual size_t GetPaddedLength(U32 /*codeOffset*/) const { return this->GetLength(); }
+
   Instruction(U8 opCode) : OpCode{opCode} {}
   virtual ~Instruction() = default;
 
@@ -239,12 +619,17 @@ struct Instruction
 template <U8 OPCODE>
 struct NoArgInstruction : public Instruction
 {
+  static constexpr U8 StaticOpCode = OPCODE;
+
   NoArgInstruction() : Instruction{OPCODE} {}
 };
 
 template <U8 OPCODE, typename FirstT>
 struct OneArgInstruction : public Instruction
 {
+  static constexpr U8 StaticOpCode = OPCODE;
+  using FirstArgT = FirstT;
+
   FirstT FirstArg;
 
   OneArgInstruction(FirstT first) 
@@ -260,6 +645,10 @@ struct OneArgInstruction : public Instruction
 template <U8 OPCODE, typename FirstT, typename SecondT>
 struct TwoArgInstruction : public Instruction
 {
+  static constexpr U8 StaticOpCode = OPCODE;
+  using FirstArgT  = FirstT;
+  using SecondArgT = SecondT;
+
   FirstT  FirstArg;
   SecondT SecondArg;
 
@@ -326,6 +715,8 @@ using RET       = OneArgInstruction<OP_RET,  U8>;
 
 struct TABLESWITCH : public Instruction
 {
+  static constexpr U8 StaticOpCode = OP_TABLESWITCH;
+
   S32 Default;
   S32 Low;
   //NOTE: The TABLESWITCH instruction also encodes a S32 "High" operand following 
@@ -337,12 +728,13 @@ struct TABLESWITCH : public Instruction
     : Instruction{OP_TABLESWITCH}, Default{def}, Low{low}, Offsets{std::move(offsets)} {}
 
   virtual size_t GetLength() const override;
-
-  size_t GetPaddedLength(U32 codeOffset) const;
+  virtual size_t GetPaddedLength(U32 codeOffset) const override;
 };
 
 struct LOOKUPSWITCH  : public Instruction
 {
+  static constexpr U8 StaticOpCode = OP_LOOKUPSWITCH;
+
   S32 Default;
   //NOTE: The LOOKUPSWITCH instruction also encodes a S32 "NPairs" operand following
   //after the "Default" operand. This field is not nescesairy to store in memory
@@ -353,8 +745,7 @@ struct LOOKUPSWITCH  : public Instruction
     : Instruction{OP_LOOKUPSWITCH}, Default{def}, Pairs{ std::move(pairs) } {}
 
   virtual size_t GetLength() const override;
-
-  size_t GetPaddedLength(U32 codeOffset) const;
+  virtual size_t GetPaddedLength(U32 codeOffset) const override;
 };
 
 using GETSTATIC = OneArgInstruction<OP_GETSTATIC, U16>;
@@ -366,10 +757,27 @@ using INVOKESPECIAL   = OneArgInstruction<OP_INVOKESPECIAL, U16>;
 using INVOKESTATIC    = OneArgInstruction<OP_INVOKESTATIC,  U16>;
 //NOTE: This instruction has a third U8 operand, but it is always supposed to 
 //be 0 so its not nescesairy to store it in memory.
-using INVOKEINTERFACE = TwoArgInstruction<OP_INVOKEINTERFACE, U16, U8>;
+struct INVOKEINTERFACE : public TwoArgInstruction<OP_INVOKEINTERFACE, U16, U8>
+{
+  using TwoArgInstruction::TwoArgInstruction;
+
+  virtual size_t GetLength() const override
+  {
+    return TwoArgInstruction::GetLength() + sizeof(U8);
+  }
+};
+
 //NOTE: This instruction has a second & third U8 operand, but they are always 
 //supposed to be 0 so it is not nescesairy to store them in memory.
-using INVOKEDYNAMIC = OneArgInstruction<OP_INVOKEDYNAMIC, U16>;
+struct INVOKEDYNAMIC : public OneArgInstruction<OP_INVOKEDYNAMIC, U16>
+{
+  using OneArgInstruction::OneArgInstruction;
+
+  virtual size_t GetLength() const override
+  {
+    return OneArgInstruction::GetLength() + 2 * sizeof(U8);
+  }
+};
 using NEW           = OneArgInstruction<OP_NEW, U16>;
 
 using NEWARRAY   = OneArgInstruction<OP_NEWARRAY,   AType>;
@@ -379,6 +787,8 @@ using INSTANCEOF = OneArgInstruction<OP_INSTANCEOF, U16>;
 
 struct WIDE : public Instruction
 {
+  static constexpr U8 StaticOpCode = OP_WIDE;
+
   U8 OpCode;
   U16 Index;
 
@@ -390,6 +800,8 @@ struct WIDE : public Instruction
 
 struct WIDE_IINC : public Instruction
 {
+  static constexpr U8 StaticOpCode = OP_WIDE;
+
   U16 Index;
   U16 Const;
 
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "./Attribute.hpp"
+#include "./ClassFile.hpp"
+#include "./ConstantPool.hpp"
+#include "./ControlFlowGraph.hpp"
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <vector>
+
+namespace FileFormats::JVM
+{
+
+struct CodeMaxs
+{
+  U16 MaxStack;
+  U16 MaxLocals;
+};
+
+//Computes the max_stack & max_locals of a methods code. The stack depth is
+//tracked per basic block in a single worklist pass (every block is executed
+//once, as the depth at its start is fixed by the first edge reaching it),
+//using the stack effects of OpCodeInfoTable and the descriptors of the
+//referenced fields & methods. max_locals is the largest local accessed by
+//any instruction or taken by the parameters.
+//
+//Keeps its buffers between methods, not thread safe.
+class MaxsComputer
+{
+  public:
+    ErrorOr<CodeMaxs> Compute(const ConstantPool& constPool, const FieldMethodInfo& method, const CodeAttribute& code);
+
+    //Computes the maxs of the methods code and stores them in its Code
+    //attribute. Methods without a Code attribute are left as they are.
+    ErrorOr<void> Update(const ConstantPool& constPool, FieldMethodInfo& method);
+
+    //Update() for every method of the class
+    ErrorOr<void> Update(ClassFile& classFile);
+
+  private:
+    ErrorOr<U32> ComputeMaxStack(const ConstantPool&, const CodeAttribute&);
+    ErrorOr<U32> ComputeMaxLocals(const ConstantPool&, const FieldMethodInfo&, const CodeAttribute&);
+
+    //stack depth change of a field access / invoke, through its descriptor
+    ErrorOr<void> GetStackEffect(const ConstantPool&, U8 opCode, U16 index, U32& pops, U32& pushes);
+    ErrorOr<void> SetDepth(U32 block, U32 depth);
+
+    static constexpr U32 Unknown = ~U32{0};
+
+    ControlFlowGraphBuilder m_cfgBuilder;
+    ControlFlowGraph m_cfg;
+
+    std::vector<U32> m_depths; //stack depth at the start of each block
+    std::vector<U32> m_worklist;
+};
+
+} //namespace FileFormats::JVM
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "./Attribute.hpp"
+#include "./ClassFile.hpp"
+#include "./CodeBuilder.hpp"
+#include "./ConstantPool.hpp"
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <span>
+#include <vector>
+#include <memory>
+
+namespace FileFormats::JVM
+{
+
+//An instruction of the code being optimized, decoded into a form the passes
+//rewrite in place. Changing OpCode to one with the same operands, to a short
+//form (xLOAD_n, ...) or between LDC / LDC_W is enough for the instruction to
+//be re-encoded accordingly.
+struct PeepholeInstruction
+{
+  U32 PC; //offset in the original code
+
+  //WIDE instructions are stored as the instruction they modify, and encoded
+  //as WIDE again only if their operands need it
+  U8 OpCode;
+  bool IsRemoved;
+
+  //Referenced by a branch, switch, exception handler or stack map frame
+  //(including NEWs referenced by Uninitialized types). Removing it would move
+  //or merge those, so passes keep it.
+  bool IsTarget;
+
+  //Local variable (also of the xLOAD_n / xSTORE_n forms) or constant pool
+  //index, index of the target instruction of a branch
+  U32 Operand;
+
+  //BIPUSH / SIPUSH value, IINC increment, NEWARRAY type, MULTIANEWARRAY
+  //dimensions, INVOKEINTERFACE count
+  S32 Value;
+};
+
+//What passes get to see of the method being optimized
+class PeepholeContext
+{
+  public:
+    const ConstantPool& GetConstantPool() const { return *m_constPool; }
+
+    std::span<PeepholeInstruction> GetInstructions() { return m_instructions; }
+
+    //Index of the first instruction after index that isn't removed, or the
+    //instruction count
+    U32 GetNext(U32 index) const;
+
+    //Whether any instruction of the original code reads the local variable
+    //slot (loads, IINC, RET)
+    bool IsLocalRead(U32 slot) const { return slot < m_readLocals.size() && m_readLocals[slot]; }
+
+    //Frames declare the types of locals at their offsets, so removing stores
+    //can invalidate them
+    bool HasStackMapTable() const { return m_hasStackMapTable; }
+
+  private:
+    friend class PeepholeOptimizer;
+
+    const ConstantPool* m_constPool{nullptr};
+    std::vector<PeepholeInstruction> m_instructions;
+    std::vector<U8> m_readLocals;
+    bool m_hasStackMapTable{false};
+};
+
+//A local rewrite, applied to every instruction of the code in order
+class PeepholePass
+{
+  public:
+    virtual ~PeepholePass() = default;
+
+    //Rewrites the instruction at index, which isn't removed, possibly
+    //together with the ones following it. Returns whether anything changed.
+    virtual bool Apply(PeepholeContext& context, U32 index) = 0;
+};
+
+//ILOAD n -> ILOAD_n (n <= 3), same for the other loads & stores
+class ShortLocalFormsPass : public PeepholePass
+{
+  public:
+    bool Apply(PeepholeContext& context, U32 index) override;
+};
+
+//LDC_W -> LDC if the constant index fits into a byte
+class NarrowLdcPass : public PeepholePass
+{
+  public:
+    bool Apply(PeepholeContext& context, U32 index) override;
+};
+
+//Makes branches to a GOTO branch to the GOTOs target instead
+class GotoChainPass : public PeepholePass
+{
+  public:
+    bool Apply(PeepholeContext& context, U32 index) override;
+};
+
+class RemoveNopsPass : public PeepholePass
+{
+  public:
+    bool Apply(PeepholeContext& context, U32 index) override;
+};
+
+//Removes a constant (xCONST_*, BIPUSH, SIPUSH, LDC of a number or string)
+//directly stored into a local that is never read. Disabled for code with a
+//StackMapTable, whose frames may declare the local.
+class DeadConstantStorePass : public PeepholePass
+{
+  public:
+    bool Apply(PeepholeContext& context, U32 index) override;
+};
+
+//Runs a pipeline of peephole passes over methods code. The code is decoded
+//once, all passes are applied per instruction in a single sweep, and if any
+//of them changed something the code is re-emitted through a CodeBuilder.
+//Branches, switches and the exception table reference labels while doing
+//so, as do the offsets of the StackMapTable, LineNumberTable,
+//LocalVariableTable & LocalVariableTypeTable, which are remapped afterwards.
+//Code with any other attribute is left as it is, since it may reference
+//offsets that can't be remapped.
+//
+//The code only gets shorter, except when folding a GOTO chain moves a branch
+//out of S16 range and the CodeBuilder has to widen it. If that inverts a
+//conditional branch in code with a StackMapTable, the code is kept as it is,
+//since the new branch target after the GOTO_W would need a frame. MaxStack &
+//MaxLocals are kept, they stay valid upper bounds.
+//
+//Keeps its buffers between methods, not thread safe.
+class PeepholeOptimizer
+{
+  public:
+    //Passes run in the order they were added
+    void AddPass(std::unique_ptr<PeepholePass> pass);
+
+    //The passes above, in an order in which they benefit from each other
+    void AddDefaultPasses();
+
+    //Returns whether the code changed
+    ErrorOr<bool> Optimize(const ConstantPool& constPool, CodeAttribute& code);
+
+    //Optimize() for the code of every method of the class
+    ErrorOr<void> Optimize(ClassFile& classFile);
+
+  private:
+    static constexpr U32 NoLabel = ~U32{0};
+
+    ErrorOr<bool> CollectAttributes(const ConstantPool&, CodeAttribute&);
+    ErrorOr<void> Decode(const CodeAttribute&);
+    U32 GetInstructionIndex(U32 pc) const;
+    Label GetLabel(U32 index);
+    void Emit(const CodeAttribute&, U32 index);
+    U32 GetNewPC(U32 index) const;
+
+    std::vector< std::unique_ptr<PeepholePass> > m_passes;
+
+    PeepholeContext m_context;
+    CodeBuilder m_builder;
+
+    U32 m_codeLength{0};
+
+    //per instruction (+ the end of the code), label id or NoLabel
+    std::vector<U32> m_labels;
+
+    std::vector<StackMapTableAttribute*> m_stackMapTables;
+    std::vector<LineNumberTableAttribute*> m_lineNumberTables;
+    std::vector< std::vector<LocalVariable>* > m_localVariableTables; //of LocalVariableTable & LocalVariableTypeTable
+    std::vector<U32> m_frameOffsets;
+    std::vector<U32> m_uninitializedOffsets; //NEW instructions of Uninitialized types
+    std::vector<Label> m_switchTargets;
+    std::vector< std::pair<S32, Label> > m_switchCases;
+};
+
+} //namespace FileFormats::JVM
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "./Attribute.hpp"
+#include "./ClassFile.hpp"
+#include "./ConstantPool.hpp"
+#include "./ControlFlowGraph.hpp"
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+namespace FileFormats::JVM
+{
+
+//Answers the class hierarchy questions that come up when merging the types
+//of two control flow paths. Override it to resolve classes from the class
+//path of the code being processed.
+class ClassHierarchyResolver
+{
+  public:
+    virtual ~ClassHierarchyResolver() = default;
+
+    //Internal name (e.g. "java/lang/Number") of the most specific common
+    //superclass of two different, non array classes. The returned view only
+    //has to stay valid until the next call.
+    //The default knows nothing about the hierarchy and returns
+    //"java/lang/Object", which is only correct if the merged value isn't
+    //used as anything more specific afterwards.
+    virtual std::string_view GetCommonSuperClass(std::string_view /*a*/, std::string_view /*b*/)
+    {
+      return "java/lang/Object";
+    }
+};
+
+//Computes the StackMapTable of a method (JVMS 4.7.4) by a worklist dataflow
+//over the basic blocks of its code, and encodes the frames as compactly as
+//possible (same / chop / append frames where they apply, full frames
+//otherwise).
+//
+//Values are tracked as 32 bit words and class names are interned, so
+//merging frames is a couple of integer compares per slot. Like the
+//ControlFlowGraphBuilder it keeps its buffers between methods, so reuse one
+//computer for many methods. Not thread safe, use one per thread.
+//
+//Requires the methods MaxStack & MaxLocals to be correct. Code using
+//JSR / RET (which can't have a StackMapTable) and code containing
+//unreachable instructions is rejected.
+class StackMapComputer
+{
+  public:
+    //The resolver has to outlive the computer, nullptr uses the default
+    StackMapComputer(ClassHierarchyResolver* resolver = nullptr);
+
+    //Computes the frames of method, whose Code attribute code is, into
+    //out.Frames & out.Types. Adds the Class constants referenced by the
+    //frames to constPool. thisClass = the index of the Class constant of the
+    //class the method belongs to.
+    ErrorOr<void> Compute(ConstantPool& constPool, U16 thisClass, const FieldMethodInfo& method,
+        const CodeAttribute& code, StackMapTableAttribute& out);
+
+    //Recomputes the StackMapTable of a method of the class and replaces its
+    //current one, if any. Removes it if the method doesn't need any frames.
+    //Methods without a Code attribute are left as they are.
+    ErrorOr<void> Update(ClassFile& classFile, FieldMethodInfo& method);
+
+  private:
+    struct MemberRef
+    {
+      std::string_view Name;
+      std::string_view Descriptor;
+    };
+
+    ErrorOr<void> Initialize(const ConstantPool&, U16 thisClass, const FieldMethodInfo&, const CodeAttribute&);
+    ErrorOr<void> CollectHandlers(const ConstantPool&, const CodeAttribute&);
+    ErrorOr<void> ExecuteBlock(const ConstantPool&, const CodeAttribute&, U32 block);
+    ErrorOr<U32> Execute(const ConstantPool&, std::span<const U8> code, U32 pc);
+    ErrorOr<void> Invoke(const ConstantPool&, std::span<const U8> code, U8 opCode, U16 index);
+    ErrorOr<void> MergeInto(U32 block, const U32* stack, U32 stackSize);
+    ErrorOr<void> MergeIntoHandlers(U32 block);
+    ErrorOr<void> Encode(ConstantPool&, StackMapTableAttribute& out);
+    ErrorOr<void> AppendTypes(ConstantPool&, const U32* values, U32 count, std::vector<VerificationType>& types);
+
+    ErrorOr<MemberRef> GetMemberRef(const ConstantPool&, U16 index) const;
+    ErrorOr<std::string_view> GetClassName(const ConstantPool&, U16 index) const;
+
+    //Intern() requires name to outlive the computation, InternCopy() doesn't
+    U32 Intern(std::string_view name);
+    U32 InternCopy(std::string_view name);
+    U32 InternArrayOf(std::string_view elementName);
+    U32 GetDescriptorType(std::string_view descriptor);
+    U32 GetArrayElementType(U32 arrayType);
+    U32 Merge(U32 a, U32 b);
+    U32 GetCommonSuperClass(U32 a, U32 b);
+
+    void Push(U32 value);
+    void PushDescriptor(std::string_view descriptor);
+    U32 Pop();
+    void Pop(U32 slots);
+    void Store(U32 index, U32 value);
+    void ReplaceUninitialized(U32 uninitialized, U32 initialized);
+
+    ClassHierarchyResolver* m_resolver;
+
+    ControlFlowGraphBuilder m_cfgBuilder;
+    ControlFlowGraph m_cfg;
+
+    U32 m_maxLocals{0};
+    U32 m_maxStack{0};
+    U32 m_thisType{0};
+
+    //the entry frame of each block: MaxLocals locals, followed by MaxStack
+    //stack slots (+ the stack size in m_entryStackSizes)
+    std::vector<U32> m_entryFrames;
+    std::vector<U32> m_entryStackSizes;
+    std::vector<U8> m_reached;
+
+    //the locals implied by the descriptor, which the first frame is encoded
+    //relative to. Block 0's entry frame can differ if it's a branch target.
+    std::vector<U32> m_initialLocals;
+
+    std::vector<U32> m_worklist;
+    std::vector<U8> m_queued;
+
+    //per block ranges into m_handlerEntries, indices into the exception table
+    std::vector<U32> m_handlersBegin;
+    std::vector<U32> m_handlerEntries;
+
+    //per exception table entry
+    std::vector<U32> m_handlerBlocks;
+    std::vector<U32> m_catchTypes;
+
+    //the frame of the instruction being executed
+    std::vector<U32> m_locals;
+    std::vector<U32> m_stack;
+    U32 m_stackSize{0};
+    bool m_stackError{false};
+    bool m_localsChanged{false};
+
+    //interned class names, views of constants, descriptors or m_ownedNames
+    std::vector<std::string_view> m_names;
+    std::unordered_map<std::string_view, U32> m_nameIds;
+    std::deque<std::string> m_ownedNames;
+    std::unordered_map<U64, U32> m_mergeCache;
+    std::vector<U16> m_classIndices;
+    std::string m_scratch;
+
+    std::vector<VerificationType> m_previousLocals;
+    std::vector<VerificationType> m_currentLocals;
+    std::vector<VerificationType> m_currentStack;
+};
+
+} //namespace FileFormats::JVM
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Defs.hpp"
+#include "Error.hpp"
+
+#include <span>
+#include <string>
+
+namespace FileFormats
+{
+
+//Read only memory mapping of a whole file. GetBytes() can be handed straight
+//to the span based parse functions, the mapping stays valid until the
+//MappedFile is destroyed.
+class MappedFile
+{
+  public:
+    static ErrorOr<MappedFile> Open(const std::string& path);
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    std::span<const U8> GetBytes() const { return {m_data, m_size}; }
+    size_t Size() const { return m_size; }
+
+  private:
+    MappedFile() = default;
+    void Close();
+
+    const U8* m_data{nullptr};
+    size_t m_size{0};
+
+#if defined(_WIN32)
+    void* m_fileHandle{nullptr};
+    void* m_mappingHandle{nullptr};
+#endif
+};
+
+} //namespace FileFormats
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+
+#include <span>
+
+namespace FileFormats::Zip
+{
+
+//Decompresses a raw DEFLATE (RFC 1951) stream, as stored in zip entries, into
+//out. Fails if out is too small to hold the decompressed data. Returns the
+//number of bytes written.
+ErrorOr<size_t> Inflate(std::span<const U8> compressed, std::span<U8> out);
+
+} //namespace FileFormats::Zip
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "../Defs.hpp"
+#include "../Error.hpp"
+#include "../MappedFile.hpp"
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <ranges>
+
+namespace FileFormats::Zip
+{
+
+struct ZipEntry
+{
+  enum class Method : U16
+  {
+    Stored   = 0,
+    Deflated = 8,
+  };
+
+  //views the archives central directory
+  std::string_view Name;
+
+  Method CompressionMethod;
+  U16 Flags;
+  U32 CRC32;
+  U64 CompressedSize;
+  U64 UncompressedSize;
+  U64 LocalHeaderOffset;
+
+  bool IsDirectory() const { return Name.ends_with('/'); }
+  bool IsClassFile() const { return Name.ends_with(".class"); }
+  bool IsEncrypted() const { return Flags & 1; }
+};
+
+//Zip (and thereby JAR) archive reader. Only the central directory is read up
+//front, entry data is located and decompressed on request. Stored entries are
+//returned as views of the archive, so nothing is extracted or copied.
+class ZipArchive
+{
+  public:
+    //Memory maps the archive
+    static ErrorOr<ZipArchive> Open(const std::string& path);
+
+    //The bytes have to outlive the archive
+    static ErrorOr<ZipArchive> FromBytes(std::span<const U8> bytes);
+
+    const std::vector<ZipEntry>& GetEntries() const { return m_entries; }
+
+    //nullptr if there is no entry with the given name
+    const ZipEntry* FindEntry(std::string_view name) const;
+
+    //Entries that (going by their name) are class files, in directory order
+    auto GetClassEntries() const
+    {
+      return m_entries | std::views::filter([](const ZipEntry& entry) { return entry.IsClassFile(); });
+    }
+
+    //The entries data as stored in the archive
+    ErrorOr< std::span<const U8> > GetCompressedData(const ZipEntry& entry) const;
+
+    //The entries decompressed data. Stored entries are returned as a view of
+    //the archive, deflated ones are inflated into buffer, which is only grown
+    //so it can be reused across calls. Inflated data is checked against the
+    //entries CRC-32, stored data isn't to keep it zero-copy.
+    ErrorOr< std::span<const U8> > GetData(const ZipEntry& entry, std::vector<U8>& buffer) const;
+
+    //Same as above, using a buffer owned by the calling thread. The returned
+    //data is valid until the next call on the same thread.
+    ErrorOr< std::span<const U8> > GetData(const ZipEntry& entry) const;
+
+  private:
+    ZipArchive() = default;
+
+    ErrorOr<void> ReadCentralDirectory();
+
+    std::optional<MappedFile> m_file;
+    std::span<const U8> m_bytes;
+
+    std::vector<ZipEntry> m_entries;
+};
+
+} //namespace FileFormats::Zip
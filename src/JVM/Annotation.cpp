@@ -0,0 +1,235 @@
+#include "FileFormats/JVM/Annotation.hpp"
+#include "FileFormats/JVM/ConstantPool.hpp"
+
+#include "Util/Error.hpp"
+
+using namespace FileFormats;
+using namespace FileFormats::JVM;
+
+using namespace std::literals;
+
+bool ElementValue::IsConst() const
+{
+  return "BCDFIJSZs"sv.find(this->GetTag()) != std::string_view::npos;
+}
+
+std::string_view ElementValue::GetString(const ConstantPool& constPool) const
+{
+  U16 index{0};
+
+  switch (this->GetTag())
+  {
+    case 's': index = this->GetConstValueIndex();    break;
+    case 'e': index = this->GetEnumConstNameIndex(); break;
+    case 'c': index = this->GetClassInfoIndex();     break;
+  }
+
+  return constPool.Is(index, CPInfo::Type::UTF8) ? constPool.GetUTF8(index) : std::string_view{};
+}
+
+U32 ElementValue::GetSize(const U8* bytes)
+{
+  switch (bytes[0])
+  {
+    case 'e':
+      return 5;
+
+    case '@':
+      return 1 + Annotation::GetSize(bytes + 1);
+
+    case '[':
+    {
+      U32 size = 3;
+
+      for (U16 i = 0; i < LoadBigEndian<U16>(bytes + 1); i++)
+        size += ElementValue::GetSize(bytes + size);
+
+      return size;
+    }
+
+    default:
+      return 3;
+  }
+}
+
+std::string_view ElementValuePair::GetName(const ConstantPool& constPool) const
+{
+  U16 index = this->GetNameIndex();
+  return constPool.Is(index, CPInfo::Type::UTF8) ? constPool.GetUTF8(index) : std::string_view{};
+}
+
+std::string_view Annotation::GetTypeName(const ConstantPool& constPool) const
+{
+  U16 index = this->GetTypeIndex();
+  return constPool.Is(index, CPInfo::Type::UTF8) ? constPool.GetUTF8(index) : std::string_view{};
+}
+
+std::optional<ElementValue> Annotation::FindValue(const ConstantPool& constPool, std::string_view name) const
+{
+  for (ElementValuePair pair : this->GetPairs())
+  {
+    if (pair.GetName(constPool) == name)
+      return pair.GetValue();
+  }
+
+  return std::nullopt;
+}
+
+U32 Annotation::GetSize(const U8* bytes)
+{
+  U32 size = 4;
+
+  for (U16 i = 0; i < LoadBigEndian<U16>(bytes + 2); i++)
+    size += ElementValuePair::GetSize(bytes + size);
+
+  return size;
+}
+
+U32 ParameterAnnotations::GetSize(const U8* bytes)
+{
+  U32 size = 2;
+
+  for (U16 i = 0; i < LoadBigEndian<U16>(bytes); i++)
+    size += Annotation::GetSize(bytes + size);
+
+  return size;
+}
+
+static Error truncatedError(size_t offset)
+{
+  return Error::FromFormatStr("ValidateAnnotations: the annotation bytes end at offset %zu, within a structure", offset);
+}
+
+static ErrorOr<size_t> validateAnnotation(std::span<const U8> bytes, size_t offset, U32 depth);
+
+//Returns the offset following the value
+static ErrorOr<size_t> validateElementValue(std::span<const U8> bytes, size_t offset, U32 depth)
+{
+  if (depth > MaxAnnotationDepth)
+    return Error::FromFormatStr("ValidateAnnotations: annotations are nested deeper than %u", MaxAnnotationDepth);
+
+  if (offset + 3 > bytes.size())
+    return truncatedError(bytes.size());
+
+  char tag = static_cast<char>(bytes[offset]);
+
+  switch (tag)
+  {
+    case 'B': case 'C': case 'D': case 'F': case 'I': case 'J': case 'S': case 'Z': case 's': case 'c':
+      return offset + 3;
+
+    case 'e':
+      if (offset + 5 > bytes.size())
+        return truncatedError(bytes.size());
+
+      return offset + 5;
+
+    case '@':
+      return validateAnnotation(bytes, offset + 1, depth + 1);
+
+    case '[':
+    {
+      U16 count = LoadBigEndian<U16>(bytes.data() + offset + 1);
+      offset += 3;
+
+      for (U16 i = 0; i < count; i++)
+      {
+        auto errOrEnd = validateElementValue(bytes, offset, depth + 1);
+        VERIFY(errOrEnd);
+
+        offset = errOrEnd.Get();
+      }
+
+      return offset;
+    }
+
+    default:
+      return Error::FromFormatStr("ValidateAnnotations: the element_value at offset %zu has the unknown tag 0x%X",
+          offset, static_cast<U32>(bytes[offset]));
+  }
+}
+
+static ErrorOr<size_t> validateAnnotation(std::span<const U8> bytes, size_t offset, U32 depth)
+{
+  if (offset + 4 > bytes.size())
+    return truncatedError(bytes.size());
+
+  U16 pairCount = LoadBigEndian<U16>(bytes.data() + offset + 2);
+  offset += 4;
+
+  for (U16 i = 0; i < pairCount; i++)
+  {
+    if (offset + 2 > bytes.size())
+      return truncatedError(bytes.size());
+
+    auto errOrEnd = validateElementValue(bytes, offset + 2, depth);
+    VERIFY(errOrEnd);
+
+    offset = errOrEnd.Get();
+  }
+
+  return offset;
+}
+
+//num_annotations followed by the annotations
+static ErrorOr<size_t> validateAnnotationTable(std::span<const U8> bytes, size_t offset)
+{
+  if (offset + 2 > bytes.size())
+    return truncatedError(bytes.size());
+
+  U16 count = LoadBigEndian<U16>(bytes.data() + offset);
+  offset += 2;
+
+  for (U16 i = 0; i < count; i++)
+  {
+    auto errOrEnd = validateAnnotation(bytes, offset, 1);
+    VERIFY(errOrEnd);
+
+    offset = errOrEnd.Get();
+  }
+
+  return offset;
+}
+
+static ErrorOr<void> checkEnd(std::span<const U8> bytes, size_t end)
+{
+  if (end != bytes.size())
+    return Error::FromFormatStr("ValidateAnnotations: the annotations end at offset %zu, but there are %zu bytes",
+        end, bytes.size());
+
+  return {};
+}
+
+ErrorOr<void> JVM::ValidateAnnotations(std::span<const U8> bytes)
+{
+  auto errOrEnd = validateAnnotationTable(bytes, 0);
+  VERIFY(errOrEnd);
+
+  return checkEnd(bytes, errOrEnd.Get());
+}
+
+ErrorOr<void> JVM::ValidateParameterAnnotations(std::span<const U8> bytes)
+{
+  if (bytes.empty())
+    return truncatedError(0);
+
+  size_t offset = 1;
+
+  for (U8 i = 0; i < bytes[0]; i++)
+  {
+    auto errOrEnd = validateAnnotationTable(bytes, offset);
+    VERIFY(errOrEnd);
+
+    offset = errOrEnd.Get();
+  }
+
+  return checkEnd(bytes, offset);
+}
+
+ErrorOr<void> JVM::ValidateElementValue(std::span<const U8> bytes)
+{
+  auto errOrEnd = validateElementValue(bytes, 0, 0);
+  VERIFY(errOrEnd);
+
+  return checkEnd(bytes, errOrEnd.Get());
+}
@@ -1,38 +1,97 @@
 #include "FileFormats/JVM/Attribute.hpp"
+#include "FileFormats/JVM/ClassFileParser.hpp"
 
-#include <map>
 #include <cassert>
+#include <array>
 
 using namespace FileFormats;
 using namespace JVM;
 
 using namespace std::literals;
 
-static std::map<AttributeInfo::Type, std::string_view> typeNames =
+//types that can be looked up by name
+static constexpr AttributeInfo::Type namedTypes[] =
 {
-  {AttributeInfo::Type::ConstantValue, "ConstantValue"sv},
-  {AttributeInfo::Type::Code,          "Code"sv},
-  {AttributeInfo::Type::SourceFile,    "SourceFile"sv},
-
-  {AttributeInfo::Type::Raw, "_Raw"sv}
+  AttributeInfo::Type::ConstantValue,
+  AttributeInfo::Type::Code,
+  AttributeInfo::Type::StackMapTable,
+  AttributeInfo::Type::BootstrapMethods,
+  AttributeInfo::Type::NestHost,
+  AttributeInfo::Type::NestMembers,
+  AttributeInfo::Type::PermittedSubclasses,
+  AttributeInfo::Type::Exceptions,
+  AttributeInfo::Type::InnerClasses,
+  AttributeInfo::Type::EnclosingMethod,
+  AttributeInfo::Type::Synthetic,
+  AttributeInfo::Type::Signature,
+  AttributeInfo::Type::Record,
+  AttributeInfo::Type::SourceFile,
+  AttributeInfo::Type::LineNumberTable,
+  AttributeInfo::Type::LocalVariableTable,
+  AttributeInfo::Type::LocalVariableTypeTable,
+  AttributeInfo::Type::Deprecated,
+  AttributeInfo::Type::MethodParameters,
+  AttributeInfo::Type::Module,
+  AttributeInfo::Type::ModulePackages,
+  AttributeInfo::Type::ModuleMainClass,
+  AttributeInfo::Type::RuntimeVisibleAnnotations,
+  AttributeInfo::Type::RuntimeInvisibleAnnotations,
+  AttributeInfo::Type::RuntimeVisibleParameterAnnotations,
+  AttributeInfo::Type::RuntimeInvisibleParameterAnnotations,
+  AttributeInfo::Type::AnnotationDefault,
 };
 
-std::string_view AttributeInfo::GetTypeName(AttributeInfo::Type type) 
+//Perfect hash of the names of namedTypes (checked below), so looking a name
+//up is a table load and a single comparison
+static constexpr size_t hashName(std::string_view str)
 {
-  auto itr = typeNames.find(type);
-
-  assert(itr != typeNames.end());
-  return std::get<1>(*itr);
+  return (5 * str.size() + 3 * static_cast<U8>(str.front()) + 7 * static_cast<U8>(str.back())) % 64;
 }
 
-ErrorOr<AttributeInfo::Type> AttributeInfo::GetType(std::string_view str) 
+static constexpr auto typesByHash = []
+{
+  std::array<AttributeInfo::Type, 64> types{};
+  types.fill(AttributeInfo::Type::Raw);
+
+  for (auto type : namedTypes)
+    types[hashName(AttributeInfo::GetTypeName(type))] = type;
+
+  return types;
+}();
+
+static constexpr bool hasNoCollisions()
 {
-  for (auto itr : typeNames)
+  for (auto type : namedTypes)
   {
-    if (str == std::get<1>(itr))
-      return std::get<0>(itr);
+    if (typesByHash[hashName(AttributeInfo::GetTypeName(type))] != type)
+      return false;
   }
 
+  return true;
+}
+
+static_assert(hasNoCollisions(), "hashName() has to be changed for the new attribute names");
+
+AttributeInfo::Type AttributeInfo::FindType(std::string_view str)
+{
+  if (str.empty())
+    return Type::Raw;
+
+  Type type = typesByHash[hashName(str)];
+
+  if (type == Type::Raw || str != AttributeInfo::GetTypeName(type))
+    return Type::Raw;
+
+  return type;
+}
+
+ErrorOr<AttributeInfo::Type> AttributeInfo::GetType(std::string_view str) 
+{
+  Type type = AttributeInfo::FindType(str);
+
+  if (type != Type::Raw)
+    return type;
+
   return Error::FromFormatStr("AttributeInfo::GetType called with unknown type name \"%.*s\"", 
       str.size(), str.data());
 }
@@ -47,3 +106,139 @@ AttributeInfo::Type AttributeInfo::GetType() const
   return m_type;
 }
 
+
+U32 StackMapFrame::GetLength() const
+{
+  switch (this->GetKind())
+  {
+    case Kind::Same:                         return 1;
+    case Kind::SameLocals1StackItem:         return 1;
+    case Kind::SameLocals1StackItemExtended: return 1 + 2;
+    case Kind::Chop:                         return 1 + 2;
+    case Kind::SameExtended:                 return 1 + 2;
+    case Kind::Append:                       return 1 + 2;
+    case Kind::Full:                         return 1 + 2 + 2 + 2;
+  }
+
+  return 0;
+}
+
+U32 StackMapTableAttribute::GetLength() const
+{
+  U32 len = sizeof(U16); //number_of_entries
+
+  for (const auto& frame : Frames)
+  {
+    len += frame.GetLength();
+
+    for (const auto& type : std::span{Types}.subspan(frame.TypesBegin, frame.LocalsCount + frame.StackCount))
+      len += type.GetLength();
+  }
+
+  return len;
+}
+
+U32 BootstrapMethodsAttribute::GetLength() const
+{
+  U32 len = sizeof(U16); //num_bootstrap_methods
+
+  for (const auto& method : Methods)
+    len += sizeof(method.MethodRef) + sizeof(method.ArgumentCount) + method.ArgumentCount * sizeof(U16);
+
+  return len;
+}
+
+U32 RecordAttribute::GetLength() const
+{
+  U32 len = sizeof(U16); //components_count
+
+  for (const auto& component : Components)
+  {
+    len += sizeof(component.NameIndex) + sizeof(component.DescriptorIndex) + sizeof(U16);
+
+    for (const auto& pAttr : component.Attributes)
+      len += AttributeInfo::GetHeaderLength() + pAttr->GetLength();
+  }
+
+  return len;
+}
+
+U32 ModuleAttribute::GetLength() const
+{
+  U32 len = sizeof(ModuleNameIndex) + sizeof(ModuleFlags) + sizeof(ModuleVersionIndex);
+
+  //every table has a U16 count, exports / opens / provides entries a count
+  //of their index list
+  len += static_cast<U32>(sizeof(U16) + Requires.size() * sizeof(ModuleRequires));
+  len += static_cast<U32>(sizeof(U16) + Exports.size() * 3 * sizeof(U16));
+  len += static_cast<U32>(sizeof(U16) + Opens.size() * 3 * sizeof(U16));
+  len += static_cast<U32>(sizeof(U16) + Uses.size() * sizeof(U16));
+  len += static_cast<U32>(sizeof(U16) + Provides.size() * 2 * sizeof(U16));
+
+  for (const auto& package : Exports)
+    len += package.ToCount * sizeof(U16);
+
+  for (const auto& package : Opens)
+    len += package.ToCount * sizeof(U16);
+
+  for (const auto& provides : Provides)
+    len += provides.WithCount * sizeof(U16);
+
+  return len;
+}
+
+U32 LazyAttribute::GetLength() const
+{
+  if (const AttributeInfo* decoded = this->GetDecoded())
+    return decoded->GetLength();
+
+  return static_cast<U32>(Body.size());
+}
+
+ErrorOr< std::reference_wrapper<AttributeInfo> > LazyAttribute::Decode(const ConstantPool& constPool) const
+{
+  std::call_once(m_decodeFlag, [this, &constPool]()
+  {
+    ByteReader reader{Body};
+
+    //the body lives in the bytes the attribute was parsed from, so the
+    //decoded attribute can be written by copying them as long as it's 
+    //unchanged, and annotations can reference it
+    ParseOptions options;
+    options.KeepOriginalBytes = !OriginalBytes.empty();
+    options.ZeroCopyStrings = true;
+
+    auto errOrAttr = ClassFileParser::ParseAttributeBody(reader, constPool, 
+        NameIndex, static_cast<U32>(Body.size()), options);
+
+    if (errOrAttr.IsError())
+    {
+      m_decodeError = errOrAttr.GetError();
+      return;
+    }
+
+    if (reader.Remaining() != 0)
+    {
+      m_decodeError = Error::FromFormatStr("LazyAttribute.Decode() failed: decoding the body only consumed %zu of %zu bytes", 
+          reader.Tell(), reader.Size());
+      return;
+    }
+
+    m_decoded = errOrAttr.Release();
+    m_decoded->OriginalBytes = OriginalBytes;
+    m_decodedPtr.store(m_decoded.get(), std::memory_order_release);
+  });
+
+  if (m_decodeError.has_value())
+    return *m_decodeError;
+
+  return *m_decoded;
+}
+
+ErrorOr< std::reference_wrapper<AttributeInfo> > LazyAttribute::Resolve(AttributeInfo& attr, const ConstantPool& constPool)
+{
+  if (attr.GetType() != Type::Lazy)
+    return std::ref(attr);
+
+  return static_cast<LazyAttribute&>(attr).Decode(constPool);
+}
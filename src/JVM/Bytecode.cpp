@@ -0,0 +1,245 @@
+#include "FileFormats/JVM/Bytecode.hpp"
+
+#include "Util/IO.hpp"
+#include "Util/Error.hpp"
+
+#include <algorithm>
+
+using namespace FileFormats;
+using namespace FileFormats::JVM;
+
+//Returns the size of the instruction at the readers position, reading only
+//what is needed to determine it
+static ErrorOr<U32> validateInstruction(ByteReader& reader)
+{
+  U32 codeOffset = static_cast<U32>(reader.Tell());
+
+  U8 opCode;
+  TRY(Read<BigEndian>(reader, opCode));
+
+  switch (OpCodeInfoTable[opCode].Layout)
+  {
+    case OperandLayout::TableSwitch:
+    {
+      U32 padding = GetSwitchPadding(codeOffset);
+      if (!reader.CanRead(padding))
+        return ReadOutOfBoundsError(reader, padding);
+
+      reader.Advance(padding);
+
+      S32 def, low, high;
+      TRY(Read<BigEndian>(reader, def, low, high));
+
+      if (high < low)
+        return Error::FromFormatStr("TABLESWITCH at code offset %u has high (%d) < low (%d)", codeOffset, high, low);
+
+      U64 offsetsSize = (static_cast<U64>(static_cast<S64>(high) - low) + 1) * sizeof(S32);
+      if (offsetsSize > reader.Remaining())
+        return ReadOutOfBoundsError(reader, offsetsSize);
+
+      return static_cast<U32>(1 + padding + 12 + offsetsSize);
+    }
+
+    case OperandLayout::LookupSwitch:
+    {
+      U32 padding = GetSwitchPadding(codeOffset);
+      if (!reader.CanRead(padding))
+        return ReadOutOfBoundsError(reader, padding);
+
+      reader.Advance(padding);
+
+      S32 def, nPairs;
+      TRY(Read<BigEndian>(reader, def, nPairs));
+
+      if (nPairs < 0)
+        return Error::FromFormatStr("LOOKUPSWITCH at code offset %u has a negative pair count (%d)", codeOffset, nPairs);
+
+      U64 pairsSize = static_cast<U64>(nPairs) * 2 * sizeof(S32);
+      if (pairsSize > reader.Remaining())
+        return ReadOutOfBoundsError(reader, pairsSize);
+
+      return static_cast<U32>(1 + padding + 8 + pairsSize);
+    }
+
+    case OperandLayout::Wide:
+    {
+      U8 modified;
+      TRY(Read<BigEndian>(reader, modified));
+
+      switch (modified)
+      {
+        case OP_IINC:
+        {
+          //U16 index, S16 const
+          if (!reader.CanRead(4))
+            return ReadOutOfBoundsError(reader, 4);
+
+          return U32{6};
+        }
+
+        case OP_ILOAD:  case OP_LLOAD:  case OP_FLOAD:  case OP_DLOAD:  case OP_ALOAD:
+        case OP_ISTORE: case OP_LSTORE: case OP_FSTORE: case OP_DSTORE: case OP_ASTORE:
+        case OP_RET:
+        {
+          //U16 index
+          if (!reader.CanRead(2))
+            return ReadOutOfBoundsError(reader, 2);
+
+          return U32{4};
+        }
+      }
+
+      return Error::FromFormatStr("WIDE at code offset %u modifies opcode %#04x, which can't be widened", codeOffset, modified);
+    }
+
+    case OperandLayout::Invalid:
+      return Error::FromFormatStr("failed parsing unknown opcode %#04x at code offset %u", opCode, codeOffset);
+
+    default:
+    {
+      size_t operandLength = GetOperandLength(OpCodeInfoTable[opCode].Layout);
+      if (!reader.CanRead(operandLength))
+        return ReadOutOfBoundsError(reader, operandLength);
+
+      return static_cast<U32>(1 + operandLength);
+    }
+  }
+}
+
+ErrorOr<void> Bytecode::Validate(std::span<const U8> bytes)
+{
+  ByteReader reader{bytes};
+
+  for (size_t offset = 0; offset < bytes.size(); )
+  {
+    auto errOrLength = validateInstruction(reader);
+    VERIFY(errOrLength);
+
+    offset += errOrLength.Get();
+    reader.Seek(offset);
+  }
+
+  return {};
+}
+
+ErrorOr<Bytecode> Bytecode::FromBytes(std::vector<U8> bytes)
+{
+  TRY(Bytecode::Validate(bytes));
+
+  Bytecode code;
+  code.m_owned = std::move(bytes);
+  code.m_bytes = code.m_owned;
+  code.m_isOwned = true;
+
+  return code;
+}
+
+ErrorOr<Bytecode> Bytecode::FromView(std::span<const U8> bytes)
+{
+  TRY(Bytecode::Validate(bytes));
+
+  Bytecode code;
+  code.m_bytes = bytes;
+
+  return code;
+}
+
+Bytecode::Bytecode(const Bytecode& other)
+  : m_bytes{other.m_bytes}, m_owned{other.m_owned}, m_isOwned{other.m_isOwned},
+    m_offsets{other.m_offsets}, m_indexed{other.m_indexed}
+{
+  if (m_isOwned)
+    m_bytes = m_owned;
+}
+
+Bytecode::Bytecode(Bytecode&& other) noexcept
+  : m_bytes{other.m_bytes}, m_owned{std::move(other.m_owned)}, m_isOwned{other.m_isOwned},
+    m_offsets{std::move(other.m_offsets)}, m_indexed{other.m_indexed}
+{
+  if (m_isOwned)
+    m_bytes = m_owned;
+
+  other.m_bytes = {};
+  other.m_isOwned = false;
+  other.m_indexed = false;
+}
+
+Bytecode& Bytecode::operator=(const Bytecode& other)
+{
+  if (this != &other)
+    *this = Bytecode{other};
+
+  return *this;
+}
+
+Bytecode& Bytecode::operator=(Bytecode&& other) noexcept
+{
+  if (this == &other)
+    return *this;
+
+  m_owned = std::move(other.m_owned);
+  m_isOwned = other.m_isOwned;
+  m_bytes = m_isOwned ? std::span<const U8>{m_owned} : other.m_bytes;
+  m_offsets = std::move(other.m_offsets);
+  m_indexed = other.m_indexed;
+
+  other.m_bytes = {};
+  other.m_owned.clear();
+  other.m_isOwned = false;
+  other.m_offsets.clear();
+  other.m_indexed = false;
+
+  return *this;
+}
+
+void Bytecode::BuildIndex() const
+{
+  m_offsets.clear();
+
+  //most instructions are 1 - 3 bytes long
+  m_offsets.reserve(m_bytes.size() / 2);
+
+  for (U32 offset = 0; offset < m_bytes.size(); offset += GetLengthUnchecked(m_bytes.data(), offset))
+    m_offsets.push_back(offset);
+
+  m_indexed = true;
+}
+
+const std::vector<U32>& Bytecode::GetInstructionOffsets() const
+{
+  if (!m_indexed)
+    this->BuildIndex();
+
+  return m_offsets;
+}
+
+InstructionView Bytecode::GetInstruction(size_t index) const
+{
+  const auto& offsets = this->GetInstructionOffsets();
+  assert(index < offsets.size());
+
+  U32 offset = offsets[index];
+  U32 end = index + 1 < offsets.size() ? offsets[index + 1] : this->GetSize();
+
+  return { m_bytes.data() + offset, offset, end - offset };
+}
+
+std::optional<size_t> Bytecode::GetInstructionIndex(U32 offset) const
+{
+  const auto& offsets = this->GetInstructionOffsets();
+
+  auto itr = std::lower_bound(offsets.begin(), offsets.end(), offset);
+  if (itr == offsets.end() || *itr != offset)
+    return std::nullopt;
+
+  return static_cast<size_t>(itr - offsets.begin());
+}
+
+std::optional<InstructionView> Bytecode::At(U32 offset) const
+{
+  auto index = this->GetInstructionIndex(offset);
+  if (!index)
+    return std::nullopt;
+
+  return this->GetInstruction(*index);
+}
@@ -0,0 +1,328 @@
+#include "FileFormats/JVM/ClassFileBatchParser.hpp"
+#include "FileFormats/MappedFile.hpp"
+
+#include "Util/Error.hpp"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <numeric>
+#include <algorithm>
+#include <filesystem>
+
+using namespace FileFormats;
+using namespace JVM;
+
+namespace
+{
+
+//Range of the schedule owned by a worker. Begin & end are packed into one
+//atomic word, so the owner (popping from the front) and thieves (taking the
+//back half) only ever need a single CAS.
+class WorkRange
+{
+  public:
+    void Set(U32 begin, U32 end)
+    {
+      m_range.store(pack(begin, end), std::memory_order_release);
+    }
+
+    bool Pop(U32& item)
+    {
+      U64 range = m_range.load(std::memory_order_acquire);
+
+      while (true)
+      {
+        U32 begin = static_cast<U32>(range), end = static_cast<U32>(range >> 32);
+        if (begin >= end)
+          return false;
+
+        if (m_range.compare_exchange_weak(range, pack(begin + 1, end), std::memory_order_acq_rel))
+        {
+          item = begin;
+          return true;
+        }
+      }
+    }
+
+    bool StealHalf(U32& stolenBegin, U32& stolenEnd)
+    {
+      U64 range = m_range.load(std::memory_order_acquire);
+
+      while (true)
+      {
+        U32 begin = static_cast<U32>(range), end = static_cast<U32>(range >> 32);
+        if (begin >= end)
+          return false;
+
+        U32 newEnd = end - (end - begin + 1) / 2;
+
+        if (m_range.compare_exchange_weak(range, pack(begin, newEnd), std::memory_order_acq_rel))
+        {
+          stolenBegin = newEnd;
+          stolenEnd = end;
+          return true;
+        }
+      }
+    }
+
+  private:
+    static U64 pack(U32 begin, U32 end) { return (static_cast<U64>(end) << 32) | begin; }
+
+    //keep the ranges of different workers on different cache lines
+    alignas(64) std::atomic<U64> m_range{0};
+};
+
+struct WorkerStats
+{
+  size_t ClassCount = 0;
+  size_t ErrorCount = 0;
+};
+
+} //namespace
+
+//arena = the workers arena to parse into, nullptr to allocate as usual
+using ParseItemFn = std::function<ErrorOr<ClassFile>(size_t index, Arena* arena)>;
+
+//options with the arena to parse into, ParseOptions::TargetArena of the
+//batch options is never used as it would be shared by the threads
+static ParseOptions withArena(const ParseOptions& options, Arena* arena)
+{
+  ParseOptions arenaOptions = options;
+  arenaOptions.TargetArena = arena;
+  return arenaOptions;
+}
+
+static BatchParseStats runBatch(const std::vector<U64>& sizes, const ParseItemFn& parseItem,
+    const ClassFileBatchParser::Callback& callback, const BatchParseOptions& options)
+{
+  auto startTime = std::chrono::steady_clock::now();
+
+  BatchParseStats stats;
+  stats.ByteCount = std::accumulate(sizes.begin(), sizes.end(), U64{0});
+
+  size_t count = sizes.size();
+  if (count == 0)
+    return stats;
+
+  unsigned threadCount = options.ThreadCount != 0 ? options.ThreadCount : std::thread::hardware_concurrency();
+  threadCount = static_cast<unsigned>( std::clamp<size_t>(threadCount, 1, count) );
+
+  //Largest inputs first, dealt round robin so that every worker starts with
+  //a similar mix of sizes and ends on its smallest inputs, which keeps the
+  //tail short when they get stolen.
+  std::vector<U32> bySize(count);
+  std::iota(bySize.begin(), bySize.end(), U32{0});
+  std::stable_sort(bySize.begin(), bySize.end(), [&](U32 a, U32 b) { return sizes[a] > sizes[b]; });
+
+  std::vector<U32> schedule(count);
+  std::unique_ptr<WorkRange[]> ranges{ new WorkRange[threadCount] };
+
+  size_t position = 0;
+  for (unsigned worker = 0; worker < threadCount; worker++)
+  {
+    size_t begin = position;
+
+    for (size_t i = worker; i < count; i += threadCount)
+      schedule[position++] = bySize[i];
+
+    ranges[worker].Set(static_cast<U32>(begin), static_cast<U32>(position));
+  }
+
+  std::vector<WorkerStats> workerStats(threadCount);
+
+  auto work = [&](unsigned worker)
+  {
+    WorkerStats& local = workerStats[worker];
+
+    std::optional<Arena> arena;
+    if (options.ReuseWorkerArenas)
+      arena.emplace();
+
+    while (true)
+    {
+      U32 item;
+
+      while (ranges[worker].Pop(item))
+      {
+        size_t index = schedule[item];
+
+        {
+          ErrorOr<ClassFile> result = parseItem(index, arena ? &*arena : nullptr);
+
+          if (result.IsError())
+            local.ErrorCount++;
+          else
+            local.ClassCount++;
+
+          callback(index, std::move(result));
+        }
+
+        //the result was destroyed above
+        if (arena)
+          arena->Reset();
+      }
+
+      //Inputs stolen by another worker that hasn't published them yet are
+      //missed here, that worker parses them itself though.
+      bool stole = false;
+      for (unsigned i = 1; i < threadCount && !stole; i++)
+      {
+        U32 begin, end;
+        if (ranges[(worker + i) % threadCount].StealHalf(begin, end))
+        {
+          ranges[worker].Set(begin, end);
+          stole = true;
+        }
+      }
+
+      if (!stole)
+        return;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(threadCount - 1);
+
+  for (unsigned worker = 1; worker < threadCount; worker++)
+    threads.emplace_back(work, worker);
+
+  work(0);
+
+  for (auto& thread : threads)
+    thread.join();
+
+  for (const WorkerStats& local : workerStats)
+  {
+    stats.ClassCount += local.ClassCount;
+    stats.ErrorCount += local.ErrorCount;
+  }
+
+  stats.ThreadCount = threadCount;
+  stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+  return stats;
+}
+
+BatchParseStats ClassFileBatchParser::Parse(std::span<const std::span<const U8>> inputs,
+    const Callback& callback, const BatchParseOptions& options)
+{
+  std::vector<U64> sizes(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++)
+    sizes[i] = inputs[i].size();
+
+  return runBatch(sizes, [&](size_t index, Arena* arena)
+  {
+    return ClassFileParser::ParseClassFile(inputs[index], withArena(options.Parse, arena));
+  }, callback, options);
+}
+
+BatchParseStats ClassFileBatchParser::ParseFiles(std::span<const std::string> paths,
+    const Callback& callback, const BatchParseOptions& options)
+{
+  //only used for scheduling, unreadable files get reported when parsing
+  std::vector<U64> sizes(paths.size());
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    std::error_code error;
+    auto size = std::filesystem::file_size(paths[i], error);
+    sizes[i] = error ? 0 : size;
+  }
+
+  //the mapping doesn't outlive the parse call
+  ParseOptions parseOptions = options.Parse;
+  parseOptions.LazyAttributes = false;
+  parseOptions.ZeroCopyStrings = false;
+  parseOptions.KeepOriginalBytes = false;
+
+  return runBatch(sizes, [&](size_t index, Arena* arena) -> ErrorOr<ClassFile>
+  {
+    auto errOrFile = MappedFile::Open(paths[index]);
+    if (errOrFile.IsError())
+      return errOrFile.GetError();
+
+    return ClassFileParser::ParseClassFile(errOrFile.Get().GetBytes(), withArena(parseOptions, arena));
+  }, callback, options);
+}
+
+BatchParseStats ClassFileBatchParser::ParseArchive(const Zip::ZipArchive& archive,
+    const Callback& callback, const BatchParseOptions& options)
+{
+  const auto& entries = archive.GetEntries();
+
+  std::vector<size_t> classEntries;
+  std::vector<U64> sizes;
+
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    if (entries[i].IsClassFile())
+    {
+      classEntries.push_back(i);
+      sizes.push_back(entries[i].UncompressedSize);
+    }
+  }
+
+  //inflated entries live in a per thread buffer that gets reused
+  ParseOptions inflatedOptions = options.Parse;
+  inflatedOptions.LazyAttributes = false;
+  inflatedOptions.ZeroCopyStrings = false;
+  inflatedOptions.KeepOriginalBytes = false;
+
+  return runBatch(sizes, [&](size_t index, Arena* arena) -> ErrorOr<ClassFile>
+  {
+    const Zip::ZipEntry& entry = entries[ classEntries[index] ];
+
+    auto errOrData = archive.GetData(entry);
+    VERIFY(errOrData);
+
+    bool stored = entry.CompressionMethod == Zip::ZipEntry::Method::Stored;
+    return ClassFileParser::ParseClassFile(errOrData.Get(), withArena(stored ? options.Parse : inflatedOptions, arena));
+  }, [&](size_t index, ErrorOr<ClassFile>&& result)
+  {
+    callback(classEntries[index], std::move(result));
+  }, options);
+}
+
+//collects the results of the callback based overloads in input order
+template <typename InputT>
+static std::vector< ErrorOr<ClassFile> > collectResults(std::span<const InputT> inputs,
+    const BatchParseOptions& options, BatchParseStats* stats,
+    BatchParseStats (*parse)(std::span<const InputT>, const ClassFileBatchParser::Callback&, const BatchParseOptions&))
+{
+  //the results outlive the callback
+  BatchParseOptions collectOptions = options;
+  collectOptions.ReuseWorkerArenas = false;
+
+  //ErrorOr isn't default constructible
+  std::vector< std::optional< ErrorOr<ClassFile> > > slots(inputs.size());
+
+  BatchParseStats batchStats = parse(inputs, [&](size_t index, ErrorOr<ClassFile>&& result)
+  {
+    slots[index].emplace(std::move(result));
+  }, collectOptions);
+
+  if (stats != nullptr)
+    *stats = batchStats;
+
+  std::vector< ErrorOr<ClassFile> > results;
+  results.reserve(slots.size());
+
+  for (auto& slot : slots)
+    results.emplace_back(std::move(*slot));
+
+  return results;
+}
+
+std::vector< ErrorOr<ClassFile> > ClassFileBatchParser::Parse(std::span<const std::span<const U8>> inputs,
+    const BatchParseOptions& options, BatchParseStats* stats)
+{
+  return collectResults<std::span<const U8>>(inputs, options, stats, &ClassFileBatchParser::Parse);
+}
+
+std::vector< ErrorOr<ClassFile> > ClassFileBatchParser::ParseFiles(std::span<const std::string> paths,
+    const BatchParseOptions& options, BatchParseStats* stats)
+{
+  return collectResults<std::string>(paths, options, stats, &ClassFileBatchParser::ParseFiles);
+}
@@ -4,509 +4,1373 @@
 #include "Util/Error.hpp"
 
 #include <iostream>
+#include <iterator>
+#include <algorithm>
 #include <cassert>
+#include <array>
+#include <utility>
+#include <type_traits>
 
 using namespace FileFormats;
 using namespace JVM;
+using namespace Instructions;
 
-ErrorOr<ClassFile> ClassFileParser::ParseClassFile(std::istream& stream)
+//allocates from options.TargetArena if set, from the heap otherwise
+template <typename T, typename... Args>
+static ArenaPtr<T> allocate(const ParseOptions& options, Args&&... args)
+{
+  if (options.TargetArena != nullptr)
+    return options.TargetArena->New<T>(std::forward<Args>(args)...);
+
+  return ArenaPtr<T>{ new T(std::forward<Args>(args)...) };
+}
+
+static ErrorOr<FieldMethodInfo> readFieldMethodInfo(ByteReader& reader,
+    const ConstantPool& constPool, AttributeMask skip, const ParseOptions& options)
+{
+  FieldMethodInfo info;
+  size_t start = reader.Tell();
+
+  TRY(Read<BigEndian>(reader, info.AccessFlags,
+                              info.NameIndex,
+                              info.DescriptorIndex));
+
+  TRY(ClassFileParser::ParseAttributes(reader, constPool, skip, info.Attributes, options));
+
+  //with skipped attributes the bytes don't match the parsed info
+  if (options.KeepOriginalBytes && skip == 0)
+    info.OriginalBytes = reader.GetBytes().subspan(start, reader.Tell() - start);
+
+  return info;
+}
+
+ErrorOr<ClassFile> ClassFileParser::ParseClassFile(std::span<const U8> bytes, 
+    Arena& arena, const ParseOptions& options)
+{
+  ParseOptions arenaOptions = options;
+  arenaOptions.TargetArena = &arena;
+
+  ByteReader reader{bytes};
+  return ClassFileParser::ParseClassFile(reader, arenaOptions);
+}
+
+ErrorOr<ClassFile> ClassFileParser::ParseClassFile(std::span<const U8> bytes, const ParseOptions& options)
+{
+  ByteReader reader{bytes};
+  return ClassFileParser::ParseClassFile(reader, options);
+}
+
+ErrorOr<ClassFile> ClassFileParser::ParseClassFile(ByteReader& reader, const ParseOptions& parseOptions)
 {
   ClassFile cf;
 
-  TRY(Read<BigEndian>(stream,
+  ParseOptions options = parseOptions;
+  if (options.UseArena && options.TargetArena == nullptr)
+  {
+    //the parsed objects take about as much memory as the class file, most
+    //classes are far smaller than the default block size
+    size_t blockSize = std::clamp<size_t>(reader.Remaining() * 2, 4096, Arena::DefaultBlockSize);
+    cf.OwnedArena = std::make_unique<Arena>(blockSize);
+    options.TargetArena = cf.OwnedArena.get();
+  }
+
+  TRY(Read<BigEndian>(reader,
                       cf.Magic,
                       cf.MinorVersion,
                       cf.MajorVersion));
 
-  auto errOrCP = ClassFileParser::ParseConstantPool(stream);
+  auto errOrCP = ClassFileParser::ParseConstantPool(reader, options);
   VERIFY(errOrCP);
 
   cf.ConstPool = errOrCP.Release();
 
-  U16 interfacesCount;
-  TRY(Read<BigEndian>(stream,
+  U16 interfacesCount{};
+  TRY(Read<BigEndian>(reader,
                       cf.AccessFlags,
                       cf.ThisClass,
                       cf.SuperClass,
                       interfacesCount));
 
-  cf.Interfaces.reserve(interfacesCount);
-  for (auto i = 0; i < interfacesCount; i++)
-  {
-    U16 interfaceIndex;
-    TRY( Read<BigEndian>(stream, interfaceIndex));
-    cf.Interfaces.emplace_back(interfaceIndex);
-  }
+  TRY(ReadArray<BigEndian>(reader, cf.Interfaces, interfacesCount));
 
-  U16 fieldsCount;
-  TRY(Read<BigEndian>(stream, fieldsCount));
+  U16 fieldsCount{};
+  TRY(Read<BigEndian>(reader, fieldsCount));
 
   cf.Fields.reserve(fieldsCount);
   for (auto i = 0; i < fieldsCount; i++)
   {
-    auto errOrField = ClassFileParser::ParseFieldMethodInfo(stream, cf.ConstPool);
+    auto errOrField = readFieldMethodInfo(reader, cf.ConstPool, options.SkipFieldAttributes, options);
     VERIFY(errOrField);
 
     cf.Fields.emplace_back(errOrField.Release());
   }
 
 
-  U16 methodsCount;
-  TRY(Read<BigEndian>(stream, methodsCount));
+  U16 methodsCount{};
+  TRY(Read<BigEndian>(reader, methodsCount));
 
   cf.Methods.reserve(methodsCount);
   for (auto i = 0; i < methodsCount; i++)
   {
-    auto errOrMethod = ClassFileParser::ParseFieldMethodInfo(stream, cf.ConstPool);
+    auto errOrMethod = readFieldMethodInfo(reader, cf.ConstPool, options.SkipMethodAttributes, options);
     VERIFY(errOrMethod);
 
     cf.Methods.emplace_back(errOrMethod.Release());
   }
 
-  U16 attributesCount;
-  TRY(Read<BigEndian>(stream, attributesCount));
-
-  cf.Attributes.reserve(attributesCount);
-  for (auto i = 0; i < attributesCount; i++)
-  {
-    auto errOrAttr = ClassFileParser::ParseAttribute(stream, cf.ConstPool);
-    VERIFY(errOrAttr);
-
-    cf.Attributes.emplace_back(errOrAttr.Release());
-  }
+  TRY(ClassFileParser::ParseAttributes(reader, cf.ConstPool, options.SkipClassAttributes, cf.Attributes, options));
 
   return cf;
 }
 
-ErrorOr<ConstantPool> ClassFileParser::ParseConstantPool(std::istream& stream)
+ErrorOr<ConstantPool> ClassFileParser::ParseConstantPool(ByteReader& reader, const ParseOptions& options)
 {
   ConstantPool cp;
 
-  U16 count;
-  TRY(Read<BigEndian>(stream, count));
+  if (options.TargetArena != nullptr)
+    cp.SetStringStorage(*options.TargetArena);
+
+  U16 count{};
+  TRY(Read<BigEndian>(reader, count));
 
   cp.Reserve(count);
 
+  //The constants are decoded straight into the pools flat storage instead of 
+  //going through ParseConstant() and CPInfo objects.
   //count = number of constants + 1
-  for(U16 i = 0; i < count-1; i++)
+  for(U16 i = 1; i < count; i++)
   {
-    auto errOrCPInfo = ClassFileParser::ParseConstant(stream);
-    VERIFY(errOrCPInfo);
-
-    auto cpInfo = errOrCPInfo.Release();
+    U8 tag{};
+    TRY(Read<BigEndian>(reader, tag));
 
-    CPInfo::Type type = cpInfo->GetType();
+    CPInfo::Type type = static_cast<CPInfo::Type>(tag);
 
-    cp.Add( std::move(cpInfo) ); 
-
-    //Long & Double constants require the next index into the constant pool
-    //after them be invalid.
-    if(type == CPInfo::Type::Long || type == CPInfo::Type::Double)
+    switch(type)
     {
-      cp.Add(nullptr);
-      i++;
+      case CPInfo::Type::Class:
+      case CPInfo::Type::String:
+      case CPInfo::Type::MethodType:
+      {
+        U16 index{};
+        TRY(Read<BigEndian>(reader, index));
+        TRY(cp.AddIndices(type, index));
+        break;
+      }
+
+      case CPInfo::Type::Fieldref:
+      case CPInfo::Type::Methodref:
+      case CPInfo::Type::InterfaceMethodref:
+      case CPInfo::Type::NameAndType:
+      case CPInfo::Type::InvokeDynamic:
+      {
+        U16 first{}, second{};
+        TRY(Read<BigEndian>(reader, first, second));
+        TRY(cp.AddIndices(type, first, second));
+        break;
+      }
+
+      case CPInfo::Type::MethodHandle:
+      {
+        U8 referenceKind{};
+        U16 referenceIndex{};
+        TRY(Read<BigEndian>(reader, referenceKind, referenceIndex));
+        TRY(cp.AddIndices(type, referenceKind, referenceIndex));
+        break;
+      }
+
+      case CPInfo::Type::Integer:
+      case CPInfo::Type::Float:
+      {
+        U32 bytes{};
+        TRY(Read<BigEndian>(reader, bytes));
+        TRY(cp.AddSlot(type, bytes));
+        break;
+      }
+
+      //Long & Double constants require the next index into the constant pool
+      //after them be invalid.
+      case CPInfo::Type::Long:
+      case CPInfo::Type::Double:
+      {
+        U32 highBytes{}, lowBytes{};
+        TRY(Read<BigEndian>(reader, highBytes, lowBytes));
+        TRY(cp.AddSlot(type, (static_cast<U64>(highBytes) << 32) | lowBytes));
+        TRY(cp.AddSlot(CPInfo::Type::Unusable, 0));
+        i++;
+        break;
+      }
+
+      case CPInfo::Type::UTF8:
+      {
+        U16 len{};
+        TRY(Read<BigEndian>(reader, len));
+
+        std::span<const U8> bytes;
+        TRY(ReadBytes(reader, len, bytes));
+
+        std::string_view str{ reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+
+        TRY(options.ZeroCopyStrings ? cp.AddUTF8View(str) : cp.AddUTF8Slot(str));
+        break;
+      }
+
+      default:
+        return Error::FromFormatStr("ParseConstantPool encountered unknown tag: 0x%X (offset = 0x%zX)", tag, reader.Tell() - 1);
     }
-
   }
 
   return cp;
 }
 
-static ErrorOr<void> readConst(std::istream& stream, ClassInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, ClassInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.NameIndex));
+  TRY(Read<BigEndian>(reader, info.NameIndex));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, FieldrefInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, FieldrefInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.ClassIndex, info.NameAndTypeIndex));
+  TRY(Read<BigEndian>(reader, info.ClassIndex, info.NameAndTypeIndex));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, MethodrefInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, MethodrefInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.ClassIndex, info.NameAndTypeIndex));
+  TRY(Read<BigEndian>(reader, info.ClassIndex, info.NameAndTypeIndex));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, InterfaceMethodrefInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, InterfaceMethodrefInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.ClassIndex, info.NameAndTypeIndex));
+  TRY(Read<BigEndian>(reader, info.ClassIndex, info.NameAndTypeIndex));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, StringInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, StringInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.StringIndex));
+  TRY(Read<BigEndian>(reader, info.StringIndex));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, IntegerInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, IntegerInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.Bytes));
+  TRY(Read<BigEndian>(reader, info.Bytes));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, FloatInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, FloatInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.Bytes));
+  TRY(Read<BigEndian>(reader, info.Bytes));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, LongInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, LongInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.HighBytes, info.LowBytes));
+  TRY(Read<BigEndian>(reader, info.HighBytes, info.LowBytes));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, DoubleInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, DoubleInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.HighBytes, info.LowBytes));
+  TRY(Read<BigEndian>(reader, info.HighBytes, info.LowBytes));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, NameAndTypeInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, NameAndTypeInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.NameIndex, info.DescriptorIndex));
+  TRY(Read<BigEndian>(reader, info.NameIndex, info.DescriptorIndex));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, UTF8Info& info)
+static ErrorOr<void> readConst(ByteReader& reader, UTF8Info& info, const ParseOptions& options)
 {
-  U16 len;
-  TRY(Read<BigEndian>(stream, len));
+  U16 len{};
+  TRY(Read<BigEndian>(reader, len));
 
-  info.String = std::string(len, '\0');
-  stream.read(&info.String[0], len);
+  std::span<const U8> bytes;
+  TRY(ReadBytes(reader, len, bytes));
 
-  if (stream.bad())
-    return Error::FromFormatStr("failed to read UTF8 const string. Stream badbit set after read. (streampos = 0x%X)", stream.tellg());
+  std::string_view str{ reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+
+  if (options.ZeroCopyStrings)
+    info.SetView(str);
+  else
+    info.Set(std::string{str});
 
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, MethodHandleInfo& info)
+
+static ErrorOr<void> readConst(ByteReader& reader, MethodHandleInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.ReferenceKind, info.ReferenceIndex));
+  TRY(Read<BigEndian>(reader, info.ReferenceKind, info.ReferenceIndex));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, MethodTypeInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, MethodTypeInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.DescriptorIndex));
+  TRY(Read<BigEndian>(reader, info.DescriptorIndex));
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, InvokeDynamicInfo& info)
+static ErrorOr<void> readConst(ByteReader& reader, InvokeDynamicInfo& info)
 {
-  TRY(Read<BigEndian>(stream, info.BootstrapMethodAttrIndex, info.NameAndTypeIndex));
+  TRY(Read<BigEndian>(reader, info.BootstrapMethodAttrIndex, info.NameAndTypeIndex));
   return {};
 }
 
+//only UTF8 constants depend on the options
+template <typename CPInfoT>
+static ErrorOr<void> readConst(ByteReader& reader, CPInfoT& info, const ParseOptions&)
+{
+  return readConst(reader, info);
+}
+
 template <typename CPInfoT>
-static ErrorOr< std::unique_ptr<CPInfo> > parseConstT(std::istream& stream)
+static ErrorOr< ArenaPtr<CPInfo> > parseConstT(ByteReader& reader, const ParseOptions& options)
 {
-  CPInfoT* pInfo = new CPInfoT{};
-  auto errOrConst = readConst(stream, *pInfo);
+  ArenaPtr<CPInfoT> info = allocate<CPInfoT>(options);
+  auto errOrConst = readConst(reader, *info, options);
   VERIFY(errOrConst);
 
-  return std::unique_ptr<CPInfo>(pInfo);
+  return ArenaPtr<CPInfo>(std::move(info));
 }
 
-ErrorOr< std::unique_ptr<CPInfo> > ClassFileParser::ParseConstant(std::istream& stream)
+ErrorOr< ArenaPtr<CPInfo> > ClassFileParser::ParseConstant(ByteReader& reader, const ParseOptions& options)
 {
-  CPInfo::Type type = static_cast<CPInfo::Type>(stream.get());
+  U8 tag{};
+  TRY(Read<BigEndian>(reader, tag));
+
+  CPInfo::Type type = static_cast<CPInfo::Type>(tag);
 
   switch(type)
   {
-    case CPInfo::Type::Class:       return parseConstT<ClassInfo>(stream);
-    case CPInfo::Type::Fieldref:    return parseConstT<FieldrefInfo>(stream);
-    case CPInfo::Type::Methodref:   return parseConstT<MethodrefInfo>(stream);
-    case CPInfo::Type::InterfaceMethodref: return parseConstT<InterfaceMethodrefInfo>(stream);
-    case CPInfo::Type::String:      return parseConstT<StringInfo>(stream);
-    case CPInfo::Type::Integer:     return parseConstT<IntegerInfo>(stream);
-    case CPInfo::Type::Float:       return parseConstT<FloatInfo>(stream);
-    case CPInfo::Type::Long:        return parseConstT<LongInfo>(stream);
-    case CPInfo::Type::Double:      return parseConstT<DoubleInfo>(stream);
-    case CPInfo::Type::NameAndType: return parseConstT<NameAndTypeInfo>(stream);
-    case CPInfo::Type::UTF8:        return parseConstT<UTF8Info>(stream);
-    case CPInfo::Type::MethodHandle:  return parseConstT<MethodHandleInfo>(stream);
-    case CPInfo::Type::MethodType:    return parseConstT<MethodTypeInfo>(stream);
-    case CPInfo::Type::InvokeDynamic: return parseConstT<InvokeDynamicInfo>(stream);
+    case CPInfo::Type::Class:       return parseConstT<ClassInfo>(reader, options);
+    case CPInfo::Type::Fieldref:    return parseConstT<FieldrefInfo>(reader, options);
+    case CPInfo::Type::Methodref:   return parseConstT<MethodrefInfo>(reader, options);
+    case CPInfo::Type::InterfaceMethodref: return parseConstT<InterfaceMethodrefInfo>(reader, options);
+    case CPInfo::Type::String:      return parseConstT<StringInfo>(reader, options);
+    case CPInfo::Type::Integer:     return parseConstT<IntegerInfo>(reader, options);
+    case CPInfo::Type::Float:       return parseConstT<FloatInfo>(reader, options);
+    case CPInfo::Type::Long:        return parseConstT<LongInfo>(reader, options);
+    case CPInfo::Type::Double:      return parseConstT<DoubleInfo>(reader, options);
+    case CPInfo::Type::NameAndType: return parseConstT<NameAndTypeInfo>(reader, options);
+    case CPInfo::Type::UTF8:        return parseConstT<UTF8Info>(reader, options);
+    case CPInfo::Type::MethodHandle:  return parseConstT<MethodHandleInfo>(reader, options);
+    case CPInfo::Type::MethodType:    return parseConstT<MethodTypeInfo>(reader, options);
+    case CPInfo::Type::InvokeDynamic: return parseConstT<InvokeDynamicInfo>(reader, options);
+    case CPInfo::Type::Unusable:      break;
   }
 
-  return Error::FromFormatStr("ParseConstant encountered unknown tag: 0x%X (streampos = 0x%X)", static_cast<U8>(type), stream.tellg());
+  return Error::FromFormatStr("ParseConstant encountered unknown tag: 0x%X (offset = 0x%zX)", tag, reader.Tell() - 1);
 }
 
 ErrorOr<FieldMethodInfo> ClassFileParser::ParseFieldMethodInfo(
-    std::istream& stream, const ConstantPool& constPool)
+    ByteReader& reader, const ConstantPool& constPool, const ParseOptions& options)
 {
-  FieldMethodInfo info;
+  //without knowing whether it's a field or a method, nothing is skipped
+  return readFieldMethodInfo(reader, constPool, 0, options);
+}
 
-  U16 attributesCount;
-  TRY(Read<BigEndian>(stream, info.AccessFlags,
-                              info.NameIndex,
-                              info.DescriptorIndex,
-                              attributesCount));
 
-  info.Attributes.reserve(attributesCount);
-  for (auto i = 0; i < attributesCount; i++)
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, ConstantValueAttribute& attr)
+{
+  TRY(Read<BigEndian>(reader, attr.Index));
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, SourceFileAttribute& attr)
+{
+  TRY(Read<BigEndian>(reader, attr.SourceFileIndex));
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool& constPool, const ParseOptions& options, CodeAttribute& attr)
+{
+  U32 codeLen{};
+  TRY(Read<BigEndian>(reader, 
+                      attr.MaxStack,
+                      attr.MaxLocals,
+                      codeLen));
+
+
+  std::span<const U8> code;
+  TRY(ReadBytes(reader, codeLen, code));
+
+  //the code is kept as its packed bytes, copied into the arena if there is one
+  auto errOrCode = options.TargetArena != nullptr 
+    ? Bytecode::FromView(options.TargetArena->CopyBytes(code))
+    : Bytecode::FromBytes({ code.begin(), code.end() });
+  VERIFY(errOrCode);
+
+  attr.Code = errOrCode.Release();
+
+  U16 exceptionTableLen{};
+  TRY(Read<BigEndian>(reader, exceptionTableLen));
+  TRY(ReadArray<BigEndian>(reader, attr.ExceptionTable, exceptionTableLen));
+
+  TRY(ClassFileParser::ParseAttributes(reader, constPool, options.SkipCodeAttributes, attr.Attributes, options));
+
+  return {};
+}
+
+static ErrorOr<void> readVerificationTypes(ByteReader& reader, 
+    std::vector<VerificationType>& types, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
   {
-    auto errOrAttr = ClassFileParser::ParseAttribute(stream, constPool);
-    VERIFY(errOrAttr);
+    VerificationType type{};
+    TRY(Read<BigEndian>(reader, type.TypeTag));
+
+    if (type.TypeTag > VerificationType::Tag::Uninitialized)
+      return Error::FromFormatStr("StackMapTable has a verification type with invalid tag %u", 
+          static_cast<unsigned int>(type.TypeTag));
 
-    info.Attributes.emplace_back(errOrAttr.Release());
+    if (type.HasData())
+      TRY(Read<BigEndian>(reader, type.Data));
+
+    types.push_back(type);
   }
 
-  return info;
+  return {};
 }
 
-
-static ErrorOr<void> readAttribute(std::istream& stream, 
-    const ConstantPool& constPool, ConstantValueAttribute& attr)
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, StackMapTableAttribute& attr)
 {
-  TRY(Read<BigEndian>(stream, attr.Index));
+  U16 numberOfEntries{};
+  TRY(Read<BigEndian>(reader, numberOfEntries));
+
+  attr.Frames.reserve(numberOfEntries);
+
+  for (auto i = 0; i < numberOfEntries; i++)
+  {
+    StackMapFrame frame{};
+    TRY(Read<BigEndian>(reader, frame.FrameType));
+
+    if (frame.FrameType >= 128 && frame.FrameType < 247)
+      return Error::FromFormatStr("StackMapTable frame %d has reserved frame type %u", 
+          i, static_cast<unsigned int>(frame.FrameType));
+
+    frame.TypesBegin = static_cast<U32>(attr.Types.size());
+
+    switch (frame.GetKind())
+    {
+      case StackMapFrame::Kind::Same:
+        frame.OffsetDelta = frame.FrameType;
+        break;
+
+      case StackMapFrame::Kind::SameLocals1StackItem:
+        frame.OffsetDelta = frame.FrameType - 64;
+        frame.StackCount = 1;
+        break;
+
+      case StackMapFrame::Kind::SameLocals1StackItemExtended:
+        TRY(Read<BigEndian>(reader, frame.OffsetDelta));
+        frame.StackCount = 1;
+        break;
+
+      case StackMapFrame::Kind::Chop:
+      case StackMapFrame::Kind::SameExtended:
+        TRY(Read<BigEndian>(reader, frame.OffsetDelta));
+        break;
+
+      case StackMapFrame::Kind::Append:
+        TRY(Read<BigEndian>(reader, frame.OffsetDelta));
+        frame.LocalsCount = frame.FrameType - 251;
+        break;
+
+      case StackMapFrame::Kind::Full:
+        TRY(Read<BigEndian>(reader, frame.OffsetDelta, frame.LocalsCount));
+        TRY(readVerificationTypes(reader, attr.Types, frame.LocalsCount));
+        TRY(Read<BigEndian>(reader, frame.StackCount));
+        TRY(readVerificationTypes(reader, attr.Types, frame.StackCount));
+
+        attr.Frames.push_back(frame);
+        continue;
+    }
+
+    TRY(readVerificationTypes(reader, attr.Types, frame.LocalsCount + frame.StackCount));
+    attr.Frames.push_back(frame);
+  }
+
   return {};
 }
 
-static ErrorOr<void> readAttribute(std::istream& stream, 
-    const ConstantPool& constPool, SourceFileAttribute& attr)
+//A U16 count followed by that many entries
+template <typename T>
+static ErrorOr<void> readTable(ByteReader& reader, std::vector<T>& table)
 {
-  TRY(Read<BigEndian>(stream, attr.SourceFileIndex));
+  U16 count{};
+  TRY(Read<BigEndian>(reader, count));
+  TRY(ReadArray<BigEndian>(reader, table, count));
   return {};
 }
 
-static ErrorOr<void> readAttribute(std::istream& stream, 
-    const ConstantPool& constPool, CodeAttribute& attr)
+//Appends count indices to the flat index list of an attribute
+static ErrorOr<void> appendIndices(ByteReader& reader, std::vector<U16>& indices, U16 count)
 {
-  U32 codeLen;
-  TRY(Read<BigEndian>(stream, 
-                      attr.MaxStack,
-                      attr.MaxLocals,
-                      codeLen));
+  if (!reader.CanRead(count * sizeof(U16)))
+    return ReadOutOfBoundsError(reader, count * sizeof(U16));
 
+  size_t begin = indices.size();
+  indices.resize(begin + count);
 
-  U32 parsedCodeLen{0};
-  while(parsedCodeLen < codeLen)
-  {
-    auto streampos_before = stream.tellg();
+  return ReadArray<BigEndian>(reader, std::span{indices}.subspan(begin));
+}
 
-    auto errOrInstr = ClassFileParser::ParseInstruction(stream);
-    VERIFY(errOrInstr);
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, BootstrapMethodsAttribute& attr)
+{
+  U16 methodCount{};
+  TRY(Read<BigEndian>(reader, methodCount));
 
-    attr.Code.emplace_back( std::move(errOrInstr.Release()) );
+  attr.Methods.reserve(methodCount);
 
-    auto parsed = stream.tellg() - streampos_before;
-    assert(parsed > 0);
+  for (auto i = 0; i < methodCount; i++)
+  {
+    BootstrapMethod method{};
+    TRY(Read<BigEndian>(reader, method.MethodRef, method.ArgumentCount));
+
+    method.ArgumentsBegin = static_cast<U32>(attr.Arguments.size());
+    TRY(appendIndices(reader, attr.Arguments, method.ArgumentCount));
 
-    parsedCodeLen += parsed;
+    attr.Methods.push_back(method);
   }
 
-  if(parsedCodeLen != codeLen)
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, NestHostAttribute& attr)
+{
+  TRY(Read<BigEndian>(reader, attr.HostClassIndex));
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, NestMembersAttribute& attr)
+{
+  return readTable(reader, attr.Classes);
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, PermittedSubclassesAttribute& attr)
+{
+  return readTable(reader, attr.Classes);
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, ExceptionsAttribute& attr)
+{
+  return readTable(reader, attr.ExceptionIndexTable);
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, InnerClassesAttribute& attr)
+{
+  return readTable(reader, attr.Classes);
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, EnclosingMethodAttribute& attr)
+{
+  TRY(Read<BigEndian>(reader, attr.ClassIndex, attr.MethodIndex));
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader&, 
+    const ConstantPool&, const ParseOptions&, SyntheticAttribute&)
+{
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, SignatureAttribute& attr)
+{
+  TRY(Read<BigEndian>(reader, attr.SignatureIndex));
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool& constPool, const ParseOptions& options, RecordAttribute& attr)
+{
+  U16 componentCount{};
+  TRY(Read<BigEndian>(reader, componentCount));
+
+  attr.Components.resize(componentCount);
+
+  for (auto& component : attr.Components)
   {
-    return Error::FromFormatStr("Failed parsing code attribute. \"CodeLen\" field parsed as %u but actual parsed codelen is at least %u bytes", static_cast<size_t>(codeLen), static_cast<size_t>(parsedCodeLen));
+    U16 attributesCount{};
+    TRY(Read<BigEndian>(reader, component.NameIndex, component.DescriptorIndex, attributesCount));
+
+    component.Attributes.reserve(attributesCount);
+    for (auto i = 0; i < attributesCount; i++)
+    {
+      auto errOrAttr = ClassFileParser::ParseAttribute(reader, constPool, options);
+      VERIFY(errOrAttr);
+
+      component.Attributes.emplace_back( errOrAttr.Release() );
+    }
   }
 
-  //TODO: create a read util function for these sorts of 
-  //      "read length, then read array of that length" scenarios
-  U16 exceptionTableLen;
-  TRY(Read<BigEndian>(stream, exceptionTableLen));
+  return {};
+}
 
-  attr.ExceptionTable.reserve(exceptionTableLen);
-  for(auto i = 0; i < exceptionTableLen; i++)
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, LineNumberTableAttribute& attr)
+{
+  return readTable(reader, attr.LineNumbers);
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, LocalVariableTableAttribute& attr)
+{
+  return readTable(reader, attr.LocalVariables);
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, LocalVariableTypeTableAttribute& attr)
+{
+  return readTable(reader, attr.LocalVariableTypes);
+}
+
+static ErrorOr<void> readAttribute(ByteReader&, 
+    const ConstantPool&, const ParseOptions&, DeprecatedAttribute&)
+{
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, MethodParametersAttribute& attr)
+{
+  U8 parameterCount{};
+  TRY(Read<BigEndian>(reader, parameterCount));
+  TRY(ReadArray<BigEndian>(reader, attr.Parameters, parameterCount));
+  return {};
+}
+
+//exports & opens
+static ErrorOr<void> readModulePackages(ByteReader& reader, std::vector<ModulePackage>& packages, std::vector<U16>& indices)
+{
+  U16 count{};
+  TRY(Read<BigEndian>(reader, count));
+
+  packages.reserve(count);
+
+  for (auto i = 0; i < count; i++)
   {
-    CodeAttribute::ExceptionHandler handler;
-    TRY(Read<BigEndian>(stream, handler.StartPC, 
-                                handler.EndPC, 
-                                handler.HandlerPC, 
-                                handler.CatchType));
+    ModulePackage package{};
+    TRY(Read<BigEndian>(reader, package.Index, package.Flags, package.ToCount));
+
+    package.ToBegin = static_cast<U32>(indices.size());
+    TRY(appendIndices(reader, indices, package.ToCount));
 
-    attr.ExceptionTable.emplace_back(handler);
+    packages.push_back(package);
   }
 
-  U16 attributesCount;
-  TRY(Read<BigEndian>(stream, attributesCount));
+  return {};
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, ModuleAttribute& attr)
+{
+  TRY(Read<BigEndian>(reader, attr.ModuleNameIndex, attr.ModuleFlags, attr.ModuleVersionIndex));
 
-  attr.Attributes.reserve(attributesCount);
-  for(auto i = 0; i < attributesCount; i++)
+  TRY(readTable(reader, attr.Requires));
+  TRY(readModulePackages(reader, attr.Exports, attr.Indices));
+  TRY(readModulePackages(reader, attr.Opens, attr.Indices));
+  TRY(readTable(reader, attr.Uses));
+
+  U16 providesCount{};
+  TRY(Read<BigEndian>(reader, providesCount));
+
+  attr.Provides.reserve(providesCount);
+
+  for (auto i = 0; i < providesCount; i++)
   {
-    auto errOrAttr = ClassFileParser::ParseAttribute(stream, constPool);
-    VERIFY(errOrAttr);
+    ModuleProvides provides{};
+    TRY(Read<BigEndian>(reader, provides.Index, provides.WithCount));
+
+    provides.WithBegin = static_cast<U32>(attr.Indices.size());
+    TRY(appendIndices(reader, attr.Indices, provides.WithCount));
 
-    attr.Attributes.emplace_back( errOrAttr.Release() );
+    attr.Provides.push_back(provides);
   }
 
   return {};
 }
 
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, ModulePackagesAttribute& attr)
+{
+  return readTable(reader, attr.PackageIndex);
+}
+
+static ErrorOr<void> readAttribute(ByteReader& reader, 
+    const ConstantPool&, const ParseOptions&, ModuleMainClassAttribute& attr)
+{
+  TRY(Read<BigEndian>(reader, attr.MainClassIndex));
+  return {};
+}
+
 template <typename AttributeT>
-static ErrorOr< std::unique_ptr<AttributeInfo> > parseAttributeT(
-    std::istream& stream, const ConstantPool& constPool, U16 nameIndex, U32 len)
+static ErrorOr< ArenaPtr<AttributeInfo> > parseAttributeT(ByteReader& reader, 
+    const ConstantPool& constPool, const ParseOptions& options, U16 nameIndex, U32 len)
 {
-  AttributeT* attr = new AttributeT();
+  ArenaPtr<AttributeT> attr = allocate<AttributeT>(options);
   attr->NameIndex = nameIndex;
 
-  auto err = readAttribute(stream, constPool, *attr);
+  size_t start = reader.Tell();
+
+  auto err = readAttribute(reader, constPool, options, *attr);
   VERIFY(err);
 
-  U32 attrLen = attr->GetLength();
+  //the consumed bytes rather than GetLength(), which differs once nested
+  //attributes were skipped (see ParseOptions)
+  size_t attrLen = reader.Tell() - start;
   if(attrLen != len)
   {
     return Error::FromFormatStr("Parsed attribute type \"%.*s\"" 
-        " doesnt have the correct length (expected: %u, actual: %u)", 
+        " doesnt have the correct length (expected: %u, actual: %zu)", 
         static_cast<int>(attr->GetName().size()), attr->GetName().data(), 
         len, attrLen);
   }
 
-  return std::unique_ptr<AttributeInfo>(attr);
+  return ArenaPtr<AttributeInfo>(std::move(attr));
 }
 
-ErrorOr< std::unique_ptr<AttributeInfo> > ClassFileParser::ParseAttribute(
-    std::istream& stream, const ConstantPool& constPool)
+//The annotation attributes keep their body, validated once here so the
+//cursors reading it don't have to check bounds
+template <typename AttributeT>
+static ErrorOr< ArenaPtr<AttributeInfo> > parseAnnotationsT(ByteReader& reader, const ParseOptions& options, 
+    U16 nameIndex, U32 len, ErrorOr<void> (*validate)(std::span<const U8>))
 {
-  U16 nameIndex;
-  U32 len;
-  TRY(Read<BigEndian>(stream, nameIndex, len));
+  std::span<const U8> body;
+  TRY(ReadBytes(reader, len, body));
+  TRY(validate(body));
 
-  auto nameStr = constPool.GetConstNameOrTypeStr(nameIndex);
+  ArenaPtr<AttributeT> attr = allocate<AttributeT>(options);
+  attr->NameIndex = nameIndex;
 
-  auto errOrType = AttributeInfo::GetType(nameStr);
+  if (options.ZeroCopyStrings)
+    attr->Bytes.SetView(body);
+  else if (options.TargetArena != nullptr)
+    attr->Bytes.SetView(options.TargetArena->CopyBytes(body));
+  else
+    attr->Bytes.Set({ body.begin(), body.end() });
+
+  return ArenaPtr<AttributeInfo>(std::move(attr));
+}
+
+//The names were classified when they were added to the pool. Unknown 
+//attributes (and names that aren't UTF8 constants) are kept as raw bytes, 
+//which isn't an error.
+AttributeInfo::Type ClassFileParser::GetAttributeType(const ConstantPool& constPool, U16 nameIndex)
+{
+  if (!constPool.Is(nameIndex, CPInfo::Type::UTF8))
+    return AttributeInfo::Type::Raw;
+
+  return static_cast<AttributeInfo::Type>(constPool.GetAttributeType(nameIndex));
+}
+
+ErrorOr<void> ClassFileParser::ParseAttributes(ByteReader& reader, const ConstantPool& constPool, 
+    AttributeMask skip, std::vector< ArenaPtr<AttributeInfo> >& attributes, const ParseOptions& options)
+{
+  U16 attributesCount{};
+  TRY(Read<BigEndian>(reader, attributesCount));
 
-  AttributeInfo::Type type;
-  if (errOrType.IsError())
+  attributes.reserve(attributesCount);
+  for (auto i = 0; i < attributesCount; i++)
   {
-    std::cerr << errOrType.GetError().GetMessage() << '\n';
-    type = AttributeInfo::Type::Raw;
+    if (skip != 0)
+    {
+      size_t start = reader.Tell();
+
+      U16 nameIndex{};
+      U32 len{};
+      TRY(Read<BigEndian>(reader, nameIndex, len));
+
+      if (HasAttributeType(skip, ClassFileParser::GetAttributeType(constPool, nameIndex)))
+      {
+        TRY(Skip(reader, len));
+        continue;
+      }
+
+      reader.Seek(start);
+    }
+
+    auto errOrAttr = ClassFileParser::ParseAttribute(reader, constPool, options);
+    VERIFY(errOrAttr);
+
+    attributes.emplace_back(errOrAttr.Release());
+  }
+
+  return {};
+}
+
+ErrorOr< ArenaPtr<AttributeInfo> > ClassFileParser::ParseAttribute(
+    ByteReader& reader, const ConstantPool& constPool, const ParseOptions& options)
+{
+  size_t start = reader.Tell();
+
+  U16 nameIndex{};
+  U32 len{};
+  TRY(Read<BigEndian>(reader, nameIndex, len));
+
+  ArenaPtr<AttributeInfo> attr;
+
+  if (options.LazyAttributes)
+  {
+    std::span<const U8> body;
+    TRY(ReadBytes(reader, len, body));
+
+    attr = allocate<LazyAttribute>(options, ClassFileParser::GetAttributeType(constPool, nameIndex), body);
+    attr->NameIndex = nameIndex;
   }
   else
-    type = errOrType.Get();
+  {
+    auto errOrAttr = ClassFileParser::ParseAttributeBody(reader, constPool, nameIndex, len, options);
+    VERIFY(errOrAttr);
+
+    attr = errOrAttr.Release();
+  }
+
+  //a Code attribute with skipped attributes doesn't match its bytes
+  if (options.KeepOriginalBytes && (options.SkipCodeAttributes == 0 || attr->GetType() != AttributeInfo::Type::Code))
+    attr->OriginalBytes = reader.GetBytes().subspan(start, reader.Tell() - start);
+
+  return attr;
+}
+
+ErrorOr< ArenaPtr<AttributeInfo> > ClassFileParser::ParseAttributeBody(ByteReader& reader, 
+    const ConstantPool& constPool, U16 nameIndex, U32 len, const ParseOptions& options)
+{
+  AttributeInfo::Type type = ClassFileParser::GetAttributeType(constPool, nameIndex);
 
   switch (type)
   {
     case AttributeInfo::Type::ConstantValue: 
-      return parseAttributeT<ConstantValueAttribute>(stream, constPool, nameIndex, len);
+      return parseAttributeT<ConstantValueAttribute>(reader, constPool, options, nameIndex, len);
     case AttributeInfo::Type::SourceFile: 
-      return parseAttributeT<SourceFileAttribute>(stream, constPool, nameIndex, len);
+      return parseAttributeT<SourceFileAttribute>(reader, constPool, options, nameIndex, len);
     case AttributeInfo::Type::Code: 
-      return parseAttributeT<CodeAttribute>(stream, constPool, nameIndex, len);
+      return parseAttributeT<CodeAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::StackMapTable: 
+      return parseAttributeT<StackMapTableAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::BootstrapMethods: 
+      return parseAttributeT<BootstrapMethodsAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::NestHost: 
+      return parseAttributeT<NestHostAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::NestMembers: 
+      return parseAttributeT<NestMembersAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::PermittedSubclasses: 
+      return parseAttributeT<PermittedSubclassesAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::Exceptions: 
+      return parseAttributeT<ExceptionsAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::InnerClasses: 
+      return parseAttributeT<InnerClassesAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::EnclosingMethod: 
+      return parseAttributeT<EnclosingMethodAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::Synthetic: 
+      return parseAttributeT<SyntheticAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::Signature: 
+      return parseAttributeT<SignatureAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::Record: 
+      return parseAttributeT<RecordAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::LineNumberTable: 
+      return parseAttributeT<LineNumberTableAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::LocalVariableTable: 
+      return parseAttributeT<LocalVariableTableAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::LocalVariableTypeTable: 
+      return parseAttributeT<LocalVariableTypeTableAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::Deprecated: 
+      return parseAttributeT<DeprecatedAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::MethodParameters: 
+      return parseAttributeT<MethodParametersAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::Module: 
+      return parseAttributeT<ModuleAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::ModulePackages: 
+      return parseAttributeT<ModulePackagesAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::ModuleMainClass: 
+      return parseAttributeT<ModuleMainClassAttribute>(reader, constPool, options, nameIndex, len);
+    case AttributeInfo::Type::RuntimeVisibleAnnotations: 
+      return parseAnnotationsT<RuntimeVisibleAnnotationsAttribute>(reader, options, nameIndex, len, ValidateAnnotations);
+    case AttributeInfo::Type::RuntimeInvisibleAnnotations: 
+      return parseAnnotationsT<RuntimeInvisibleAnnotationsAttribute>(reader, options, nameIndex, len, ValidateAnnotations);
+    case AttributeInfo::Type::RuntimeVisibleParameterAnnotations: 
+      return parseAnnotationsT<RuntimeVisibleParameterAnnotationsAttribute>(reader, options, nameIndex, len, ValidateParameterAnnotations);
+    case AttributeInfo::Type::RuntimeInvisibleParameterAnnotations: 
+      return parseAnnotationsT<RuntimeInvisibleParameterAnnotationsAttribute>(reader, options, nameIndex, len, ValidateParameterAnnotations);
+    case AttributeInfo::Type::AnnotationDefault: 
+      return parseAnnotationsT<AnnotationDefaultAttribute>(reader, options, nameIndex, len, ValidateElementValue);
+
+    //unknown names, kept as their bytes below. Lazy is never the type of a
+    //name.
+    case AttributeInfo::Type::Raw:
+    case AttributeInfo::Type::Lazy:
+      break;
   }
 
-  RawAttribute* attr = new RawAttribute{};
+  auto attr = allocate<RawAttribute>(options);
   attr->NameIndex = nameIndex;
 
-  //TODO: add ReadArray<> to util
-  attr->Bytes.reserve(len);
-  for (unsigned i = 0; i < len; i++)
-  {
-    U8 byte;
-    TRY(Read(stream, byte));
-
-    attr->Bytes.emplace_back(byte);
-  }
-
-  return std::unique_ptr<AttributeInfo>(attr);
-}
-
-
-/*
-static ErrorOr<Instruction> readInstrWithOperands(std::istream& stream, size_t nOperands, U8 opCode)
-{
-  Instruction instr{opCode};
-
-  for(size_t i = 0; i < nOperands; i++)
-  {
-    U8 operandByte;
-    TRY(Read<BigEndian>(stream, operandByte));
-
-    instr.OperandBytes.emplace_back(operandByte);
-  }
-
-  return std::move(instr);
-}
-*/
-
-ErrorOr<Instruction> ClassFileParser::ParseInstruction(std::istream& stream)
-{
-  return Error::FromLiteralStr("PARSE ISNTRUCTION NOT IMPL");
-  /*
-  U8 opCode;
-  TRY(Read<BigEndian>(stream, opCode));
-
-  //undefined opcodes
-  if(opCode > 0xCA && opCode < 0xFE)
-    return Error::FromFormatStr("failed parsing unknown opcode: %#04x", opCode);
-
-
-  switch(opCode)
-  {
-    case LDC:
-    case ILOAD:
-    case LLOAD:
-    case FLOAD:
-    case DLOAD:
-    case ALOAD:
-    case ISTORE:
-    case LSTORE:
-    case FSTORE:
-    case DSTORE:
-    case ASTORE:
-    case RET:
-    case BIPUSH:
-    case NEWARRAY:
-        return std::move( readInstrWithOperands(stream, 1, opCode) );
-
-    case LDC_W:
-    case LDC2_W:
-    case GETSTATIC:
-    case PUTSTATIC:
-    case GETFIELD:
-    case PUTFIELD:
-    case INVOKEVIRTUAL:
-    case INVOKESPECIAL:
-    case INVOKESTATIC:
-    case NEW:
-    case ANEWARRAY:
-    case CHECKCAST:
-    case INSTANCEOF:
-    case IINC:
-    case SIPUSH:
-    case IFEQ:
-    case IFNE:
-    case IFLT:
-    case IFGE:
-    case IFGT:
-    case IFLE:
-    case IF_ICMPEQ:
-    case IF_ICMPNE:
-    case IF_ICMPLT:
-    case IF_ICMPGE:
-    case IF_ICMPGT:
-    case IF_ICMPLE:
-    case IF_ACMPEQ:
-    case IF_ACMPNE:
-    case GOTO:
-    case JSR:
-    case IFNULL:
-    case IFNONNULL:
-        return std::move( readInstrWithOperands(stream, 2, opCode) );
-
-    case MULTIANEWARRAY:
-        return std::move( readInstrWithOperands(stream, 3, opCode) );
-
-    case INVOKEINTERFACE:
-    case INVOKEDYNAMIC:
-    case GOTO_W:
-    case JSR_W:
-        return std::move( readInstrWithOperands(stream, 4, opCode) );
-
-    case WIDE: 
-    case LOOKUPSWITCH: 
-    case TABLESWITCH: 
-        return Error::FromLiteralStr("ENCOUNTERED UNIMPLEMENTED OPCODE OPERAND FORMAT");
+  TRY(ReadArray(reader, attr->Bytes, len));
+
+  return ArenaPtr<AttributeInfo>(std::move(attr));
+}
+
+
+ErrorOr< std::vector< ArenaPtr<Instruction> > > ClassFileParser::ParseCode(ByteReader& reader, 
+    U32 codeLength, const ParseOptions& options)
+{
+  std::span<const U8> code;
+  TRY(ReadBytes(reader, codeLength, code));
+
+  //the offsets of the instructions are relative to the start of the code
+  ByteReader codeReader{code};
+
+  std::vector< ArenaPtr<Instruction> > instructions;
+
+  //most instructions are 1 - 3 bytes long
+  instructions.reserve(codeLength / 2);
+
+  while (codeReader.Remaining() > 0)
+  {
+    auto errOrInstr = ClassFileParser::ParseInstruction(codeReader, 
+        static_cast<U32>(codeReader.Tell()), options);
+    VERIFY(errOrInstr);
+
+    instructions.emplace_back(errOrInstr.Release());
+  }
+
+  return instructions;
+}
+
+using InstrOrError = ErrorOr< ArenaPtr<Instruction> >;
+
+template <typename InstrT, typename... Args>
+static InstrOrError makeInstr(const ParseOptions& options, Args&&... args)
+{
+  return ArenaPtr<Instruction>( allocate<InstrT>(options, std::forward<Args>(args)...) );
+}
+
+static InstrOrError readTableSwitch(ByteReader& reader, U32 codeOffset, const ParseOptions& options)
+{
+  U32 padding = GetSwitchPadding(codeOffset);
+  if (!reader.CanRead(padding))
+    return ReadOutOfBoundsError(reader, padding);
+
+  reader.Advance(padding);
+
+  S32 def{}, low{}, high{};
+  TRY(Read<BigEndian>(reader, def, low, high));
+
+  if (high < low)
+    return Error::FromFormatStr("TABLESWITCH at code offset %u has high (%d) < low (%d)", codeOffset, high, low);
+
+  S64 count = static_cast<S64>(high) - low + 1;
+
+  //checked before allocating, so corrupt counts can't cause huge allocations
+  if (static_cast<U64>(count) * sizeof(S32) > reader.Remaining())
+    return ReadOutOfBoundsError(reader, static_cast<U64>(count) * sizeof(S32));
+
+  std::vector<S32> offsets;
+  TRY(ReadArray<BigEndian>(reader, offsets, static_cast<size_t>(count)));
+
+  return makeInstr<TABLESWITCH>(options, def, low, std::move(offsets));
+}
+
+static InstrOrError readLookupSwitch(ByteReader& reader, U32 codeOffset, const ParseOptions& options)
+{
+  U32 padding = GetSwitchPadding(codeOffset);
+  if (!reader.CanRead(padding))
+    return ReadOutOfBoundsError(reader, padding);
+
+  reader.Advance(padding);
+
+  S32 def{}, nPairs{};
+  TRY(Read<BigEndian>(reader, def, nPairs));
+
+  if (nPairs < 0)
+    return Error::FromFormatStr("LOOKUPSWITCH at code offset %u has a negative pair count (%d)", codeOffset, nPairs);
+
+  U64 pairsSize = static_cast<U64>(nPairs) * 2 * sizeof(S32);
+  if (pairsSize > reader.Remaining())
+    return ReadOutOfBoundsError(reader, pairsSize);
+
+  std::vector<S32> pairs;
+  TRY(ReadArray<BigEndian>(reader, pairs, static_cast<size_t>(nPairs) * 2));
+
+  return makeInstr<LOOKUPSWITCH>(options, def, std::move(pairs));
+}
+
+static InstrOrError readWide(ByteReader& reader, U32 codeOffset, const ParseOptions& options)
+{
+  U8 opCode{};
+  U16 index{};
+  TRY(Read<BigEndian>(reader, opCode, index));
+
+  switch (opCode)
+  {
+    case OP_IINC:
+    {
+      U16 cnst{};
+      TRY(Read<BigEndian>(reader, cnst));
+      return makeInstr<WIDE_IINC>(options, index, cnst);
+    }
+
+    case OP_ILOAD:  case OP_LLOAD:  case OP_FLOAD:  case OP_DLOAD:  case OP_ALOAD:
+    case OP_ISTORE: case OP_LSTORE: case OP_FSTORE: case OP_DSTORE: case OP_ASTORE:
+    case OP_RET:
+      return makeInstr<WIDE>(options, opCode, index);
+  }
+
+  return Error::FromFormatStr("WIDE at code offset %u modifies opcode %#04x, which can't be widened", codeOffset, opCode);
+}
+
+//Decodes the operands of the instruction with the given opcode, the opcode
+//itself has already been consumed. One instantiation per opcode, so the 
+//operand layout and instruction type are resolved at compile time.
+template <U8 OPCODE>
+static InstrOrError decodeInstr(ByteReader& reader, U32 codeOffset, const ParseOptions& options)
+{
+  constexpr OperandLayout layout = OpCodeInfoTable[OPCODE].Layout;
+
+  if constexpr (layout == OperandLayout::None)
+  {
+    return makeInstr< NoArgInstruction<OPCODE> >(options);
+  }
+  else if constexpr (layout == OperandLayout::UByte || layout == OperandLayout::SByte ||
+                     layout == OperandLayout::UShort || layout == OperandLayout::SShort ||
+                     layout == OperandLayout::SInt || layout == OperandLayout::AType)
+  {
+    using OperandT = 
+      std::conditional_t<layout == OperandLayout::UByte,  U8,
+      std::conditional_t<layout == OperandLayout::SByte,  S8,
+      std::conditional_t<layout == OperandLayout::UShort, U16,
+      std::conditional_t<layout == OperandLayout::SShort, S16,
+      std::conditional_t<layout == OperandLayout::SInt,   S32, AType>>>>>;
+
+    OperandT operand{};
+    TRY(Read<BigEndian>(reader, operand));
+
+    return makeInstr< OneArgInstruction<OPCODE, OperandT> >(options, operand);
+  }
+  else if constexpr (layout == OperandLayout::IInc)
+  {
+    U8 index{};
+    S8 cnst{};
+    TRY(Read<BigEndian>(reader, index, cnst));
+
+    return makeInstr<IINC>(options, index, cnst);
+  }
+  else if constexpr (layout == OperandLayout::MultiANewArray)
+  {
+    U16 index{};
+    U8 dimensions{};
+    TRY(Read<BigEndian>(reader, index, dimensions));
+
+    return makeInstr<MULTIANEWARRAY>(options, index, dimensions);
+  }
+  else if constexpr (layout == OperandLayout::InvokeInterface)
+  {
+    U16 index{};
+    U8 count{}, zero{};
+    TRY(Read<BigEndian>(reader, index, count, zero));
+
+    return makeInstr<INVOKEINTERFACE>(options, index, count);
+  }
+  else if constexpr (layout == OperandLayout::InvokeDynamic)
+  {
+    U16 index{}, zero{};
+    TRY(Read<BigEndian>(reader, index, zero));
+
+    return makeInstr<INVOKEDYNAMIC>(options, index);
+  }
+  else if constexpr (layout == OperandLayout::TableSwitch)
+  {
+    return readTableSwitch(reader, codeOffset, options);
+  }
+  else if constexpr (layout == OperandLayout::LookupSwitch)
+  {
+    return readLookupSwitch(reader, codeOffset, options);
+  }
+  else if constexpr (layout == OperandLayout::Wide)
+  {
+    return readWide(reader, codeOffset, options);
+  }
+  else
+  {
+    return Error::FromFormatStr("failed parsing unknown opcode %#04x at code offset %u", OPCODE, codeOffset);
+  }
+}
+
+using DecodeInstrFn = InstrOrError (*)(ByteReader&, U32, const ParseOptions&);
+
+template <size_t... OPCODES>
+static constexpr std::array<DecodeInstrFn, 256> makeDecodeTable(std::index_sequence<OPCODES...>)
+{
+  return { &decodeInstr<static_cast<U8>(OPCODES)>... };
+}
+
+static constexpr std::array<DecodeInstrFn, 256> decodeTable = makeDecodeTable(std::make_index_sequence<256>{});
 
+ErrorOr< ArenaPtr<Instruction> > ClassFileParser::ParseInstruction(ByteReader& reader, 
+    U32 codeOffset, const ParseOptions& options)
+{
+  U8 opCode{};
+  TRY(Read<BigEndian>(reader, opCode));
+
+  return decodeTable[opCode](reader, codeOffset, options);
+}
+
+
+//Buffers the remainder of the stream, runs the given ByteReader based parse 
+//function over it and seeks the stream to just after the consumed bytes.
+template <typename ParseFuncT>
+static auto parseFromStream(std::istream& stream, ParseFuncT parseFunc)
+{
+  auto start = stream.tellg();
+
+  std::vector<U8> bytes{ std::istreambuf_iterator<char>{stream}, 
+                         std::istreambuf_iterator<char>{} };
+
+  ByteReader reader{bytes};
+  auto result = parseFunc(reader);
+
+  if (start != std::istream::pos_type(-1))
+  {
+    stream.clear();
+    stream.seekg(start + static_cast<std::streamoff>(reader.Tell()));
+  }
+
+  return result;
+}
+
+//The adapters of the structures within a class file don't buffer the rest of
+//the stream, but read exactly the bytes of the structure: a fixed size part
+//first, followed by what its lengths & counts say comes after it. The bytes
+//are then parsed with a ByteReader.
+
+//Appends the next n bytes of the stream to bytes. Large reads are done in
+//chunks, so a corrupt length can't cause a huge allocation before the stream
+//runs out.
+static ErrorOr<void> readChunk(std::istream& stream, std::vector<U8>& bytes, size_t n)
+{
+  constexpr size_t MaxChunkSize = 64 * 1024;
+
+  while (n > 0)
+  {
+    size_t chunkSize = std::min(n, MaxChunkSize);
+    size_t offset = bytes.size();
+
+    bytes.resize(offset + chunkSize);
+    stream.read(reinterpret_cast<char*>(bytes.data() + offset), chunkSize);
+
+    if (static_cast<size_t>(stream.gcount()) != chunkSize)
+      return Error::FromFormatStr("Tried to read %zu bytes from the stream, but it ended after %zu", 
+          chunkSize, static_cast<size_t>(stream.gcount()));
+
+    n -= chunkSize;
+  }
+
+  return {};
+}
+
+static ErrorOr<void> readConstantBytes(std::istream& stream, std::vector<U8>& bytes)
+{
+  size_t start = bytes.size();
+  TRY(readChunk(stream, bytes, 1));
+
+  switch (static_cast<CPInfo::Type>(bytes[start]))
+  {
+    case CPInfo::Type::Class:
+    case CPInfo::Type::String:
+    case CPInfo::Type::MethodType:
+      return readChunk(stream, bytes, 2);
+
+    case CPInfo::Type::MethodHandle:
+      return readChunk(stream, bytes, 3);
+
+    case CPInfo::Type::Fieldref:
+    case CPInfo::Type::Methodref:
+    case CPInfo::Type::InterfaceMethodref:
+    case CPInfo::Type::NameAndType:
+    case CPInfo::Type::InvokeDynamic:
+    case CPInfo::Type::Integer:
+    case CPInfo::Type::Float:
+      return readChunk(stream, bytes, 4);
+
+    case CPInfo::Type::Long:
+    case CPInfo::Type::Double:
+      return readChunk(stream, bytes, 8);
+
+    case CPInfo::Type::UTF8:
+      TRY(readChunk(stream, bytes, 2));
+      return readChunk(stream, bytes, LoadBigEndian<U16>(bytes.data() + start + 1));
+
+    //the parser reports the unknown tag
+    case CPInfo::Type::Unusable:
+      break;
+  }
+
+  return {};
+}
+
+static ErrorOr<void> readAttributeBytes(std::istream& stream, std::vector<U8>& bytes)
+{
+  size_t start = bytes.size();
+
+  //U16 name index, U32 length
+  TRY(readChunk(stream, bytes, 6));
+  return readChunk(stream, bytes, LoadBigEndian<U32>(bytes.data() + start + 2));
+}
+
+static ErrorOr<void> readInstructionBytes(std::istream& stream, std::vector<U8>& bytes, U32 codeOffset)
+{
+  TRY(readChunk(stream, bytes, 1));
+
+  U8 opCode = bytes[0];
+  const OpCodeInfo& info = GetOpCodeInfo(opCode);
+
+  switch (info.Layout)
+  {
+    case OperandLayout::TableSwitch:
+    {
+      //padding, S32 default, low & high
+      U32 padding = GetSwitchPadding(codeOffset);
+      TRY(readChunk(stream, bytes, padding + 12));
+
+      S64 low = LoadBigEndian<S32>(bytes.data() + 1 + padding + 4);
+      S64 high = LoadBigEndian<S32>(bytes.data() + 1 + padding + 8);
+
+      //the parser reports high < low
+      if (high < low)
+        return {};
+
+      return readChunk(stream, bytes, static_cast<size_t>(high - low + 1) * sizeof(S32));
+    }
+
+    case OperandLayout::LookupSwitch:
+    {
+      //padding, S32 default & npairs
+      U32 padding = GetSwitchPadding(codeOffset);
+      TRY(readChunk(stream, bytes, padding + 8));
+
+      S32 nPairs = LoadBigEndian<S32>(bytes.data() + 1 + padding + 4);
+
+      //the parser reports negative counts
+      if (nPairs < 0)
+        return {};
+
+      return readChunk(stream, bytes, static_cast<size_t>(nPairs) * 2 * sizeof(S32));
+    }
+
+    case OperandLayout::Wide:
+    {
+      TRY(readChunk(stream, bytes, 1));
+
+      //U16 index (IINC: and S16 const)
+      return readChunk(stream, bytes, bytes[1] == OP_IINC ? 4 : 2);
+    }
+
+    default:
+      return readChunk(stream, bytes, GetOperandLength(info.Layout));
+  }
+}
+
+//Parses bytes read by the given read function
+template <typename ReadFuncT, typename ParseFuncT>
+static auto parseFromChunks(std::istream& stream, ReadFuncT readFunc, ParseFuncT parseFunc) 
+  -> decltype(parseFunc(std::declval<ByteReader&>()))
+{
+  std::vector<U8> bytes;
+  TRY(readFunc(stream, bytes));
+
+  ByteReader reader{bytes};
+  return parseFunc(reader);
+}
+
+ErrorOr<ClassFile> ClassFileParser::ParseClassFile(std::istream& stream)
+{
+  return parseFromStream(stream, [](ByteReader& reader) { 
+      return ClassFileParser::ParseClassFile(reader); 
+  });
+}
+
+ErrorOr<ConstantPool> ClassFileParser::ParseConstantPool(std::istream& stream)
+{
+  auto readPool = [](std::istream& stream, std::vector<U8>& bytes) -> ErrorOr<void>
+  {
+    TRY(readChunk(stream, bytes, 2));
+
+    //count = number of constants + 1
+    U16 count = LoadBigEndian<U16>(bytes.data());
+
+    for (U16 i = 1; i < count; i++)
+    {
+      size_t start = bytes.size();
+      TRY(readConstantBytes(stream, bytes));
+
+      auto type = static_cast<CPInfo::Type>(bytes[start]);
+      if (type == CPInfo::Type::Long || type == CPInfo::Type::Double)
+        i++;
+    }
+
+    return {};
+  };
+
+  return parseFromChunks(stream, readPool, [](ByteReader& reader) { 
+      return ClassFileParser::ParseConstantPool(reader); 
+  });
+}
+
+ErrorOr< ArenaPtr<CPInfo> > ClassFileParser::ParseConstant(std::istream& stream)
+{
+  return parseFromChunks(stream, readConstantBytes, [](ByteReader& reader) { 
+      return ClassFileParser::ParseConstant(reader); 
+  });
+}
+
+ErrorOr<FieldMethodInfo> ClassFileParser::ParseFieldMethodInfo(
+    std::istream& stream, const ConstantPool& constPool)
+{
+  auto readInfo = [](std::istream& stream, std::vector<U8>& bytes) -> ErrorOr<void>
+  {
+    //U16 access flags, name index, descriptor index & attributes count
+    TRY(readChunk(stream, bytes, 8));
+
+    for (U16 i = 0; i < LoadBigEndian<U16>(bytes.data() + 6); i++)
+      TRY(readAttributeBytes(stream, bytes));
+
+    return {};
+  };
+
+  return parseFromChunks(stream, readInfo, [&constPool](ByteReader& reader) { 
+      return ClassFileParser::ParseFieldMethodInfo(reader, constPool); 
+  });
+}
+
+ErrorOr< ArenaPtr<AttributeInfo> > ClassFileParser::ParseAttribute(
+    std::istream& stream, const ConstantPool& constPool)
+{
+  return parseFromChunks(stream, readAttributeBytes, [&constPool](ByteReader& reader) { 
+      return ClassFileParser::ParseAttribute(reader, constPool); 
+  });
+}
+
+ErrorOr< ArenaPtr<Instruction> > ClassFileParser::ParseInstruction(std::istream& stream, U32 codeOffset)
+{
+  auto readInstruction = [codeOffset](std::istream& stream, std::vector<U8>& bytes) {
+      return readInstructionBytes(stream, bytes, codeOffset);
   };
 
-  return Instruction{opCode};
-  */
+  return parseFromChunks(stream, readInstruction, [codeOffset](ByteReader& reader) { 
+      return ClassFileParser::ParseInstruction(reader, codeOffset); 
+  });
 }
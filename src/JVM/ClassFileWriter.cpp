@@ -1,4 +1,5 @@
 #include "FileFormats/JVM/ClassFileWriter.hpp"
+#include "FileFormats/JVM/MaxsComputer.hpp"
 
 #include "Util/IO.hpp"
 #include "Util/Error.hpp"
@@ -6,141 +7,324 @@
 using namespace FileFormats;
 using namespace JVM;
 
-ErrorOr<void> ClassFileWriter::WriteClassFile(std::ostream& stream, const ClassFile& cf)
+static bool isUnmodified(const AttributeInfo& info);
+
+//Whether the attributes are still the ones parsed from the attributes_count 
+//at begin, unmodified and in the same order, i.e. their original bytes follow 
+//the count back to back. Returns the end of their bytes, nullptr otherwise.
+static const U8* findUnmodifiedEnd(const std::vector< ArenaPtr<AttributeInfo> >& attributes, const U8* begin)
+{
+  if(LoadBigEndian<U16>(begin) != attributes.size())
+    return nullptr;
+
+  const U8* next = begin + sizeof(U16);
+
+  for(const auto& pAttr : attributes)
+  {
+    if(pAttr->OriginalBytes.data() != next || !isUnmodified(*pAttr))
+      return nullptr;
+
+    next += pAttr->OriginalBytes.size();
+  }
+
+  return next;
+}
+
+//Whether the attribute can be copied from the bytes it was parsed from (see 
+//ParseOptions::KeepOriginalBytes). Attributes containing modified, added,
+//removed or reordered attributes count as modified.
+static bool isUnmodified(const AttributeInfo& info)
+{
+  const auto& bytes = info.OriginalBytes;
+
+  if(bytes.size() < AttributeInfo::GetHeaderLength() || LoadBigEndian<U16>(bytes.data()) != info.NameIndex)
+    return false;
+
+  //the bytes were parsed as this attribute, so their structure is valid
+  const U8* body = bytes.data() + AttributeInfo::GetHeaderLength();
+  const U8* end = bytes.data() + bytes.size();
+
+  switch(info.GetType())
+  {
+    case AttributeInfo::Type::Lazy:
+    {
+      const AttributeInfo* decoded = static_cast<const LazyAttribute&>(info).GetDecoded();
+      return decoded == nullptr || isUnmodified(*decoded);
+    }
+
+    case AttributeInfo::Type::Code:
+    {
+      //max_stack & max_locals, then the code and the exception table
+      const U8* attributes = body + 2 * sizeof(U16);
+      attributes += sizeof(U32) + LoadBigEndian<U32>(attributes);
+      attributes += sizeof(U16) + LoadBigEndian<U16>(attributes) * 4 * sizeof(U16);
+
+      return findUnmodifiedEnd(static_cast<const CodeAttribute&>(info).Attributes, attributes) == end;
+    }
+
+    case AttributeInfo::Type::Record:
+    {
+      const auto& components = static_cast<const RecordAttribute&>(info).Components;
+
+      if(LoadBigEndian<U16>(body) != components.size())
+        return false;
+
+      const U8* next = body + sizeof(U16);
+
+      for(const auto& component : components)
+      {
+        if(LoadBigEndian<U16>(next) != component.NameIndex
+            || LoadBigEndian<U16>(next + 2) != component.DescriptorIndex)
+          return false;
+
+        next = findUnmodifiedEnd(component.Attributes, next + 2 * sizeof(U16));
+        if(next == nullptr)
+          return false;
+      }
+
+      return next == end;
+    }
+
+    default:
+      return true;
+  }
+}
+
+//the header is compared with the parsed bytes, as it has no MarkModified()
+static bool isUnmodified(const FieldMethodInfo& info)
+{
+  const auto& bytes = info.OriginalBytes;
+
+  if(bytes.size() < 4 * sizeof(U16)
+      || LoadBigEndian<U16>(bytes.data()) != info.AccessFlags
+      || LoadBigEndian<U16>(bytes.data() + 2) != info.NameIndex
+      || LoadBigEndian<U16>(bytes.data() + 4) != info.DescriptorIndex)
+    return false;
+
+  return findUnmodifiedEnd(info.Attributes, bytes.data() + 6) == bytes.data() + bytes.size();
+}
+
+//The lengths of all attributes being written, in the order their headers get
+//written (depth first). A sizing pass computes them once before writing, so
+//nested lengths aren't recomputed for the header of every enclosing
+//attribute. They only live for one write, so changes to the model between
+//writes are always picked up.
+struct AttributeLengths
+{
+  std::vector<U32> Lengths;
+  size_t Next{0};
+
+  U32 Take()
+  {
+    assert(Next < Lengths.size());
+    return Lengths[Next++];
+  }
+};
+
+//The serialization functions are templated on the stream type so the same code
+//can write to a std::ostream or, unchecked, into an exactly sized ByteWriter.
+template <typename StreamT>
+static ErrorOr<void> writeConstantPool(StreamT& stream, const ConstantPool& cp);
+template <typename StreamT>
+static ErrorOr<void> writeConstant(StreamT& stream, const CPInfo& info);
+template <typename StreamT>
+static ErrorOr<void> writeFieldMethod(StreamT& stream, const FieldMethodInfo& info, AttributeLengths& lengths);
+template <typename StreamT>
+static ErrorOr<void> writeAttribute(StreamT& stream, const AttributeInfo& info, AttributeLengths& lengths);
+template <typename StreamT>
+static ErrorOr<void> writeAttributeBody(StreamT& stream, const AttributeInfo& info, AttributeLengths& lengths);
+
+template <typename StreamT>
+static ErrorOr<void> writeClassFile(StreamT& stream, const ClassFile& cf, AttributeLengths& lengths)
 {
   TRY(Write<BigEndian>(stream, cf.Magic,
                                cf.MinorVersion,
                                cf.MajorVersion));
 
-  TRY( ClassFileWriter::WriteConstantPool(stream, cf.ConstPool) );
+  TRY( writeConstantPool(stream, cf.ConstPool) );
 
   TRY(Write<BigEndian>(stream, cf.AccessFlags,
                                cf.ThisClass,
                                cf.SuperClass,
                                static_cast<U16>(cf.Interfaces.size())));
 
-  for(U16 interface : cf.Interfaces)
-    TRY(Write<BigEndian>(stream, interface));
+  TRY(WriteArray<BigEndian>(stream, std::span{cf.Interfaces}));
 
   TRY( Write<BigEndian>(stream, static_cast<U16>(cf.Fields.size())) );
 
   for(const auto& field : cf.Fields)
-    TRY( ClassFileWriter::WriteFieldMethod(stream, field) );
+    TRY( writeFieldMethod(stream, field, lengths) );
 
   TRY( Write<BigEndian>(stream, static_cast<U16>(cf.Methods.size())) );
 
   for(const auto& method: cf.Methods)
-    TRY( ClassFileWriter::WriteFieldMethod(stream, method) );
+    TRY( writeFieldMethod(stream, method, lengths) );
 
   TRY( Write<BigEndian>(stream, static_cast<U16>(cf.Attributes.size())) );
 
   for(const auto& pAttr: cf.Attributes)
-    TRY( ClassFileWriter::WriteAttribute(stream, *pAttr) );
+    TRY( writeAttribute(stream, *pAttr, lengths) );
 
   return {};
 }
 
-ErrorOr<void> ClassFileWriter::WriteConstantPool(std::ostream& stream, const ConstantPool& cp)
+template <typename StreamT>
+static ErrorOr<void> writeConstantPool(StreamT& stream, const ConstantPool& cp)
 {
-
   TRY(Write<BigEndian>(stream, cp.Count()));
 
-  for(auto i = 0; i < cp.Count(); i++)
+  for(U16 i = 1; i < cp.Count(); i++)
   {
-    const CPInfo* ptr = cp[i];
+    CPInfo::Type type = cp.GetType(i);
 
-    //TODO: maybe the "filler" consts shouldn't be nullptr. Instead add a 
-    //non-standard FillInfo struct
-    if(ptr == nullptr)
+    //the entries following Long & Double constants are not serialized
+    if(type == CPInfo::Type::Unusable)
       continue;
 
-    TRY(ClassFileWriter::WriteConstant(stream, *ptr));
+    TRY(Write<BigEndian>(stream, static_cast<U8>(type)));
+
+    switch(type)
+    {
+      case CPInfo::Type::Class:
+      case CPInfo::Type::String:
+      case CPInfo::Type::MethodType:
+        TRY(Write<BigEndian>(stream, cp.GetFirstIndex(i)));
+        break;
+
+      case CPInfo::Type::Fieldref:
+      case CPInfo::Type::Methodref:
+      case CPInfo::Type::InterfaceMethodref:
+      case CPInfo::Type::NameAndType:
+      case CPInfo::Type::InvokeDynamic:
+        TRY(Write<BigEndian>(stream, cp.GetFirstIndex(i), cp.GetSecondIndex(i)));
+        break;
+
+      case CPInfo::Type::MethodHandle:
+        TRY(Write<BigEndian>(stream, static_cast<U8>(cp.GetFirstIndex(i)), cp.GetSecondIndex(i)));
+        break;
+
+      case CPInfo::Type::Integer:
+      case CPInfo::Type::Float:
+        TRY(Write<BigEndian>(stream, cp.GetU32(i)));
+        break;
+
+      case CPInfo::Type::Long:
+      case CPInfo::Type::Double:
+        TRY(Write<BigEndian>(stream, static_cast<U32>(cp.GetU64(i) >> 32), static_cast<U32>(cp.GetU64(i))));
+        break;
+
+      case CPInfo::Type::UTF8:
+      {
+        std::string_view str = cp.GetUTF8(i);
+        TRY(Write<BigEndian>(stream, static_cast<U16>(str.length())));
+        TRY(WriteArray(stream, std::span{str}));
+        break;
+      }
+
+      case CPInfo::Type::Unusable:
+        break;
+    }
   }
 
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const InvokeDynamicInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const InvokeDynamicInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.BootstrapMethodAttrIndex,
                                info.NameAndTypeIndex));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const MethodTypeInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const MethodTypeInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.DescriptorIndex));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const MethodHandleInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const MethodHandleInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.ReferenceKind,
                                info.ReferenceIndex));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const UTF8Info& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const UTF8Info& info)
 {
-  TRY(Write<BigEndian>(stream, static_cast<U16>( info.String.length() )));
-  stream << info.String;
+  std::string_view str = info.Get();
+
+  TRY(Write<BigEndian>(stream, static_cast<U16>( str.length() )));
+  TRY(WriteArray(stream, std::span{str}));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const NameAndTypeInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const NameAndTypeInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.NameIndex,
                                info.DescriptorIndex));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const DoubleInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const DoubleInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.HighBytes,
                                info.LowBytes));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const LongInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const LongInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.HighBytes,
                                info.LowBytes));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const FloatInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const FloatInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.Bytes));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const IntegerInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const IntegerInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.Bytes));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const StringInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const StringInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.StringIndex));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const InterfaceMethodrefInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const InterfaceMethodrefInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.ClassIndex, 
                                info.NameAndTypeIndex));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const MethodrefInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const MethodrefInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.ClassIndex, 
                                info.NameAndTypeIndex));
   return {};
 }
 
-static ErrorOr<void> writeConst(std::ostream& stream, const FieldrefInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const FieldrefInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.ClassIndex, 
                                info.NameAndTypeIndex));
@@ -148,19 +332,21 @@ static ErrorOr<void> writeConst(std::ostream& stream, const FieldrefInfo& info)
 }
 
 
-static ErrorOr<void> writeConst(std::ostream& stream, const ClassInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConst(StreamT& stream, const ClassInfo& info)
 {
   TRY(Write<BigEndian>(stream, info.NameIndex));
   return {};
 }
 
-template <typename T>
-static ErrorOr<void> writeConstT(std::ostream& stream, const CPInfo& info)
+template <typename T, typename StreamT>
+static ErrorOr<void> writeConstT(StreamT& stream, const CPInfo& info)
 {
   return writeConst(stream, static_cast<const T&>(info));
 }
 
-ErrorOr<void> ClassFileWriter::WriteConstant(std::ostream& stream, const CPInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeConstant(StreamT& stream, const CPInfo& info)
 {
   U8 tag = static_cast<U8>(info.GetType());
   TRY(Write<BigEndian>(stream, tag));
@@ -181,100 +367,376 @@ ErrorOr<void> ClassFileWriter::WriteConstant(std::ostream& stream, const CPInfo&
     case CPInfo::Type::MethodHandle:  return writeConstT<MethodHandleInfo>(stream, info);
     case CPInfo::Type::MethodType:    return writeConstT<MethodTypeInfo>(stream, info);
     case CPInfo::Type::InvokeDynamic: return writeConstT<InvokeDynamicInfo>(stream, info);
+    case CPInfo::Type::Unusable:      break;
   }
 
   return Error::FromFormatStr("WriteConstant: write func not implemented for const with tag %hhu", tag);
 }
 
-ErrorOr<void> ClassFileWriter::WriteFieldMethod(std::ostream& stream, const FieldMethodInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeFieldMethod(StreamT& stream, const FieldMethodInfo& info, AttributeLengths& lengths)
 {
+  if(isUnmodified(info))
+    return WriteArray(stream, info.OriginalBytes);
+
   TRY( Write<BigEndian>(stream, info.AccessFlags,
                                 info.NameIndex,
                                 info.DescriptorIndex,
                                 static_cast<U16>(info.Attributes.size())) );
 
   for(const auto& pAttr : info.Attributes)
-    TRY( ClassFileWriter::WriteAttribute(stream, *pAttr) );
+    TRY( writeAttribute(stream, *pAttr, lengths) );
 
   return {};
 }
 
-static ErrorOr<void> writeAttr(std::ostream& stream, const RawAttribute& attr)
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const RawAttribute& attr)
 {
-  //TODO: add array writing IO util funcs
-  stream.write(reinterpret_cast<const char*>(attr.Bytes.data()), attr.GetLength());
-
-  if(stream.bad())
-    return Error::FromFormatStr("failed to write attribute, stream badbit set: %s in %s", __func__, __FILE__);
-
+  TRY( WriteArray(stream, std::span{attr.Bytes}) );
   return {};
 }
 
-static ErrorOr<void> writeAttr(std::ostream& stream, const SourceFileAttribute& attr)
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const SourceFileAttribute& attr)
 {
   TRY( Write<BigEndian>(stream, attr.SourceFileIndex) );
   return {};
 }
 
-static ErrorOr<void> writeAttr(std::ostream& stream, const CodeAttribute& attr)
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const CodeAttribute& attr, AttributeLengths& lengths)
 {
   TRY( Write<BigEndian>(stream, attr.MaxStack,
                                 attr.MaxLocals) );
 
-  U32 codeLen{0};
+  TRY( Write<BigEndian>(stream, attr.GetCodeLength()) );
+  TRY( WriteArray<BigEndian>(stream, attr.Code.GetBytes()) );
+
+  TRY( Write<BigEndian>(stream, static_cast<U16>(attr.ExceptionTable.size())) );
+
+  TRY( WriteArray<BigEndian>(stream, std::span{attr.ExceptionTable}) );
 
-  for(const auto& instr : attr.Code)
-    codeLen += instr.GetLength();
+  TRY( Write<BigEndian>(stream, static_cast<U16>(attr.Attributes.size())) );
 
-  TRY( Write<BigEndian>(stream, codeLen) );
+  for(const auto& pAttr : attr.Attributes)
+    TRY ( writeAttribute(stream, *pAttr, lengths) );
+
+  return {};
+}
 
-  for(const auto& instr : attr.Code)
-    ClassFileWriter::WriteInstruction(stream, instr);
+template <typename StreamT>
+static ErrorOr<void> writeVerificationType(StreamT& stream, const VerificationType& type)
+{
+  TRY( Write<BigEndian>(stream, type.TypeTag) );
 
-  if(stream.bad())
-    return Error::FromFormatStr("failed to write code attr, stream badbit set: %s in %s", __func__, __FILE__);
+  if(type.HasData())
+    TRY( Write<BigEndian>(stream, type.Data) );
 
-  TRY( Write<BigEndian>(stream, static_cast<U16>(attr.ExceptionTable.size())) );
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const StackMapTableAttribute& attr)
+{
+  TRY( Write<BigEndian>(stream, static_cast<U16>(attr.Frames.size())) );
 
-  for(auto handler : attr.ExceptionTable)
+  for(const auto& frame : attr.Frames)
   {
-    TRY( Write<BigEndian>(stream, handler.StartPC, 
-                                  handler.EndPC,
-                                  handler.HandlerPC,
-                                  handler.CatchType) );
+    TRY( Write<BigEndian>(stream, frame.FrameType) );
+
+    switch(frame.GetKind())
+    {
+      case StackMapFrame::Kind::Same:
+      case StackMapFrame::Kind::SameLocals1StackItem:
+        break;
+
+      case StackMapFrame::Kind::SameLocals1StackItemExtended:
+      case StackMapFrame::Kind::Chop:
+      case StackMapFrame::Kind::SameExtended:
+      case StackMapFrame::Kind::Append:
+        TRY( Write<BigEndian>(stream, frame.OffsetDelta) );
+        break;
+
+      case StackMapFrame::Kind::Full:
+        TRY( Write<BigEndian>(stream, frame.OffsetDelta, frame.LocalsCount) );
+        break;
+    }
+
+    for(const auto& type : attr.GetLocals(frame))
+      TRY( writeVerificationType(stream, type) );
+
+    if(frame.GetKind() == StackMapFrame::Kind::Full)
+      TRY( Write<BigEndian>(stream, frame.StackCount) );
+
+    for(const auto& type : attr.GetStack(frame))
+      TRY( writeVerificationType(stream, type) );
   }
 
-  TRY( Write<BigEndian>(stream, static_cast<U16>(attr.Attributes.size())) );
+  return {};
+}
 
-  for(const auto& pAttr : attr.Attributes)
-    TRY ( ClassFileWriter::WriteAttribute(stream, *pAttr) );
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const ConstantValueAttribute& attr)
+{
+  TRY( Write<BigEndian>(stream, attr.Index) );
+  return {};
+}
 
+//A U16 count followed by the entries
+template <typename StreamT, typename T>
+static ErrorOr<void> writeTable(StreamT& stream, const std::vector<T>& table)
+{
+  TRY( Write<BigEndian>(stream, static_cast<U16>(table.size())) );
+  TRY( WriteArray<BigEndian>(stream, std::span{table}) );
   return {};
 }
 
-static ErrorOr<void> writeAttr(std::ostream& stream, const ConstantValueAttribute& attr)
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const BootstrapMethodsAttribute& attr)
 {
-  TRY( Write<BigEndian>(stream, attr.Index) );
+  TRY( Write<BigEndian>(stream, static_cast<U16>(attr.Methods.size())) );
+
+  for(const auto& method : attr.Methods)
+  {
+    TRY( Write<BigEndian>(stream, method.MethodRef, method.ArgumentCount) );
+    TRY( WriteArray<BigEndian>(stream, attr.GetArguments(method)) );
+  }
+
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const NestHostAttribute& attr)
+{
+  TRY( Write<BigEndian>(stream, attr.HostClassIndex) );
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const NestMembersAttribute& attr)
+{
+  return writeTable(stream, attr.Classes);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const PermittedSubclassesAttribute& attr)
+{
+  return writeTable(stream, attr.Classes);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const ExceptionsAttribute& attr)
+{
+  return writeTable(stream, attr.ExceptionIndexTable);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const InnerClassesAttribute& attr)
+{
+  return writeTable(stream, attr.Classes);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const EnclosingMethodAttribute& attr)
+{
+  TRY( Write<BigEndian>(stream, attr.ClassIndex, attr.MethodIndex) );
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT&, const SyntheticAttribute&)
+{
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const SignatureAttribute& attr)
+{
+  TRY( Write<BigEndian>(stream, attr.SignatureIndex) );
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const RecordAttribute& attr, AttributeLengths& lengths)
+{
+  TRY( Write<BigEndian>(stream, static_cast<U16>(attr.Components.size())) );
+
+  for(const auto& component : attr.Components)
+  {
+    TRY( Write<BigEndian>(stream, component.NameIndex, 
+                                  component.DescriptorIndex,
+                                  static_cast<U16>(component.Attributes.size())) );
+
+    for(const auto& pAttr : component.Attributes)
+      TRY( writeAttribute(stream, *pAttr, lengths) );
+  }
+
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const LineNumberTableAttribute& attr)
+{
+  return writeTable(stream, attr.LineNumbers);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const LocalVariableTableAttribute& attr)
+{
+  return writeTable(stream, attr.LocalVariables);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const LocalVariableTypeTableAttribute& attr)
+{
+  return writeTable(stream, attr.LocalVariableTypes);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT&, const DeprecatedAttribute&)
+{
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const MethodParametersAttribute& attr)
+{
+  TRY( Write<BigEndian>(stream, static_cast<U8>(attr.Parameters.size())) );
+  TRY( WriteArray<BigEndian>(stream, std::span{attr.Parameters}) );
+  return {};
+}
+
+//exports & opens
+template <typename StreamT>
+static ErrorOr<void> writeModulePackages(StreamT& stream, const ModuleAttribute& attr, const std::vector<ModulePackage>& packages)
+{
+  TRY( Write<BigEndian>(stream, static_cast<U16>(packages.size())) );
+
+  for(const auto& package : packages)
+  {
+    TRY( Write<BigEndian>(stream, package.Index, package.Flags, package.ToCount) );
+    TRY( WriteArray<BigEndian>(stream, attr.GetTo(package)) );
+  }
+
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const ModuleAttribute& attr)
+{
+  TRY( Write<BigEndian>(stream, attr.ModuleNameIndex, attr.ModuleFlags, attr.ModuleVersionIndex) );
+
+  TRY( writeTable(stream, attr.Requires) );
+  TRY( writeModulePackages(stream, attr, attr.Exports) );
+  TRY( writeModulePackages(stream, attr, attr.Opens) );
+  TRY( writeTable(stream, attr.Uses) );
+
+  TRY( Write<BigEndian>(stream, static_cast<U16>(attr.Provides.size())) );
+
+  for(const auto& provides : attr.Provides)
+  {
+    TRY( Write<BigEndian>(stream, provides.Index, provides.WithCount) );
+    TRY( WriteArray<BigEndian>(stream, attr.GetWith(provides)) );
+  }
+
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const ModulePackagesAttribute& attr)
+{
+  return writeTable(stream, attr.PackageIndex);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const ModuleMainClassAttribute& attr)
+{
+  TRY( Write<BigEndian>(stream, attr.MainClassIndex) );
+  return {};
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const AnnotationsAttribute& attr)
+{
+  return WriteArray(stream, attr.Bytes.Get());
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const ParameterAnnotationsAttribute& attr)
+{
+  return WriteArray(stream, attr.Bytes.Get());
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const AnnotationDefaultAttribute& attr)
+{
+  return WriteArray(stream, attr.Bytes.Get());
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttr(StreamT& stream, const LazyAttribute& attr, AttributeLengths& lengths)
+{
+  //the header was written with the decoded attributes length in this case
+  if (const AttributeInfo* decoded = attr.GetDecoded())
+    return writeAttributeBody(stream, *decoded, lengths);
+
+  TRY( WriteArray(stream, attr.Body) );
   return {};
 }
 
-template <typename T>
-static ErrorOr<void> writeAttrT(std::ostream& stream, const AttributeInfo& info)
+template <typename T, typename StreamT>
+static ErrorOr<void> writeAttrT(StreamT& stream, const AttributeInfo& info)
 {
   return writeAttr(stream, static_cast<const T&>(info));
 }
 
-ErrorOr<void> ClassFileWriter::WriteAttribute(std::ostream& stream, const AttributeInfo& info)
+template <typename StreamT>
+static ErrorOr<void> writeAttribute(StreamT& stream, const AttributeInfo& info, AttributeLengths& lengths)
 {
-  TRY( Write<BigEndian>(stream, info.NameIndex, info.GetLength()) );
+  //copied attributes have no slot in lengths, see computeAttributeLength()
+  if(isUnmodified(info))
+    return WriteArray(stream, info.OriginalBytes);
 
+  TRY( Write<BigEndian>(stream, info.NameIndex, lengths.Take()) );
+  return writeAttributeBody(stream, info, lengths);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeAttributeBody(StreamT& stream, const AttributeInfo& info, AttributeLengths& lengths)
+{
   switch(info.GetType())
   {
     case AttributeInfo::Type::ConstantValue: return writeAttrT<ConstantValueAttribute>(stream, info);
-    case AttributeInfo::Type::Code:          return writeAttrT<CodeAttribute>(stream, info);
+    case AttributeInfo::Type::Code:          return writeAttr(stream, static_cast<const CodeAttribute&>(info), lengths);
+    case AttributeInfo::Type::StackMapTable: return writeAttrT<StackMapTableAttribute>(stream, info);
+    case AttributeInfo::Type::BootstrapMethods:       return writeAttrT<BootstrapMethodsAttribute>(stream, info);
+    case AttributeInfo::Type::NestHost:               return writeAttrT<NestHostAttribute>(stream, info);
+    case AttributeInfo::Type::NestMembers:            return writeAttrT<NestMembersAttribute>(stream, info);
+    case AttributeInfo::Type::PermittedSubclasses:    return writeAttrT<PermittedSubclassesAttribute>(stream, info);
+    case AttributeInfo::Type::Exceptions:             return writeAttrT<ExceptionsAttribute>(stream, info);
+    case AttributeInfo::Type::InnerClasses:           return writeAttrT<InnerClassesAttribute>(stream, info);
+    case AttributeInfo::Type::EnclosingMethod:        return writeAttrT<EnclosingMethodAttribute>(stream, info);
+    case AttributeInfo::Type::Synthetic:              return writeAttrT<SyntheticAttribute>(stream, info);
+    case AttributeInfo::Type::Signature:              return writeAttrT<SignatureAttribute>(stream, info);
+    case AttributeInfo::Type::Record:                 return writeAttr(stream, static_cast<const RecordAttribute&>(info), lengths);
     case AttributeInfo::Type::SourceFile:    return writeAttrT<SourceFileAttribute>(stream, info);
+    case AttributeInfo::Type::LineNumberTable:        return writeAttrT<LineNumberTableAttribute>(stream, info);
+    case AttributeInfo::Type::LocalVariableTable:     return writeAttrT<LocalVariableTableAttribute>(stream, info);
+    case AttributeInfo::Type::LocalVariableTypeTable: return writeAttrT<LocalVariableTypeTableAttribute>(stream, info);
+    case AttributeInfo::Type::Deprecated:             return writeAttrT<DeprecatedAttribute>(stream, info);
+    case AttributeInfo::Type::MethodParameters:       return writeAttrT<MethodParametersAttribute>(stream, info);
+    case AttributeInfo::Type::Module:                 return writeAttrT<ModuleAttribute>(stream, info);
+    case AttributeInfo::Type::ModulePackages:         return writeAttrT<ModulePackagesAttribute>(stream, info);
+    case AttributeInfo::Type::ModuleMainClass:        return writeAttrT<ModuleMainClassAttribute>(stream, info);
+    case AttributeInfo::Type::RuntimeVisibleAnnotations:
+    case AttributeInfo::Type::RuntimeInvisibleAnnotations:          return writeAttrT<AnnotationsAttribute>(stream, info);
+    case AttributeInfo::Type::RuntimeVisibleParameterAnnotations:
+    case AttributeInfo::Type::RuntimeInvisibleParameterAnnotations: return writeAttrT<ParameterAnnotationsAttribute>(stream, info);
+    case AttributeInfo::Type::AnnotationDefault:      return writeAttrT<AnnotationDefaultAttribute>(stream, info);
 
     case AttributeInfo::Type::Raw:           return writeAttrT<RawAttribute>(stream, info);
+    case AttributeInfo::Type::Lazy:          return writeAttr(stream, static_cast<const LazyAttribute&>(info), lengths);
   }
 
   //TODO: stop using old c printf for formattting, as it isn't compatible with
@@ -282,15 +744,384 @@ ErrorOr<void> ClassFileWriter::WriteAttribute(std::ostream& stream, const Attrib
   return Error::FromFormatStr("WriteAttribute: write func not implemented for attribute with name \"%.*s\"", info.GetName().length(), info.GetName().data());
 }
 
-ErrorOr<void> ClassFileWriter::WriteInstruction(std::ostream& stream, const Instruction& instr)
+//The instruction types are determined by the opcode, a mismatch means the
+//instruction was constructed incorrectly
+template <typename InstrT>
+static const InstrT& castInstr(const Instruction& instr)
+{
+  assert(dynamic_cast<const InstrT*>(&instr) != nullptr);
+  return static_cast<const InstrT&>(instr);
+}
+
+template <typename StreamT>
+static ErrorOr<void> writeSwitchPadding(StreamT& stream, U32 codeOffset)
+{
+  static constexpr U8 zeros[3]{};
+  TRY( WriteArray(stream, std::span<const U8>{ zeros, GetSwitchPadding(codeOffset) }) );
+  return {};
+}
+
+//Writes the operands of the instruction with the given opcode, the opcode
+//itself has already been written. Counterpart of decodeInstr in the parser.
+template <typename StreamT, U8 OPCODE>
+static ErrorOr<void> encodeInstr(StreamT& stream, const Instruction& instr, U32 codeOffset)
+{
+  using namespace Instructions;
+
+  constexpr OperandLayout layout = OpCodeInfoTable[OPCODE].Layout;
+
+  if constexpr (layout == OperandLayout::None)
+  {
+    return {};
+  }
+  else if constexpr (layout == OperandLayout::UByte || layout == OperandLayout::SByte ||
+                     layout == OperandLayout::UShort || layout == OperandLayout::SShort ||
+                     layout == OperandLayout::SInt || layout == OperandLayout::AType)
+  {
+    using OperandT = 
+      std::conditional_t<layout == OperandLayout::UByte,  U8,
+      std::conditional_t<layout == OperandLayout::SByte,  S8,
+      std::conditional_t<layout == OperandLayout::UShort, U16,
+      std::conditional_t<layout == OperandLayout::SShort, S16,
+      std::conditional_t<layout == OperandLayout::SInt,   S32, AType>>>>>;
+
+    const auto& oneArg = castInstr< OneArgInstruction<OPCODE, OperandT> >(instr);
+    TRY( Write<BigEndian>(stream, oneArg.FirstArg) );
+    return {};
+  }
+  else if constexpr (layout == OperandLayout::IInc)
+  {
+    const auto& iinc = castInstr<IINC>(instr);
+    TRY( Write<BigEndian>(stream, iinc.FirstArg, iinc.SecondArg) );
+    return {};
+  }
+  else if constexpr (layout == OperandLayout::MultiANewArray)
+  {
+    const auto& multiANewArray = castInstr<MULTIANEWARRAY>(instr);
+    TRY( Write<BigEndian>(stream, multiANewArray.FirstArg, multiANewArray.SecondArg) );
+    return {};
+  }
+  else if constexpr (layout == OperandLayout::InvokeInterface)
+  {
+    const auto& invoke = castInstr<INVOKEINTERFACE>(instr);
+    TRY( Write<BigEndian>(stream, invoke.FirstArg, invoke.SecondArg, U8{0}) );
+    return {};
+  }
+  else if constexpr (layout == OperandLayout::InvokeDynamic)
+  {
+    const auto& invoke = castInstr<INVOKEDYNAMIC>(instr);
+    TRY( Write<BigEndian>(stream, invoke.FirstArg, U16{0}) );
+    return {};
+  }
+  else if constexpr (layout == OperandLayout::TableSwitch)
+  {
+    const auto& tableSwitch = castInstr<TABLESWITCH>(instr);
+
+    S32 high = tableSwitch.Low + static_cast<S32>(tableSwitch.Offsets.size()) - 1;
+
+    TRY( writeSwitchPadding(stream, codeOffset) );
+    TRY( Write<BigEndian>(stream, tableSwitch.Default, tableSwitch.Low, high) );
+    TRY( WriteArray<BigEndian>(stream, std::span{tableSwitch.Offsets}) );
+    return {};
+  }
+  else if constexpr (layout == OperandLayout::LookupSwitch)
+  {
+    const auto& lookupSwitch = castInstr<LOOKUPSWITCH>(instr);
+
+    S32 nPairs = static_cast<S32>(lookupSwitch.Pairs.size() / 2);
+
+    TRY( writeSwitchPadding(stream, codeOffset) );
+    TRY( Write<BigEndian>(stream, lookupSwitch.Default, nPairs) );
+    TRY( WriteArray<BigEndian>(stream, std::span{lookupSwitch.Pairs}) );
+    return {};
+  }
+  else if constexpr (layout == OperandLayout::Wide)
+  {
+    //WIDE & WIDE_IINC share the opcode
+    if (const auto* wideIInc = dynamic_cast<const WIDE_IINC*>(&instr))
+    {
+      TRY( Write<BigEndian>(stream, static_cast<U8>(OP_IINC), wideIInc->Index, wideIInc->Const) );
+      return {};
+    }
+
+    const auto& wide = castInstr<WIDE>(instr);
+    TRY( Write<BigEndian>(stream, wide.OpCode, wide.Index) );
+    return {};
+  }
+  else
+  {
+    return Error::FromFormatStr("WriteInstruction: unknown opcode %#04x", OPCODE);
+  }
+}
+
+template <typename StreamT>
+using EncodeInstrFn = ErrorOr<void> (*)(StreamT&, const Instruction&, U32);
+
+template <typename StreamT, size_t... OPCODES>
+static constexpr std::array<EncodeInstrFn<StreamT>, 256> makeEncodeTable(std::index_sequence<OPCODES...>)
+{
+  return { &encodeInstr<StreamT, static_cast<U8>(OPCODES)>... };
+}
+
+template <typename StreamT>
+static constexpr std::array<EncodeInstrFn<StreamT>, 256> encodeTable = 
+  makeEncodeTable<StreamT>(std::make_index_sequence<256>{});
+
+template <typename StreamT>
+static ErrorOr<void> writeInstruction(StreamT& stream, const Instruction& instr, U32 codeOffset)
 {
-  return Error::FromLiteralStr("WIRITNG INSTRUCTION NOT IMPL");
-  /*
   TRY( Write<BigEndian>(stream, instr.OpCode) );
+  return encodeTable<StreamT>[instr.OpCode](stream, instr, codeOffset);
+}
+
+static size_t getConstantSize(const ConstantPool& cp, U16 index)
+{
+  constexpr size_t tagSize = sizeof(U8);
+
+  switch(cp.GetType(index))
+  {
+    case CPInfo::Type::Class:         
+    case CPInfo::Type::String:        
+    case CPInfo::Type::MethodType:    return tagSize + sizeof(U16);
+    case CPInfo::Type::MethodHandle:  return tagSize + sizeof(U8) + sizeof(U16);
+    case CPInfo::Type::Fieldref:      
+    case CPInfo::Type::Methodref:     
+    case CPInfo::Type::InterfaceMethodref: 
+    case CPInfo::Type::NameAndType:   
+    case CPInfo::Type::InvokeDynamic: return tagSize + sizeof(U16) * 2;
+    case CPInfo::Type::Integer:       
+    case CPInfo::Type::Float:         return tagSize + sizeof(U32);
+    case CPInfo::Type::Long:          
+    case CPInfo::Type::Double:        return tagSize + sizeof(U32) * 2;
+    case CPInfo::Type::UTF8:          return tagSize + sizeof(U16) + cp.GetUTF8(index).length();
+    case CPInfo::Type::Unusable:      return 0;
+  }
+
+  return 0;
+}
+
+static U32 computeAttributeLength(const AttributeInfo& info, std::vector<U32>& lengths);
+
+//Mirrors writeAttributeBody(), the lengths of nested attributes are computed
+//(and stored) once instead of through their parents GetLength()
+static U32 computeAttributeBodyLength(const AttributeInfo& info, std::vector<U32>& lengths)
+{
+  if(info.GetType() == AttributeInfo::Type::Lazy)
+  {
+    if(const AttributeInfo* decoded = static_cast<const LazyAttribute&>(info).GetDecoded())
+      return computeAttributeBodyLength(*decoded, lengths);
+  }
+
+  if(info.GetType() == AttributeInfo::Type::Record)
+  {
+    const auto& record = static_cast<const RecordAttribute&>(info);
+
+    U32 len = sizeof(U16);
+
+    for(const auto& component : record.Components)
+    {
+      len += sizeof(component.NameIndex) + sizeof(component.DescriptorIndex) + sizeof(U16);
+
+      for(const auto& pAttr : component.Attributes)
+        len += AttributeInfo::GetHeaderLength() + computeAttributeLength(*pAttr, lengths);
+    }
+
+    return len;
+  }
+
+  if(info.GetType() != AttributeInfo::Type::Code)
+    return info.GetLength();
+
+  const auto& code = static_cast<const CodeAttribute&>(info);
+
+  U32 len = sizeof(code.MaxStack) + sizeof(code.MaxLocals);
+  len += sizeof(U32) + code.GetCodeLength();
+  len += sizeof(U16) + static_cast<U32>(code.ExceptionTable.size() * sizeof(CodeAttribute::ExceptionHandler));
+  len += sizeof(U16);
+
+  for(const auto& pAttr : code.Attributes)
+    len += AttributeInfo::GetHeaderLength() + computeAttributeLength(*pAttr, lengths);
+
+  return len;
+}
+
+static U32 computeAttributeLength(const AttributeInfo& info, std::vector<U32>& lengths)
+{
+  if(isUnmodified(info))
+    return static_cast<U32>(info.OriginalBytes.size()) - AttributeInfo::GetHeaderLength();
+
+  //the slot is taken before the nested attributes, as the header is written first
+  size_t slot = lengths.size();
+  lengths.push_back(0);
+
+  U32 len = computeAttributeBodyLength(info, lengths);
+  lengths[slot] = len;
+
+  return len;
+}
+
+static size_t computeAttributesSize(const std::vector< ArenaPtr<AttributeInfo> >& attributes, std::vector<U32>& lengths)
+{
+  size_t size = sizeof(U16); //attributes_count
 
-  for(const U8& operand : instr.OperandBytes)
-    TRY( Write<BigEndian>(stream, operand) );
-    */
+  for(const auto& pAttr : attributes)
+    size += AttributeInfo::GetHeaderLength() + computeAttributeLength(*pAttr, lengths);
+
+  return size;
+}
+
+static size_t computeFieldMethodSize(const FieldMethodInfo& info, std::vector<U32>& lengths)
+{
+  if(isUnmodified(info))
+    return info.OriginalBytes.size();
+
+  return sizeof(info.AccessFlags) + sizeof(info.NameIndex) + sizeof(info.DescriptorIndex) 
+    + computeAttributesSize(info.Attributes, lengths);
+}
+
+static size_t computeClassFileSize(const ClassFile& cf, std::vector<U32>& lengths)
+{
+  size_t size = sizeof(cf.Magic) + sizeof(cf.MinorVersion) + sizeof(cf.MajorVersion);
+
+  size += sizeof(U16); //constant_pool_count
+  for(U16 i = 1; i < cf.ConstPool.Count(); i++)
+    size += getConstantSize(cf.ConstPool, i);
+
+  size += sizeof(cf.AccessFlags) + sizeof(cf.ThisClass) + sizeof(cf.SuperClass);
+  size += sizeof(U16) + cf.Interfaces.size() * sizeof(U16);
+
+  size += sizeof(U16);
+  for(const auto& field : cf.Fields)
+    size += computeFieldMethodSize(field, lengths);
+
+  size += sizeof(U16);
+  for(const auto& method : cf.Methods)
+    size += computeFieldMethodSize(method, lengths);
+
+  size += computeAttributesSize(cf.Attributes, lengths);
+
+  return size;
+}
+
+ErrorOr<void> ClassFileWriter::WriteClassFile(std::ostream& stream, const ClassFile& cf)
+{
+  auto errOrBuffer = ClassFileWriter::WriteClassFileToBuffer(cf);
+  VERIFY(errOrBuffer);
+
+  const auto& buffer = errOrBuffer.Get();
+  stream.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+
+  if(stream.bad())
+    return Error::FromFormatStr("WriteClassFile failed: streams badbit got set after write. (streampos = 0x%X)", stream.tellp());
+
+  return {};
+}
+
+ErrorOr<void> ClassFileWriter::WriteClassFile(std::ostream& stream, ClassFile& cf, const WriteOptions& options)
+{
+  if(options.ComputeMaxs)
+    TRY( MaxsComputer{}.Update(cf) );
+
+  return ClassFileWriter::WriteClassFile(stream, cf);
+}
+
+ErrorOr< std::vector<U8> > ClassFileWriter::WriteClassFileToBuffer(ClassFile& cf, const WriteOptions& options)
+{
+  if(options.ComputeMaxs)
+    TRY( MaxsComputer{}.Update(cf) );
+
+  return ClassFileWriter::WriteClassFileToBuffer(cf);
+}
+
+//Writes a class file whose size & attribute lengths have already been computed
+static ErrorOr<void> writeClassFileSized(std::span<U8> buffer, const ClassFile& cf, size_t size, AttributeLengths& lengths)
+{
+  ByteWriter writer{buffer.first(size)};
+  TRY( writeClassFile(writer, cf, lengths) );
+
+  //the writes are unchecked, so this only catches GetLength() implementations 
+  //that disagree with what actually gets written, after the fact
+  if(writer.Tell() != size)
+  {
+    return Error::FromFormatStr("WriteClassFileToBuffer failed: computed size (%zu) doesn't match written size (%zu)", 
+        size, writer.Tell());
+  }
 
   return {};
 }
+
+size_t ClassFileWriter::ComputeSerializedSize(const ClassFile& cf)
+{
+  std::vector<U32> lengths;
+  return computeClassFileSize(cf, lengths);
+}
+
+ErrorOr< std::vector<U8> > ClassFileWriter::WriteClassFileToBuffer(const ClassFile& cf)
+{
+  AttributeLengths lengths;
+  std::vector<U8> buffer(computeClassFileSize(cf, lengths.Lengths));
+
+  TRY( writeClassFileSized(buffer, cf, buffer.size(), lengths) );
+  return buffer;
+}
+
+ErrorOr<size_t> ClassFileWriter::WriteClassFileToBuffer(std::span<U8> buffer, const ClassFile& cf)
+{
+  AttributeLengths lengths;
+  size_t size = computeClassFileSize(cf, lengths.Lengths);
+
+  if(buffer.size() < size)
+  {
+    return Error::FromFormatStr("WriteClassFileToBuffer failed: buffer too small (buffer size: %zu, required: %zu)", 
+        buffer.size(), size);
+  }
+
+  TRY( writeClassFileSized(buffer, cf, size, lengths) );
+  return size;
+}
+
+ErrorOr<void> ClassFileWriter::WriteConstantPool(std::ostream& stream, const ConstantPool& cp)
+{
+  return writeConstantPool(stream, cp);
+}
+
+ErrorOr<void> ClassFileWriter::WriteConstant(std::ostream& stream, const CPInfo& info)
+{
+  return writeConstant(stream, info);
+}
+
+ErrorOr<void> ClassFileWriter::WriteFieldMethod(std::ostream& stream, const FieldMethodInfo& info)
+{
+  AttributeLengths lengths;
+  computeFieldMethodSize(info, lengths.Lengths);
+
+  return writeFieldMethod(stream, info, lengths);
+}
+
+ErrorOr<void> ClassFileWriter::WriteAttribute(std::ostream& stream, const AttributeInfo& info)
+{
+  AttributeLengths lengths;
+  computeAttributeLength(info, lengths.Lengths);
+
+  return writeAttribute(stream, info, lengths);
+}
+
+ErrorOr<void> ClassFileWriter::WriteInstruction(std::ostream& stream, const Instruction& instr, U32 codeOffset)
+{
+  return writeInstruction(stream, instr, codeOffset);
+}
+
+ErrorOr< std::vector<U8> > ClassFileWriter::WriteCode(std::span<const ArenaPtr<Instruction>> instructions)
+{
+  U32 size{0};
+  for(const auto& instr : instructions)
+    size += instr->GetPaddedLength(size);
+
+  std::vector<U8> buffer(size);
+  ByteWriter writer{buffer};
+
+  for(const auto& instr : instructions)
+    TRY( writeInstruction(writer, *instr, static_cast<U32>(writer.Tell())) );
+
+  return buffer;
+}
@@ -0,0 +1,407 @@
+#include "FileFormats/JVM/CodeBuilder.hpp"
+
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace FileFormats;
+using namespace FileFormats::JVM;
+
+static constexpr U32 MaxCodeLength = 65535;
+
+//size of IF<!cond> + GOTO_W replacing a conditional branch
+static constexpr U32 InvertedBranchLength = 3 + 5;
+
+static bool isConditional(U8 opCode)
+{
+  return GetOpCodeInfo(opCode).IsConditionalBranch();
+}
+
+//IFEQ <-> IFNE, IFLT <-> IFGE, ... IFNULL <-> IFNONNULL
+static U8 invertCondition(U8 opCode)
+{
+  if (opCode == OP_IFNULL || opCode == OP_IFNONNULL)
+    return opCode ^ 1;
+
+  return static_cast<U8>(OP_IFEQ + ((opCode - OP_IFEQ) ^ 1));
+}
+
+static U8* storeS16(U8* dest, S32 value)
+{
+  dest[0] = static_cast<U8>(value >> 8);
+  dest[1] = static_cast<U8>(value);
+  return dest + 2;
+}
+
+static U8* storeS32(U8* dest, S32 value)
+{
+  dest[0] = static_cast<U8>(value >> 24);
+  dest[1] = static_cast<U8>(value >> 16);
+  dest[2] = static_cast<U8>(value >> 8);
+  dest[3] = static_cast<U8>(value);
+  return dest + 4;
+}
+
+Label CodeBuilder::NewLabel()
+{
+  m_labelItems.push_back(Unbound);
+  return Label{ static_cast<U32>(m_labelItems.size() - 1) };
+}
+
+void CodeBuilder::Bind(Label label)
+{
+  assert(label.Id < m_labelItems.size() && m_labelItems[label.Id] == Unbound);
+
+  m_labelItems[label.Id] = static_cast<U32>(m_items.size());
+
+  //the label has to stay in front of whatever gets emitted next
+  m_rawOpen = false;
+}
+
+U8* CodeBuilder::AppendRaw(size_t size)
+{
+  if (!m_rawOpen)
+  {
+    Item item{};
+    item.ItemKind = Item::Kind::Raw;
+    item.Begin = item.End = static_cast<U32>(m_bytes.size());
+
+    m_items.push_back(item);
+    m_rawOpen = true;
+  }
+
+  size_t offset = m_bytes.size();
+  m_bytes.resize(offset + size);
+  m_items.back().End = static_cast<U32>(m_bytes.size());
+
+  return m_bytes.data() + offset;
+}
+
+void CodeBuilder::Emit(const InstructionView& instr)
+{
+  assert(!instr.GetInfo().IsBranch());
+
+  auto bytes = instr.GetBytes();
+  std::memcpy(this->AppendRaw(bytes.size()), bytes.data(), bytes.size());
+}
+
+void CodeBuilder::EmitBranch(U8 opCode, Label target)
+{
+  assert(GetOpCodeInfo(opCode).IsBranch() && !GetOpCodeInfo(opCode).IsSwitch());
+
+  Item item{};
+  item.ItemKind = Item::Kind::Branch;
+  item.OpCode = opCode;
+  item.IsWide = opCode == OP_GOTO_W || opCode == OP_JSR_W;
+  item.Target = target.Id;
+
+  m_items.push_back(item);
+  m_rawOpen = false;
+}
+
+void CodeBuilder::EmitTableSwitch(Label defaultTarget, S32 low, std::span<const Label> targets)
+{
+  Item item{};
+  item.ItemKind = Item::Kind::TableSwitch;
+  item.OpCode = OP_TABLESWITCH;
+  item.Target = defaultTarget.Id;
+  item.Begin = static_cast<U32>(m_cases.size());
+
+  for (size_t i = 0; i < targets.size(); i++)
+    m_cases.emplace_back(static_cast<S32>(low + static_cast<S64>(i)), targets[i].Id);
+
+  item.End = static_cast<U32>(m_cases.size());
+
+  m_items.push_back(item);
+  m_rawOpen = false;
+}
+
+void CodeBuilder::EmitLookupSwitch(Label defaultTarget, std::span<const std::pair<S32, Label>> cases)
+{
+  Item item{};
+  item.ItemKind = Item::Kind::LookupSwitch;
+  item.OpCode = OP_LOOKUPSWITCH;
+  item.Target = defaultTarget.Id;
+  item.Begin = static_cast<U32>(m_cases.size());
+
+  for (const auto& [match, label] : cases)
+    m_cases.emplace_back(match, label.Id);
+
+  item.End = static_cast<U32>(m_cases.size());
+
+  std::sort(m_cases.begin() + item.Begin, m_cases.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  m_items.push_back(item);
+  m_rawOpen = false;
+}
+
+void CodeBuilder::AddExceptionHandler(Label start, Label end, Label handler, U16 catchType)
+{
+  m_handlers.push_back({ start.Id, end.Id, handler.Id, catchType });
+}
+
+ErrorOr<void> CodeBuilder::CheckLabel(U32 label) const
+{
+  if (label >= m_labelItems.size() || m_labelItems[label] == Unbound)
+    return Error::FromFormatStr("CodeBuilder: label %u is used but not bound", label);
+
+  return {};
+}
+
+U32 CodeBuilder::GetItemSize(const Item& item, U32 pc) const
+{
+  switch (item.ItemKind)
+  {
+    case Item::Kind::Raw:
+      return item.End - item.Begin;
+
+    case Item::Kind::Branch:
+      if (!item.IsWide)
+        return 3;
+
+      return isConditional(item.OpCode) ? InvertedBranchLength : 5;
+
+    case Item::Kind::TableSwitch:
+      return 1 + GetSwitchPadding(pc) + 12 + (item.End - item.Begin) * 4;
+
+    case Item::Kind::LookupSwitch:
+      return 1 + GetSwitchPadding(pc) + 8 + (item.End - item.Begin) * 8;
+  }
+
+  return 0;
+}
+
+//Assigns offsets to all items, widening branches until all of them reach
+//their target. Returns the code length.
+U32 CodeBuilder::Layout()
+{
+  m_itemOffsets.resize(m_items.size() + 1);
+
+  for (;;)
+  {
+    //U64, as the code may temporarily exceed U32 (it is rejected afterwards)
+    U64 pc{0};
+
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+      m_itemOffsets[i] = static_cast<U32>(std::min<U64>(pc, std::numeric_limits<U32>::max()));
+      pc += this->GetItemSize(m_items[i], m_itemOffsets[i]);
+    }
+
+    m_itemOffsets[m_items.size()] = static_cast<U32>(std::min<U64>(pc, std::numeric_limits<U32>::max()));
+
+    bool widened = false;
+
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+      Item& item = m_items[i];
+      if (item.ItemKind != Item::Kind::Branch || item.IsWide)
+        continue;
+
+      S64 offset = S64{m_itemOffsets[m_labelItems[item.Target]]} - m_itemOffsets[i];
+
+      if (offset < std::numeric_limits<S16>::min() || offset > std::numeric_limits<S16>::max())
+      {
+        item.IsWide = true;
+        widened = true;
+      }
+    }
+
+    if (!widened)
+      return m_itemOffsets[m_items.size()];
+  }
+}
+
+void CodeBuilder::Encode(std::vector<U8>& code) const
+{
+  U8* dest = code.data();
+
+  auto targetOffset = [this](U32 label, U32 pc)
+  {
+    return static_cast<S32>(S64{m_itemOffsets[m_labelItems[label]]} - pc);
+  };
+
+  for (size_t i = 0; i < m_items.size(); i++)
+  {
+    const Item& item = m_items[i];
+    U32 pc = m_itemOffsets[i];
+
+    switch (item.ItemKind)
+    {
+      case Item::Kind::Raw:
+        std::memcpy(dest, m_bytes.data() + item.Begin, item.End - item.Begin);
+        dest += item.End - item.Begin;
+        break;
+
+      case Item::Kind::Branch:
+      {
+        S32 offset = targetOffset(item.Target, pc);
+
+        if (!item.IsWide)
+        {
+          *dest++ = item.OpCode;
+          dest = storeS16(dest, offset);
+        }
+        else if (isConditional(item.OpCode))
+        {
+          //IF<!cond> over the GOTO_W, which is 3 bytes further into the code
+          *dest++ = invertCondition(item.OpCode);
+          dest = storeS16(dest, InvertedBranchLength);
+          *dest++ = OP_GOTO_W;
+          dest = storeS32(dest, offset - 3);
+        }
+        else
+        {
+          *dest++ = item.OpCode == OP_JSR || item.OpCode == OP_JSR_W ? OP_JSR_W : OP_GOTO_W;
+          dest = storeS32(dest, offset);
+        }
+        break;
+      }
+
+      case Item::Kind::TableSwitch:
+      case Item::Kind::LookupSwitch:
+      {
+        bool isTable = item.ItemKind == Item::Kind::TableSwitch;
+        U32 count = item.End - item.Begin;
+
+        *dest++ = item.OpCode;
+
+        U32 padding = GetSwitchPadding(pc);
+        std::memset(dest, 0, padding);
+        dest += padding;
+
+        dest = storeS32(dest, targetOffset(item.Target, pc));
+
+        if (isTable)
+        {
+          S32 low = m_cases[item.Begin].first;
+          dest = storeS32(dest, low);
+          dest = storeS32(dest, static_cast<S32>(S64{low} + count - 1));
+
+          for (U32 j = item.Begin; j < item.End; j++)
+            dest = storeS32(dest, targetOffset(m_cases[j].second, pc));
+        }
+        else
+        {
+          dest = storeS32(dest, static_cast<S32>(count));
+
+          for (U32 j = item.Begin; j < item.End; j++)
+          {
+            dest = storeS32(dest, m_cases[j].first);
+            dest = storeS32(dest, targetOffset(m_cases[j].second, pc));
+          }
+        }
+        break;
+      }
+    }
+  }
+}
+
+//Validates the labels & switches, before they are laid out
+ErrorOr<void> CodeBuilder::CheckItems() const
+{
+  for (const Item& item : m_items)
+  {
+    if (item.ItemKind == Item::Kind::Raw)
+      continue;
+
+    TRY(this->CheckLabel(item.Target));
+
+    for (U32 j = item.Begin; j < item.End; j++)
+      TRY(this->CheckLabel(m_cases[j].second));
+
+    if (item.ItemKind == Item::Kind::TableSwitch && item.Begin == item.End)
+      return Error::FromLiteralStr("CodeBuilder: TABLESWITCH without cases");
+
+    if (item.ItemKind == Item::Kind::TableSwitch &&
+        S64{m_cases[item.Begin].first} + (item.End - item.Begin) - 1 > std::numeric_limits<S32>::max())
+      return Error::FromLiteralStr("CodeBuilder: TABLESWITCH cases exceed the S32 range");
+
+    if (item.ItemKind == Item::Kind::LookupSwitch)
+    {
+      auto begin = m_cases.begin() + item.Begin;
+      auto end = m_cases.begin() + item.End;
+
+      if (std::adjacent_find(begin, end, [](const auto& a, const auto& b) { return a.first == b.first; }) != end)
+        return Error::FromLiteralStr("CodeBuilder: LOOKUPSWITCH with duplicate cases");
+    }
+  }
+
+  for (const Handler& handler : m_handlers)
+  {
+    TRY(this->CheckLabel(handler.Start));
+    TRY(this->CheckLabel(handler.End));
+    TRY(this->CheckLabel(handler.HandlerLabel));
+  }
+
+  return {};
+}
+
+ErrorOr<bool> CodeBuilder::InvertsBranches()
+{
+  TRY(this->CheckItems());
+  this->Layout();
+
+  return std::any_of(m_items.begin(), m_items.end(), [](const Item& item)
+    { return item.ItemKind == Item::Kind::Branch && item.IsWide && isConditional(item.OpCode); });
+}
+
+ErrorOr<void> CodeBuilder::Build(CodeAttribute& attr)
+{
+  TRY(this->CheckItems());
+
+  U32 codeLength = this->Layout();
+
+  if (codeLength > MaxCodeLength)
+    return Error::FromFormatStr("CodeBuilder: code is %u bytes long, the maximum is %u", codeLength, MaxCodeLength);
+
+  std::vector<U8> code(codeLength);
+  this->Encode(code);
+
+  std::vector<CodeAttribute::ExceptionHandler> exceptionTable;
+  exceptionTable.reserve(m_handlers.size());
+
+  for (const Handler& handler : m_handlers)
+  {
+    U32 start = *this->GetOffset(Label{handler.Start});
+    U32 end = *this->GetOffset(Label{handler.End});
+
+    if (start >= end)
+      return Error::FromFormatStr("CodeBuilder: exception handler range [%u, %u) is empty", start, end);
+
+    exceptionTable.push_back({ static_cast<U16>(start), static_cast<U16>(end),
+        static_cast<U16>(*this->GetOffset(Label{handler.HandlerLabel})), handler.CatchType });
+  }
+
+  auto errOrCode = Bytecode::FromBytes(std::move(code));
+  VERIFY(errOrCode);
+
+  attr.Code = errOrCode.Release();
+  attr.ExceptionTable = std::move(exceptionTable);
+  attr.MarkModified();
+
+  return {};
+}
+
+std::optional<U32> CodeBuilder::GetOffset(Label label) const
+{
+  if (label.Id >= m_labelItems.size() || m_labelItems[label.Id] == Unbound ||
+      m_itemOffsets.size() != m_items.size() + 1)
+    return std::nullopt;
+
+  return m_itemOffsets[m_labelItems[label.Id]];
+}
+
+void CodeBuilder::Reset()
+{
+  m_items.clear();
+  m_bytes.clear();
+  m_cases.clear();
+  m_handlers.clear();
+  m_labelItems.clear();
+  m_itemOffsets.clear();
+  m_rawOpen = false;
+}
@@ -1,101 +1,596 @@
 #include "FileFormats/JVM/ConstantPool.hpp"
+#include "FileFormats/JVM/Attribute.hpp"
+
+#include "Util/Error.hpp"
 
-#include <map>
 #include <cassert>
 
 using namespace FileFormats;
 using namespace FileFormats::JVM;
 
-std::string_view CPInfo::GetTypeName(Type type)
+std::string_view CPInfo::GetName() const
 {
-  using namespace std::literals;
+  return CPInfo::GetTypeName(this->GetType());
+}
 
-  static std::map<Type, std::string_view> typeNames = 
+CPInfo::Type CPInfo::GetType() const
+{
+  return this->m_type;
+}
+
+void UTF8Info::SetView(std::string_view view)
+{
+  m_view = view;
+  m_owned.clear();
+  m_isOwned = false;
+}
+
+void UTF8Info::Set(std::string str)
+{
+  m_owned = std::move(str);
+  m_isOwned = true;
+}
+
+std::string& UTF8Info::GetMutable()
+{
+  if (!m_isOwned)
   {
-    {Type::Class,              "Class"sv},
-    {Type::Fieldref,           "Fieldref"sv},
-    {Type::Methodref,          "Methodref"sv},
-    {Type::InterfaceMethodref, "InterfaceMethodref"sv},
-    {Type::String,             "String"sv},
-    {Type::Integer,            "Integer"sv},
-    {Type::Float,              "Float"sv},
-    {Type::Long,               "Long"sv},
-    {Type::Double,             "Double"sv},
-    {Type::NameAndType,        "NameAndType"sv},
-    {Type::UTF8,               "UTF8"sv},
-    {Type::MethodHandle,       "MethodHandle"sv},
-    {Type::MethodType,         "MethodType"sv},
-    {Type::InvokeDynamic,      "InvokeDynamic"sv},
-  };
-
-  auto itr = typeNames.find(type);
-
-  assert(itr != typeNames.end());
-  return std::get<1>(*itr);
+    m_owned.assign(m_view);
+    m_isOwned = true;
+  }
+
+  return m_owned;
 }
 
-std::string_view CPInfo::GetName() const
+std::string_view UTF8Info::GetDecoded(std::string& scratch) const
 {
-  return CPInfo::GetTypeName(this->GetType());
+  return DecodeModifiedUTF8(this->Get(), scratch);
 }
 
-CPInfo::Type CPInfo::GetType() const
+//3 byte sequence (as used for surrogates) to its code point
+static U32 decodeThreeBytes(const U8* bytes)
 {
-  return this->m_type;
+  return (static_cast<U32>(bytes[0] & 0x0F) << 12) |
+         (static_cast<U32>(bytes[1] & 0x3F) << 6) |
+          static_cast<U32>(bytes[2] & 0x3F);
+}
+
+static bool isSurrogate(const U8* bytes, size_t remaining, U32 low, U32 high)
+{
+  if (remaining < 3 || bytes[0] != 0xED)
+    return false;
+
+  U32 codePoint = decodeThreeBytes(bytes);
+  return codePoint >= low && codePoint <= high;
+}
+
+std::string_view JVM::DecodeModifiedUTF8(std::string_view str, std::string& scratch)
+{
+  const U8* bytes = reinterpret_cast<const U8*>(str.data());
+  const size_t size = str.size();
+
+  //only 0xC0 (the 2 byte NUL) and 0xED (surrogates) lead bytes may need to be
+  //converted, 0xED is also the lead byte of U+D000 - U+D7FF though
+  size_t i = 0;
+  while (i < size && bytes[i] != 0xC0 && bytes[i] != 0xED)
+    i++;
+
+  if (i == size)
+    return str;
+
+  scratch.assign(str.data(), i);
+  scratch.reserve(size);
+
+  while (i < size)
+  {
+    if (bytes[i] == 0xC0 && i + 1 < size && bytes[i + 1] == 0x80)
+    {
+      scratch.push_back('\0');
+      i += 2;
+    }
+    else if (isSurrogate(bytes + i, size - i, 0xD800, 0xDBFF) && 
+             isSurrogate(bytes + i + 3, size - i - 3, 0xDC00, 0xDFFF))
+    {
+      U32 codePoint = 0x10000 + ((decodeThreeBytes(bytes + i) - 0xD800) << 10) + 
+                                 (decodeThreeBytes(bytes + i + 3) - 0xDC00);
+
+      scratch.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+      scratch.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+      scratch.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+      scratch.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+      i += 6;
+    }
+    else if (isSurrogate(bytes + i, size - i, 0xD800, 0xDFFF))
+    {
+      scratch.append("\xEF\xBF\xBD");
+      i += 3;
+    }
+    else
+    {
+      scratch.push_back(str[i]);
+      i++;
+    }
+  }
+
+  return scratch;
+}
+
+static U64 packIndices(U16 first, U16 second)
+{
+  return static_cast<U64>(first) | (static_cast<U64>(second) << 16);
+}
+
+static U64 packU32s(U32 high, U32 low)
+{
+  return (static_cast<U64>(high) << 32) | low;
+}
+
+//slot value of any constant but UTF8
+static U64 toSlot(const CPInfo& info)
+{
+  switch(info.GetType())
+  {
+    case CPInfo::Type::Class:
+      return static_cast<const ClassInfo&>(info).NameIndex;
+    case CPInfo::Type::Fieldref:
+    {
+      const auto& ref = static_cast<const FieldrefInfo&>(info);
+      return packIndices(ref.ClassIndex, ref.NameAndTypeIndex);
+    }
+    case CPInfo::Type::Methodref:
+    {
+      const auto& ref = static_cast<const MethodrefInfo&>(info);
+      return packIndices(ref.ClassIndex, ref.NameAndTypeIndex);
+    }
+    case CPInfo::Type::InterfaceMethodref:
+    {
+      const auto& ref = static_cast<const InterfaceMethodrefInfo&>(info);
+      return packIndices(ref.ClassIndex, ref.NameAndTypeIndex);
+    }
+    case CPInfo::Type::String:
+      return static_cast<const StringInfo&>(info).StringIndex;
+    case CPInfo::Type::Integer:
+      return static_cast<const IntegerInfo&>(info).Bytes;
+    case CPInfo::Type::Float:
+      return static_cast<const FloatInfo&>(info).Bytes;
+    case CPInfo::Type::Long:
+    {
+      const auto& value = static_cast<const LongInfo&>(info);
+      return packU32s(value.HighBytes, value.LowBytes);
+    }
+    case CPInfo::Type::Double:
+    {
+      const auto& value = static_cast<const DoubleInfo&>(info);
+      return packU32s(value.HighBytes, value.LowBytes);
+    }
+    case CPInfo::Type::NameAndType:
+    {
+      const auto& nat = static_cast<const NameAndTypeInfo&>(info);
+      return packIndices(nat.NameIndex, nat.DescriptorIndex);
+    }
+    case CPInfo::Type::MethodHandle:
+    {
+      const auto& handle = static_cast<const MethodHandleInfo&>(info);
+      return packIndices(handle.ReferenceKind, handle.ReferenceIndex);
+    }
+    case CPInfo::Type::MethodType:
+      return static_cast<const MethodTypeInfo&>(info).DescriptorIndex;
+    case CPInfo::Type::InvokeDynamic:
+    {
+      const auto& indy = static_cast<const InvokeDynamicInfo&>(info);
+      return packIndices(indy.BootstrapMethodAttrIndex, indy.NameAndTypeIndex);
+    }
+    case CPInfo::Type::UTF8:
+    case CPInfo::Type::Unusable:
+      break;
+  }
+
+  return 0;
 }
 
 ConstantPool::ConstantPool(U16 n) 
 {
   //constants use 1 based indexing, so we ignore the 0th index
-  m_pool.emplace_back( std::unique_ptr<CPInfo>{nullptr} );
+  this->AddSlot(CPInfo::Type::Unusable, 0);
 }
 
 void ConstantPool::Reserve(U16 n) 
 {
-  m_pool.reserve(n);
+  m_tags.reserve(n);
+  m_slots.reserve(n);
+}
+
+void ConstantPool::SetStringStorage(Arena& storage)
+{
+  assert(m_utf8.empty());
+  m_stringStorage = &storage;
 }
 
 std::string_view ConstantPool::GetConstNameOrTypeStr(U16 index) const
 {
-  auto ptr = m_pool[index].get();
+  switch(this->GetType(index))
+  {
+    case CPInfo::Type::Unusable: return "UNINITIALIZED";
+    case CPInfo::Type::UTF8:     return this->GetUTF8(index);
+    case CPInfo::Type::String:   
+    case CPInfo::Type::Class:    return this->GetConstNameOrTypeStr(this->GetFirstIndex(index));
 
-  if(ptr == nullptr)
-    return "UNINITIALIZED";
+    //TODO: implement for more types
+    default: return "";
+  }
+}
+
+ErrorOr<U16> ConstantPool::AddSlot(CPInfo::Type type, U64 slot)
+{
+  if (m_tags.size() >= MaxCount)
+    return Error::FromFormatStr("ConstantPool: can't add a constant, the pool already holds the maximum of %u entries", MaxCount);
 
-  if(ptr->GetType() == CPInfo::Type::UTF8)
+  m_tags.push_back(type);
+  m_slots.push_back(slot);
+
+  U16 index = static_cast<U16>(m_tags.size() - 1);
+
+  if (m_indexed)
+    this->AddToIndex(index);
+
+  return index;
+}
+
+ErrorOr<U16> ConstantPool::AddIndices(CPInfo::Type type, U16 first, U16 second)
+{
+  return this->AddSlot(type, packIndices(first, second));
+}
+
+Arena& ConstantPool::GetStringStorage()
+{
+  if (m_stringStorage == nullptr)
   {
-    auto utf8Info = static_cast<UTF8Info*>(ptr);
-    return utf8Info->String;
+    //most classes have a few KB of strings, so smaller blocks than the default
+    m_ownedStringStorage = std::make_unique<Arena>(4096);
+    m_stringStorage = m_ownedStringStorage.get();
   }
 
-  if(ptr->GetType() == CPInfo::Type::String)
+  return *m_stringStorage;
+}
+
+ErrorOr<U16> ConstantPool::AddUTF8Slot(std::string_view str)
+{
+  return this->AddUTF8View( this->GetStringStorage().CopyString(str) );
+}
+
+ErrorOr<U16> ConstantPool::AddUTF8View(std::string_view str)
+{
+  if (m_tags.size() >= MaxCount)
+    return Error::FromFormatStr("ConstantPool: can't add a constant, the pool already holds the maximum of %u entries", MaxCount);
+
+  m_utf8.push_back(str);
+  m_utf8AttributeTypes.push_back(static_cast<U8>(AttributeInfo::FindType(str)));
+  return this->AddSlot(CPInfo::Type::UTF8, m_utf8.size() - 1);
+}
+
+ErrorOr<void> ConstantPool::SetUTF8(U16 index, std::string_view str)
+{
+  if (!this->Is(index, CPInfo::Type::UTF8))
+    return Error::FromFormatStr("ConstantPool.SetUTF8(%u) failed because the constant at given index isn't a UTF8 constant", 
+        static_cast<unsigned int>(index));
+
+  if (index < m_infos.size())
+    m_infos[index].reset();
+
+  if (m_indexed)
   {
-    auto stringInfo = static_cast<StringInfo*>(ptr);
-    return this->GetConstNameOrTypeStr(stringInfo->StringIndex);
+    auto itr = m_utf8Index.find(this->GetUTF8(index));
+
+    if (itr != m_utf8Index.end() && itr->second == index)
+    {
+      m_utf8Index.erase(itr);
+
+      //another constant with the old value may now be the first one
+      std::string_view old = this->GetUTF8(index);
+      for (U16 i = index + 1; i < this->Count(); i++)
+      {
+        if (this->Is(i, CPInfo::Type::UTF8) && this->GetUTF8(i) == old)
+        {
+          m_utf8Index.emplace(old, i);
+          break;
+        }
+      }
+    }
   }
 
-  if(ptr->GetType() == CPInfo::Type::Class)
+  m_utf8[ static_cast<size_t>(m_slots[index]) ] = this->GetStringStorage().CopyString(str);
+  m_utf8AttributeTypes[ static_cast<size_t>(m_slots[index]) ] = static_cast<U8>(AttributeInfo::FindType(str));
+
+  if (m_indexed)
+    this->AddToIndex(index);
+
+  return {};
+}
+
+void ConstantPool::BuildIndex()
+{
+  m_valueIndex.reserve(m_tags.size());
+  m_utf8Index.reserve(m_utf8.size());
+
+  for (U16 i = 1; i < this->Count(); i++)
+    this->AddToIndex(i);
+
+  m_indexed = true;
+}
+
+void ConstantPool::AddToIndex(U16 index)
+{
+  //try_emplace keeps the first of equal constants
+  switch(m_tags[index])
   {
-    auto classInfo = static_cast<ClassInfo*>(ptr);
-    return this->GetConstNameOrTypeStr(classInfo->NameIndex);
+    case CPInfo::Type::Unusable: 
+      break;
+    case CPInfo::Type::UTF8:
+      m_utf8Index.try_emplace(this->GetUTF8(index), index);
+      break;
+    default:
+      m_valueIndex.try_emplace(ValueKey{ m_tags[index], m_slots[index] }, index);
+      break;
   }
+}
+
+U16 ConstantPool::Find(const CPInfo& info)
+{
+  if (info.GetType() == CPInfo::Type::UTF8)
+    return this->FindUTF8(static_cast<const UTF8Info&>(info).Get());
+
+  if (!m_indexed)
+    this->BuildIndex();
+
+  auto itr = m_valueIndex.find(ValueKey{ info.GetType(), toSlot(info) });
+  return itr != m_valueIndex.end() ? itr->second : 0;
+}
+
+U16 ConstantPool::FindUTF8(std::string_view str)
+{
+  if (!m_indexed)
+    this->BuildIndex();
+
+  auto itr = m_utf8Index.find(str);
+  return itr != m_utf8Index.end() ? itr->second : 0;
+}
 
-  //TODO: implement for more types
+ErrorOr<U16> ConstantPool::FindOrAddSlot(CPInfo::Type type, U64 slot)
+{
+  if (!m_indexed)
+    this->BuildIndex();
+
+  auto itr = m_valueIndex.find(ValueKey{ type, slot });
+  if (itr != m_valueIndex.end())
+    return itr->second;
+
+  bool isWide = type == CPInfo::Type::Long || type == CPInfo::Type::Double;
+
+  //both entries of a Long / Double are added or none of them
+  if (m_tags.size() + (isWide ? 2 : 1) > MaxCount)
+    return Error::FromFormatStr("ConstantPool: can't add a %.*s constant, the pool would exceed the maximum of %u entries", 
+        static_cast<int>(CPInfo::GetTypeName(type).size()), CPInfo::GetTypeName(type).data(), MaxCount);
+
+  auto errOrIndex = this->AddSlot(type, slot);
+  VERIFY(errOrIndex);
+
+  if (isWide)
+    TRY(this->AddSlot(CPInfo::Type::Unusable, 0));
+
+  return errOrIndex.Get();
+}
+
+ErrorOr<U16> ConstantPool::FindOrAdd(const CPInfo& info)
+{
+  if (info.GetType() == CPInfo::Type::UTF8)
+    return this->FindOrAddUTF8(static_cast<const UTF8Info&>(info).Get());
+
+  return this->FindOrAddSlot(info.GetType(), toSlot(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddUTF8(std::string_view str)
+{
+  U16 index = this->FindUTF8(str);
+
+  if (index != 0)
+    return index;
+
+  return this->AddUTF8Slot(str);
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddString(std::string_view str)
+{
+  auto errOrUTF8 = this->FindOrAddUTF8(str);
+  VERIFY(errOrUTF8);
+
+  return this->FindOrAddSlot(CPInfo::Type::String, errOrUTF8.Get());
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddClass(std::string_view name)
+{
+  auto errOrName = this->FindOrAddUTF8(name);
+  VERIFY(errOrName);
+
+  return this->FindOrAddSlot(CPInfo::Type::Class, errOrName.Get());
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddNameAndType(std::string_view name, std::string_view descriptor)
+{
+  auto errOrName = this->FindOrAddUTF8(name);
+  VERIFY(errOrName);
+
+  auto errOrDescriptor = this->FindOrAddUTF8(descriptor);
+  VERIFY(errOrDescriptor);
+
+  return this->FindOrAddSlot(CPInfo::Type::NameAndType, packIndices(errOrName.Get(), errOrDescriptor.Get()));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddMemberref(CPInfo::Type type, std::string_view className, std::string_view name, std::string_view descriptor)
+{
+  auto errOrClass = this->FindOrAddClass(className);
+  VERIFY(errOrClass);
+
+  auto errOrNameAndType = this->FindOrAddNameAndType(name, descriptor);
+  VERIFY(errOrNameAndType);
+
+  return this->FindOrAddSlot(type, packIndices(errOrClass.Get(), errOrNameAndType.Get()));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddFieldref(std::string_view className, std::string_view name, std::string_view descriptor)
+{
+  return this->FindOrAddMemberref(CPInfo::Type::Fieldref, className, name, descriptor);
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddMethodref(std::string_view className, std::string_view name, std::string_view descriptor)
+{
+  return this->FindOrAddMemberref(CPInfo::Type::Methodref, className, name, descriptor);
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddInterfaceMethodref(std::string_view className, std::string_view name, std::string_view descriptor)
+{
+  return this->FindOrAddMemberref(CPInfo::Type::InterfaceMethodref, className, name, descriptor);
+}
+
+ErrorOr<U16> ConstantPool::Add(const CPInfo& info)
+{
+  if (info.GetType() == CPInfo::Type::UTF8)
+    return this->AddUTF8Slot(static_cast<const UTF8Info&>(info).Get());
+
+  return this->AddSlot(info.GetType(), toSlot(info));
+}
+
+ErrorOr<void> ConstantPool::Add(ArenaPtr<CPInfo>&& info) 
+{
+  TRY(info != nullptr ? this->Add(*info) : this->AddSlot(CPInfo::Type::Unusable, 0));
+  return {};
+}
 
-  return "";
+ErrorOr<void> ConstantPool::Add(CPInfo* info) 
+{
+  return this->Add( ArenaPtr<CPInfo>{info} ); 
 }
 
-void ConstantPool::Add(std::unique_ptr<CPInfo>&& info) 
+template <class T>
+std::unique_ptr<CPInfo> ConstantPool::LoadInfo(U16 index) const
 {
-  m_pool.emplace_back(std::move(info));
+  auto info = std::make_unique<T>();
+  this->Load(index, *info);
+  return info;
 }
 
-void ConstantPool::Add(CPInfo* info) 
+const CPInfo* ConstantPool::GetInfo(U16 index) const
 {
-  m_pool.emplace_back( std::unique_ptr<CPInfo>{info} ); 
+  if (this->GetType(index) == CPInfo::Type::Unusable)
+    return nullptr;
+
+  if (m_infos.size() < m_tags.size())
+    m_infos.resize(m_tags.size());
+
+  std::unique_ptr<CPInfo>& info = m_infos[index];
+  if (info != nullptr)
+    return info.get();
+
+  switch (m_tags[index])
+  {
+    case CPInfo::Type::Class:              info = this->LoadInfo<ClassInfo>(index); break;
+    case CPInfo::Type::Fieldref:           info = this->LoadInfo<FieldrefInfo>(index); break;
+    case CPInfo::Type::Methodref:          info = this->LoadInfo<MethodrefInfo>(index); break;
+    case CPInfo::Type::InterfaceMethodref: info = this->LoadInfo<InterfaceMethodrefInfo>(index); break;
+    case CPInfo::Type::String:             info = this->LoadInfo<StringInfo>(index); break;
+    case CPInfo::Type::Integer:            info = this->LoadInfo<IntegerInfo>(index); break;
+    case CPInfo::Type::Float:              info = this->LoadInfo<FloatInfo>(index); break;
+    case CPInfo::Type::Long:               info = this->LoadInfo<LongInfo>(index); break;
+    case CPInfo::Type::Double:             info = this->LoadInfo<DoubleInfo>(index); break;
+    case CPInfo::Type::NameAndType:        info = this->LoadInfo<NameAndTypeInfo>(index); break;
+    case CPInfo::Type::UTF8:               info = this->LoadInfo<UTF8Info>(index); break;
+    case CPInfo::Type::MethodHandle:       info = this->LoadInfo<MethodHandleInfo>(index); break;
+    case CPInfo::Type::MethodType:         info = this->LoadInfo<MethodTypeInfo>(index); break;
+    case CPInfo::Type::InvokeDynamic:      info = this->LoadInfo<InvokeDynamicInfo>(index); break;
+    case CPInfo::Type::Unusable:           break;
+  }
+
+  return info.get();
 }
 
 U16 ConstantPool::Count() const
 {
-  return static_cast<U16>(m_pool.size());
+  return static_cast<U16>(m_tags.size());
+}
+
+void ConstantPool::Load(U16 index, ClassInfo& info) const
+{
+  info.NameIndex = this->GetFirstIndex(index);
+}
+
+void ConstantPool::Load(U16 index, FieldrefInfo& info) const
+{
+  info.ClassIndex = this->GetFirstIndex(index);
+  info.NameAndTypeIndex = this->GetSecondIndex(index);
+}
+
+void ConstantPool::Load(U16 index, MethodrefInfo& info) const
+{
+  info.ClassIndex = this->GetFirstIndex(index);
+  info.NameAndTypeIndex = this->GetSecondIndex(index);
+}
+
+void ConstantPool::Load(U16 index, InterfaceMethodrefInfo& info) const
+{
+  info.ClassIndex = this->GetFirstIndex(index);
+  info.NameAndTypeIndex = this->GetSecondIndex(index);
+}
+
+void ConstantPool::Load(U16 index, StringInfo& info) const
+{
+  info.StringIndex = this->GetFirstIndex(index);
+}
+
+void ConstantPool::Load(U16 index, IntegerInfo& info) const
+{
+  info.Bytes = this->GetU32(index);
+}
+
+void ConstantPool::Load(U16 index, FloatInfo& info) const
+{
+  info.Bytes = this->GetU32(index);
+}
+
+void ConstantPool::Load(U16 index, LongInfo& info) const
+{
+  info.HighBytes = static_cast<U32>(this->GetU64(index) >> 32);
+  info.LowBytes = static_cast<U32>(this->GetU64(index));
+}
+
+void ConstantPool::Load(U16 index, DoubleInfo& info) const
+{
+  info.HighBytes = static_cast<U32>(this->GetU64(index) >> 32);
+  info.LowBytes = static_cast<U32>(this->GetU64(index));
+}
+
+void ConstantPool::Load(U16 index, NameAndTypeInfo& info) const
+{
+  info.NameIndex = this->GetFirstIndex(index);
+  info.DescriptorIndex = this->GetSecondIndex(index);
+}
+
+void ConstantPool::Load(U16 index, UTF8Info& info) const
+{
+  info.SetView(this->GetUTF8(index));
+}
+
+void ConstantPool::Load(U16 index, MethodHandleInfo& info) const
+{
+  info.ReferenceKind = static_cast<U8>(this->GetFirstIndex(index));
+  info.ReferenceIndex = this->GetSecondIndex(index);
+}
+
+void ConstantPool::Load(U16 index, MethodTypeInfo& info) const
+{
+  info.DescriptorIndex = this->GetFirstIndex(index);
+}
+
+void ConstantPool::Load(U16 index, InvokeDynamicInfo& info) const
+{
+  info.BootstrapMethodAttrIndex = this->GetFirstIndex(index);
+  info.NameAndTypeIndex = this->GetSecondIndex(index);
 }
@@ -0,0 +1,283 @@
+#include "FileFormats/JVM/ControlFlowGraph.hpp"
+
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <limits>
+
+using namespace FileFormats;
+using namespace FileFormats::JVM;
+
+ErrorOr<ControlFlowGraph> ControlFlowGraph::Build(const CodeAttribute& attr)
+{
+  ControlFlowGraph cfg;
+  ControlFlowGraphBuilder builder;
+
+  TRY(builder.Build(attr, cfg));
+  return cfg;
+}
+
+std::optional<U32> ControlFlowGraph::GetBlockIndex(U32 pc) const
+{
+  if (m_blocks.empty() || pc >= m_blocks.back().EndPC)
+    return std::nullopt;
+
+  auto itr = std::upper_bound(m_blocks.begin(), m_blocks.end(), pc,
+      [](U32 pc, const BasicBlock& block) { return pc < block.StartPC; });
+
+  return static_cast<U32>(itr - m_blocks.begin() - 1);
+}
+
+ErrorOr<void> ControlFlowGraphBuilder::Build(const CodeAttribute& attr, ControlFlowGraph& cfg)
+{
+  cfg.m_blocks.clear();
+  cfg.m_successors.clear();
+  cfg.m_predecessors.clear();
+
+  TRY(this->FindLeaders(attr));
+
+  this->CreateBlocks(attr, cfg);
+  this->CreateEdges(attr, cfg);
+
+  return {};
+}
+
+ErrorOr<void> ControlFlowGraphBuilder::AddBranchTarget(U32 pc, S64 target, U32 codeLength)
+{
+  if (target < 0 || target >= codeLength)
+    return Error::FromFormatStr("ControlFlowGraph: branch at code offset %u targets %lld, which is outside of the code",
+        pc, static_cast<long long>(target));
+
+  m_edges.push_back({ pc, static_cast<U32>(target), CFGEdge::Type::Branch });
+  return {};
+}
+
+//Marks the instruction starts & block leaders and collects the branch edges
+ErrorOr<void> ControlFlowGraphBuilder::FindLeaders(const CodeAttribute& attr)
+{
+  U32 codeLength = attr.GetCodeLength();
+
+  m_pcFlags.assign(codeLength + 1, 0);
+  m_edges.clear();
+
+  if (codeLength == 0)
+    return {};
+
+  m_pcFlags[0] |= PCF_LEADER;
+
+  for (InstructionView instr : attr.Code)
+  {
+    U32 pc = instr.GetOffset();
+    const OpCodeInfo& info = instr.GetInfo();
+
+    m_pcFlags[pc] |= PCF_INSTRUCTION;
+
+    if (info.IsSwitch())
+    {
+      const U8* operands = instr.GetBytes().data() + 1 + GetSwitchPadding(pc);
+
+      TRY(this->AddBranchTarget(pc, S64{pc} + LoadBigEndian<S32>(operands), codeLength));
+
+      if (instr.GetOpCode() == OP_TABLESWITCH)
+      {
+        S64 count = S64{LoadBigEndian<S32>(operands + 8)} - LoadBigEndian<S32>(operands + 4) + 1;
+        BigEndianArrayView<S32> offsets{ operands + 12, static_cast<size_t>(count) };
+
+        for (size_t i = 0; i < offsets.Size(); i++)
+          TRY(this->AddBranchTarget(pc, S64{pc} + offsets[i], codeLength));
+      }
+      else
+      {
+        size_t nPairs = static_cast<size_t>(LoadBigEndian<S32>(operands + 4));
+        BigEndianArrayView<S32> pairs{ operands + 8, nPairs * 2 };
+
+        for (size_t i = 0; i < nPairs; i++)
+          TRY(this->AddBranchTarget(pc, S64{pc} + pairs[i * 2 + 1], codeLength));
+      }
+    }
+    else if (info.IsBranch())
+    {
+      S32 offset = info.Layout == OperandLayout::SInt ? instr.GetOperand<S32>() : instr.GetOperand<S16>();
+      TRY(this->AddBranchTarget(pc, S64{pc} + offset, codeLength));
+    }
+
+    if (info.IsBranch() || !info.CanFallThrough())
+      m_pcFlags[pc + instr.GetLength()] |= PCF_LEADER;
+  }
+
+  for (const PendingEdge& edge : m_edges)
+  {
+    if (!(m_pcFlags[edge.To] & PCF_INSTRUCTION))
+      return Error::FromFormatStr("ControlFlowGraph: branch at code offset %u targets %u, which is not the start of an instruction",
+          edge.From, edge.To);
+
+    m_pcFlags[edge.To] |= PCF_LEADER;
+  }
+
+  for (const auto& handler : attr.ExceptionTable)
+  {
+    bool validRange = handler.StartPC < handler.EndPC && handler.EndPC <= codeLength
+      && (m_pcFlags[handler.StartPC] & PCF_INSTRUCTION)
+      && (handler.EndPC == codeLength || (m_pcFlags[handler.EndPC] & PCF_INSTRUCTION));
+
+    if (!validRange)
+      return Error::FromFormatStr("ControlFlowGraph: exception handler range [%u, %u) is invalid",
+          handler.StartPC, handler.EndPC);
+
+    if (handler.HandlerPC >= codeLength || !(m_pcFlags[handler.HandlerPC] & PCF_INSTRUCTION))
+      return Error::FromFormatStr("ControlFlowGraph: exception handler at code offset %u is not the start of an instruction",
+          handler.HandlerPC);
+
+    m_pcFlags[handler.StartPC] |= PCF_LEADER;
+    m_pcFlags[handler.EndPC] |= PCF_LEADER;
+    m_pcFlags[handler.HandlerPC] |= PCF_LEADER | PCF_HANDLER;
+  }
+
+  return {};
+}
+
+void ControlFlowGraphBuilder::CreateBlocks(const CodeAttribute& attr, ControlFlowGraph& cfg)
+{
+  U32 codeLength = attr.GetCodeLength();
+  auto& blocks = cfg.m_blocks;
+
+  m_blockOf.resize(codeLength);
+
+  U32 lastInstruction{0};
+
+  for (U32 pc = 0; pc < codeLength; pc++)
+  {
+    U8 flags = m_pcFlags[pc];
+
+    if (flags & PCF_LEADER)
+    {
+      if (!blocks.empty())
+      {
+        blocks.back().EndPC = pc;
+        blocks.back().LastInstructionPC = lastInstruction;
+      }
+
+      BasicBlock block{};
+      block.StartPC = pc;
+      block.IsExceptionHandler = flags & PCF_HANDLER;
+
+      blocks.push_back(block);
+    }
+
+    if (flags & PCF_INSTRUCTION)
+      lastInstruction = pc;
+
+    m_blockOf[pc] = static_cast<U32>(blocks.size() - 1);
+  }
+
+  if (!blocks.empty())
+  {
+    blocks.back().EndPC = codeLength;
+    blocks.back().LastInstructionPC = lastInstruction;
+  }
+}
+
+void ControlFlowGraphBuilder::CreateEdges(const CodeAttribute& attr, ControlFlowGraph& cfg)
+{
+  U32 codeLength = attr.GetCodeLength();
+  auto& blocks = cfg.m_blocks;
+  U32 blockCount = static_cast<U32>(blocks.size());
+
+  std::span<const U8> code = attr.Code.GetBytes();
+
+  //the branch edges collected so far reference pcs
+  for (PendingEdge& edge : m_edges)
+  {
+    edge.From = m_blockOf[edge.From];
+    edge.To = m_blockOf[edge.To];
+  }
+
+  for (U32 i = 0; i < blockCount; i++)
+  {
+    const BasicBlock& block = blocks[i];
+
+    if (block.EndPC < codeLength && GetOpCodeInfo(code[block.LastInstructionPC]).CanFallThrough())
+      m_edges.push_back({ i, i + 1, CFGEdge::Type::FallThrough });
+  }
+
+  for (const auto& handler : attr.ExceptionTable)
+  {
+    U32 first = m_blockOf[handler.StartPC];
+    U32 end = handler.EndPC == codeLength ? blockCount : m_blockOf[handler.EndPC];
+    U32 handlerBlock = m_blockOf[handler.HandlerPC];
+
+    for (U32 i = first; i < end; i++)
+      m_edges.push_back({ i, handlerBlock, CFGEdge::Type::Exception });
+  }
+
+  //counting sort the edges by their source block...
+  auto& successors = cfg.m_successors;
+  successors.resize(m_edges.size());
+
+  m_counts.assign(blockCount + 1, 0);
+  for (const PendingEdge& edge : m_edges)
+    m_counts[edge.From + 1]++;
+
+  for (U32 i = 0; i < blockCount; i++)
+    m_counts[i + 1] += m_counts[i];
+
+  //...afterwards m_counts[i] = end of block i's edges = start of block i + 1's
+  for (const PendingEdge& edge : m_edges)
+    successors[m_counts[edge.From]++] = { edge.To, edge.EdgeType };
+
+  //...and drop duplicate successors (e.g. switch cases sharing a target),
+  //compacting in place
+  constexpr U32 NoBlock = std::numeric_limits<U32>::max();
+  m_stamps.assign(blockCount, NoBlock);
+
+  U32 written{0};
+  for (U32 i = 0; i < blockCount; i++)
+  {
+    U32 begin = i == 0 ? 0 : m_counts[i - 1];
+    U32 end = m_counts[i];
+
+    blocks[i].SuccessorsBegin = written;
+
+    for (U32 j = begin; j < end; j++)
+    {
+      CFGEdge edge = successors[j];
+      if (m_stamps[edge.Block] == i)
+        continue;
+
+      m_stamps[edge.Block] = i;
+      successors[written++] = edge;
+    }
+
+    blocks[i].SuccessorsEnd = written;
+  }
+
+  successors.resize(written);
+
+  //predecessors are the successors counting sorted by their target block
+  auto& predecessors = cfg.m_predecessors;
+  predecessors.resize(successors.size());
+
+  m_counts.assign(blockCount + 1, 0);
+  for (const CFGEdge& edge : successors)
+    m_counts[edge.Block + 1]++;
+
+  for (U32 i = 0; i < blockCount; i++)
+    m_counts[i + 1] += m_counts[i];
+
+  for (U32 i = 0; i < blockCount; i++)
+  {
+    blocks[i].PredecessorsBegin = m_counts[i];
+    blocks[i].PredecessorsEnd = m_counts[i + 1];
+
+    m_stamps[i] = m_counts[i]; //insert position
+  }
+
+  for (U32 i = 0; i < blockCount; i++)
+  {
+    for (U32 j = blocks[i].SuccessorsBegin; j < blocks[i].SuccessorsEnd; j++)
+    {
+      const CFGEdge& edge = successors[j];
+      predecessors[m_stamps[edge.Block]++] = { i, edge.EdgeType };
+    }
+  }
+}
@@ -0,0 +1,73 @@
+#include "FileFormats/JVM/Descriptor.hpp"
+
+#include "Util/Error.hpp"
+
+using namespace FileFormats;
+using namespace FileFormats::JVM;
+
+//the JVM limits arrays to 255 dimensions
+static constexpr size_t MaxArrayDimensions = 255;
+
+size_t FileFormats::JVM::GetFieldTypeLength(std::string_view str)
+{
+  size_t dimensions{0};
+  while (dimensions < str.size() && str[dimensions] == '[')
+    dimensions++;
+
+  if (dimensions == str.size() || dimensions > MaxArrayDimensions)
+    return 0;
+
+  switch (str[dimensions])
+  {
+    case 'B': case 'C': case 'D': case 'F': case 'I': case 'J': case 'S': case 'Z':
+      return dimensions + 1;
+
+    case 'L':
+    {
+      size_t end = str.find(';', dimensions + 1);
+
+      //the class name can't be empty
+      if (end == std::string_view::npos || end == dimensions + 1)
+        return 0;
+
+      return end + 1;
+    }
+  }
+
+  return 0;
+}
+
+ErrorOr<MethodDescriptor> MethodDescriptor::Parse(std::string_view descriptor)
+{
+  if (descriptor.empty() || descriptor[0] != '(')
+    return Error::FromFormatStr("MethodDescriptor: \"%.*s\" doesn't start with '('",
+        static_cast<int>(descriptor.size()), descriptor.data());
+
+  MethodDescriptor result;
+
+  size_t pos{1};
+  while (pos < descriptor.size() && descriptor[pos] != ')')
+  {
+    size_t length = GetFieldTypeLength(descriptor.substr(pos));
+    if (length == 0)
+      return Error::FromFormatStr("MethodDescriptor: \"%.*s\" has an invalid parameter type at %zu",
+          static_cast<int>(descriptor.size()), descriptor.data(), pos);
+
+    result.m_parameterCount++;
+    result.m_parameterSlots += length == 1 ? GetDescriptorSlotCount(descriptor[pos]) : 1;
+    pos += length;
+  }
+
+  if (pos == descriptor.size())
+    return Error::FromFormatStr("MethodDescriptor: \"%.*s\" is missing the ')'",
+        static_cast<int>(descriptor.size()), descriptor.data());
+
+  result.m_parameters = descriptor.substr(1, pos - 1);
+  result.m_returnType = descriptor.substr(pos + 1);
+
+  if (result.m_returnType != "V" && !IsValidFieldDescriptor(result.m_returnType))
+    return Error::FromFormatStr("MethodDescriptor: \"%.*s\" has an invalid return type",
+        static_cast<int>(descriptor.size()), descriptor.data());
+
+  return result;
+}
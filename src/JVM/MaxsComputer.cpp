@@ -0,0 +1,255 @@
+#include "FileFormats/JVM/MaxsComputer.hpp"
+#include "FileFormats/JVM/Descriptor.hpp"
+
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <limits>
+
+using namespace FileFormats;
+using namespace FileFormats::JVM;
+
+static constexpr U16 AccStatic = 0x0008;
+
+//local variable slots accessed by a load / store opcode
+static U32 getLocalSize(U8 opCode)
+{
+  switch (opCode)
+  {
+    case OP_LLOAD:  case OP_DLOAD:  case OP_LSTORE: case OP_DSTORE:
+      return 2;
+
+    default:
+      return 1;
+  }
+}
+
+ErrorOr<void> MaxsComputer::Update(ClassFile& classFile)
+{
+  for (auto& method : classFile.Methods)
+    TRY(this->Update(classFile.ConstPool, method));
+
+  return {};
+}
+
+ErrorOr<void> MaxsComputer::Update(const ConstantPool& constPool, FieldMethodInfo& method)
+{
+  for (auto& pAttr : method.Attributes)
+  {
+    auto errOrAttr = LazyAttribute::Resolve(*pAttr, constPool);
+    VERIFY(errOrAttr);
+
+    if (errOrAttr.Get().get().GetType() != AttributeInfo::Type::Code)
+      continue;
+
+    auto& code = static_cast<CodeAttribute&>(errOrAttr.Get().get());
+
+    auto errOrMaxs = this->Compute(constPool, method, code);
+    VERIFY(errOrMaxs);
+
+    if (code.MaxStack != errOrMaxs.Get().MaxStack || code.MaxLocals != errOrMaxs.Get().MaxLocals)
+    {
+      code.MaxStack = errOrMaxs.Get().MaxStack;
+      code.MaxLocals = errOrMaxs.Get().MaxLocals;
+      code.MarkModified();
+    }
+    break;
+  }
+
+  return {};
+}
+
+ErrorOr<CodeMaxs> MaxsComputer::Compute(const ConstantPool& constPool, const FieldMethodInfo& method, const CodeAttribute& code)
+{
+  auto errOrMaxStack = this->ComputeMaxStack(constPool, code);
+  VERIFY(errOrMaxStack);
+
+  auto errOrMaxLocals = this->ComputeMaxLocals(constPool, method, code);
+  VERIFY(errOrMaxLocals);
+
+  constexpr U32 limit = std::numeric_limits<U16>::max();
+
+  if (errOrMaxStack.Get() > limit || errOrMaxLocals.Get() > limit)
+    return Error::FromFormatStr("MaxsComputer: max_stack (%u) or max_locals (%u) exceeds 65535",
+        errOrMaxStack.Get(), errOrMaxLocals.Get());
+
+  return CodeMaxs{ static_cast<U16>(errOrMaxStack.Get()), static_cast<U16>(errOrMaxLocals.Get()) };
+}
+
+ErrorOr<U32> MaxsComputer::ComputeMaxLocals(const ConstantPool& constPool, const FieldMethodInfo& method, const CodeAttribute& code)
+{
+  if (!constPool.Is(method.DescriptorIndex, CPInfo::Type::UTF8))
+    return Error::FromFormatStr("MaxsComputer: the methods descriptor index %u isn't a UTF8 constant", method.DescriptorIndex);
+
+  auto errOrDescriptor = MethodDescriptor::Parse(constPool.GetUTF8(method.DescriptorIndex));
+  VERIFY(errOrDescriptor);
+
+  U32 maxLocals = errOrDescriptor.Get().GetParameterSlots() + ((method.AccessFlags & AccStatic) ? 0 : 1);
+
+  for (InstructionView instr : code.Code)
+  {
+    U8 opCode = instr.GetOpCode();
+    const U8* bytes = instr.GetBytes().data();
+
+    U32 end{0};
+
+    if ((opCode >= OP_ILOAD && opCode <= OP_ALOAD) || (opCode >= OP_ISTORE && opCode <= OP_ASTORE) || opCode == OP_RET)
+      end = bytes[1] + getLocalSize(opCode);
+    else if (opCode >= OP_ILOAD_0 && opCode <= OP_ALOAD_3)
+      end = (opCode - OP_ILOAD_0) % 4 + getLocalSize(OP_ILOAD + (opCode - OP_ILOAD_0) / 4);
+    else if (opCode >= OP_ISTORE_0 && opCode <= OP_ASTORE_3)
+      end = (opCode - OP_ISTORE_0) % 4 + getLocalSize(OP_ISTORE + (opCode - OP_ISTORE_0) / 4);
+    else if (opCode == OP_IINC)
+      end = bytes[1] + 1;
+    else if (opCode == OP_WIDE)
+      end = LoadBigEndian<U16>(bytes + 2) + getLocalSize(bytes[1]);
+
+    maxLocals = std::max(maxLocals, end);
+  }
+
+  return maxLocals;
+}
+
+ErrorOr<void> MaxsComputer::SetDepth(U32 block, U32 depth)
+{
+  if (m_depths[block] == Unknown)
+  {
+    m_depths[block] = depth;
+    m_worklist.push_back(block);
+  }
+  else if (m_depths[block] != depth)
+  {
+    return Error::FromFormatStr("MaxsComputer: the code at offset %u is reached with different stack depths (%u and %u)",
+        m_cfg.GetBlocks()[block].StartPC, m_depths[block], depth);
+  }
+
+  return {};
+}
+
+ErrorOr<U32> MaxsComputer::ComputeMaxStack(const ConstantPool& constPool, const CodeAttribute& code)
+{
+  TRY(m_cfgBuilder.Build(code, m_cfg));
+
+  U32 blockCount = static_cast<U32>(m_cfg.GetBlockCount());
+  if (blockCount == 0)
+    return U32{0};
+
+  m_depths.assign(blockCount, Unknown);
+  m_worklist.clear();
+
+  TRY(this->SetDepth(0, 0));
+
+  //handlers start with the exception as the only stack value
+  for (U32 i = 0; i < blockCount; i++)
+  {
+    if (m_cfg.GetBlocks()[i].IsExceptionHandler)
+      TRY(this->SetDepth(i, 1));
+  }
+
+  const U8* bytes = code.Code.GetBytes().data();
+  U32 maxStack{0};
+
+  while (!m_worklist.empty())
+  {
+    U32 block = m_worklist.back();
+    m_worklist.pop_back();
+
+    const BasicBlock& info = m_cfg.GetBlocks()[block];
+    U32 depth = m_depths[block];
+    maxStack = std::max(maxStack, depth);
+
+    for (U32 pc = info.StartPC; pc < info.EndPC; pc += Bytecode::GetLengthUnchecked(bytes, pc))
+    {
+      U8 opCode = bytes[pc];
+      const OpCodeInfo& opInfo = GetOpCodeInfo(opCode);
+
+      U32 pops = static_cast<U32>(opInfo.Pops);
+      U32 pushes = static_cast<U32>(opInfo.Pushes);
+
+      if (opInfo.Pops == VariableStackEffect || opInfo.Pushes == VariableStackEffect)
+      {
+        if (opCode == OP_WIDE)
+        {
+          U8 modified = bytes[pc + 1];
+          const OpCodeInfo& modifiedInfo = GetOpCodeInfo(modified);
+
+          pops = static_cast<U32>(modifiedInfo.Pops);
+          pushes = static_cast<U32>(modifiedInfo.Pushes);
+        }
+        else if (opCode == OP_MULTIANEWARRAY)
+          pops = bytes[pc + 3];
+        else
+          TRY(this->GetStackEffect(constPool, opCode, LoadBigEndian<U16>(bytes + pc + 1), pops, pushes));
+      }
+
+      if (pops > depth)
+        return Error::FromFormatStr("MaxsComputer: %s at offset %u underflows the operand stack",
+            GetOpCodeMnemonic(opCode).data(), pc);
+
+      depth = depth - pops + pushes;
+      maxStack = std::max(maxStack, depth);
+
+      //the instruction following a JSR is where its subroutine returns to,
+      //without the return address
+      if (opCode == OP_JSR || opCode == OP_JSR_W)
+      {
+        U32 next = pc + Bytecode::GetLengthUnchecked(bytes, pc);
+
+        if (next < code.GetCodeLength())
+          TRY(this->SetDepth(*m_cfg.GetBlockIndex(next), depth - 1));
+      }
+    }
+
+    for (const CFGEdge& edge : m_cfg.GetSuccessors(block))
+    {
+      if (edge.EdgeType != CFGEdge::Type::Exception)
+        TRY(this->SetDepth(edge.Block, depth));
+    }
+  }
+
+  return maxStack;
+}
+
+ErrorOr<void> MaxsComputer::GetStackEffect(const ConstantPool& constPool, U8 opCode, U16 index, U32& pops, U32& pushes)
+{
+  //all of them reference a NameAndType through their second index
+  bool isReference = constPool.Is(index, CPInfo::Type::Fieldref) || constPool.Is(index, CPInfo::Type::Methodref)
+    || constPool.Is(index, CPInfo::Type::InterfaceMethodref) || constPool.Is(index, CPInfo::Type::InvokeDynamic);
+
+  U16 nameAndType = isReference ? constPool.GetSecondIndex(index) : 0;
+
+  if (!constPool.Is(nameAndType, CPInfo::Type::NameAndType)
+      || !constPool.Is(constPool.GetSecondIndex(nameAndType), CPInfo::Type::UTF8))
+    return Error::FromFormatStr("MaxsComputer: %s references constant %u, which isn't a valid field, method or invokedynamic reference",
+        GetOpCodeMnemonic(opCode).data(), index);
+
+  std::string_view descriptor = constPool.GetUTF8(constPool.GetSecondIndex(nameAndType));
+
+  if (GetOpCodeInfo(opCode).IsFieldAccess())
+  {
+    if (!IsValidFieldDescriptor(descriptor))
+      return Error::FromFormatStr("MaxsComputer: %s references a field with an invalid descriptor",
+          GetOpCodeMnemonic(opCode).data());
+
+    U32 slots = GetDescriptorSlotCount(descriptor[0]);
+
+    switch (opCode)
+    {
+      case OP_GETSTATIC: pops = 0;         pushes = slots; break;
+      case OP_PUTSTATIC: pops = slots;     pushes = 0;     break;
+      case OP_GETFIELD:  pops = 1;         pushes = slots; break;
+      case OP_PUTFIELD:  pops = slots + 1; pushes = 0;     break;
+    }
+
+    return {};
+  }
+
+  auto errOrDescriptor = MethodDescriptor::Parse(descriptor);
+  VERIFY(errOrDescriptor);
+
+  bool hasReceiver = opCode != OP_INVOKESTATIC && opCode != OP_INVOKEDYNAMIC;
+
+  pops = errOrDescriptor.Get().GetParameterSlots() + (hasReceiver ? 1 : 0);
+  pushes = errOrDescriptor.Get().GetReturnSlots();
+  return {};
+}
@@ -0,0 +1,781 @@
+#include "FileFormats/JVM/PeepholeOptimizer.hpp"
+
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <limits>
+
+using namespace FileFormats;
+using namespace FileFormats::JVM;
+
+//ILOAD_0 -> ILOAD, ..., ASTORE_3 -> ASTORE, other opcodes as they are
+static U8 getLongForm(U8 opCode)
+{
+  if (opCode >= OP_ILOAD_0 && opCode <= OP_ALOAD_3)
+    return static_cast<U8>(OP_ILOAD + (opCode - OP_ILOAD_0) / 4);
+
+  if (opCode >= OP_ISTORE_0 && opCode <= OP_ASTORE_3)
+    return static_cast<U8>(OP_ISTORE + (opCode - OP_ISTORE_0) / 4);
+
+  return opCode;
+}
+
+static bool isLoad(U8 opCode)
+{
+  U8 longForm = getLongForm(opCode);
+  return longForm >= OP_ILOAD && longForm <= OP_ALOAD;
+}
+
+static bool isStore(U8 opCode)
+{
+  U8 longForm = getLongForm(opCode);
+  return longForm >= OP_ISTORE && longForm <= OP_ASTORE;
+}
+
+//local variable slots accessed by a load / store
+static U32 getLocalSize(U8 opCode)
+{
+  switch (getLongForm(opCode))
+  {
+    case OP_LLOAD:  case OP_DLOAD:  case OP_LSTORE: case OP_DSTORE:
+      return 2;
+
+    default:
+      return 1;
+  }
+}
+
+//pushes a constant without side effects
+static bool isConstantPush(const ConstantPool& constPool, const PeepholeInstruction& instr)
+{
+  switch (instr.OpCode)
+  {
+    case OP_LDC: case OP_LDC_W:
+      return constPool.Is(instr.Operand, CPInfo::Type::Integer) || constPool.Is(instr.Operand, CPInfo::Type::Float)
+        || constPool.Is(instr.Operand, CPInfo::Type::String);
+
+    case OP_LDC2_W:
+      return constPool.Is(instr.Operand, CPInfo::Type::Long) || constPool.Is(instr.Operand, CPInfo::Type::Double);
+
+    case OP_BIPUSH: case OP_SIPUSH:
+      return true;
+
+    default:
+      return instr.OpCode >= OP_ACONST_NULL && instr.OpCode <= OP_DCONST_1;
+  }
+}
+
+//Sets the offset delta of a frame, switching between the compact and the
+//extended form of Same / SameLocals1StackItem frames as needed
+static void setOffsetDelta(StackMapFrame& frame, U16 delta)
+{
+  switch (frame.GetKind())
+  {
+    case StackMapFrame::Kind::Same:
+    case StackMapFrame::Kind::SameExtended:
+      frame.FrameType = delta < 64 ? static_cast<U8>(delta) : 251;
+      break;
+
+    case StackMapFrame::Kind::SameLocals1StackItem:
+    case StackMapFrame::Kind::SameLocals1StackItemExtended:
+      frame.FrameType = delta < 64 ? static_cast<U8>(64 + delta) : 247;
+      break;
+
+    default:
+      break;
+  }
+
+  frame.OffsetDelta = delta;
+}
+
+U32 PeepholeContext::GetNext(U32 index) const
+{
+  U32 count = static_cast<U32>(m_instructions.size());
+
+  index++;
+  while (index < count && m_instructions[index].IsRemoved)
+    index++;
+
+  return index;
+}
+
+bool ShortLocalFormsPass::Apply(PeepholeContext& context, U32 index)
+{
+  PeepholeInstruction& instr = context.GetInstructions()[index];
+
+  if (instr.Operand > 3)
+    return false;
+
+  if (instr.OpCode >= OP_ILOAD && instr.OpCode <= OP_ALOAD)
+    instr.OpCode = static_cast<U8>(OP_ILOAD_0 + (instr.OpCode - OP_ILOAD) * 4 + instr.Operand);
+  else if (instr.OpCode >= OP_ISTORE && instr.OpCode <= OP_ASTORE)
+    instr.OpCode = static_cast<U8>(OP_ISTORE_0 + (instr.OpCode - OP_ISTORE) * 4 + instr.Operand);
+  else
+    return false;
+
+  return true;
+}
+
+bool NarrowLdcPass::Apply(PeepholeContext& context, U32 index)
+{
+  PeepholeInstruction& instr = context.GetInstructions()[index];
+
+  if (instr.OpCode != OP_LDC_W || instr.Operand > std::numeric_limits<U8>::max())
+    return false;
+
+  instr.OpCode = OP_LDC;
+  return true;
+}
+
+bool GotoChainPass::Apply(PeepholeContext& context, U32 index)
+{
+  auto instructions = context.GetInstructions();
+  PeepholeInstruction& instr = instructions[index];
+  const OpCodeInfo& info = GetOpCodeInfo(instr.OpCode);
+
+  if (!info.IsBranch() || info.IsSwitch() || info.IsSubroutine())
+    return false;
+
+  auto isGoto = [](const PeepholeInstruction& target)
+  {
+    return !target.IsRemoved && (target.OpCode == OP_GOTO || target.OpCode == OP_GOTO_W);
+  };
+
+  //bounded, as GOTOs can form a cycle
+  U32 target = instr.Operand;
+  for (size_t steps = 0; steps < instructions.size() && isGoto(instructions[target]); steps++)
+    target = instructions[target].Operand;
+
+  if (target == instr.Operand)
+    return false;
+
+  instr.Operand = target;
+  return true;
+}
+
+bool RemoveNopsPass::Apply(PeepholeContext& context, U32 index)
+{
+  PeepholeInstruction& instr = context.GetInstructions()[index];
+
+  if (instr.OpCode != OP_NOP || instr.IsTarget)
+    return false;
+
+  instr.IsRemoved = true;
+  return true;
+}
+
+bool DeadConstantStorePass::Apply(PeepholeContext& context, U32 index)
+{
+  auto instructions = context.GetInstructions();
+  PeepholeInstruction& push = instructions[index];
+
+  if (context.HasStackMapTable() || push.IsTarget || !isConstantPush(context.GetConstantPool(), push))
+    return false;
+
+  U32 next = context.GetNext(index);
+  if (next == instructions.size())
+    return false;
+
+  PeepholeInstruction& store = instructions[next];
+  if (store.IsTarget || !isStore(store.OpCode))
+    return false;
+
+  for (U32 slot = 0; slot < getLocalSize(store.OpCode); slot++)
+  {
+    if (context.IsLocalRead(store.Operand + slot))
+      return false;
+  }
+
+  push.IsRemoved = true;
+  store.IsRemoved = true;
+  return true;
+}
+
+void PeepholeOptimizer::AddPass(std::unique_ptr<PeepholePass> pass)
+{
+  m_passes.push_back(std::move(pass));
+}
+
+void PeepholeOptimizer::AddDefaultPasses()
+{
+  //dead stores are found before their store gets its short form, which
+  //doesn't matter, and before the GOTOs they jump over are folded, which
+  //doesn't either
+  this->AddPass(std::make_unique<RemoveNopsPass>());
+  this->AddPass(std::make_unique<GotoChainPass>());
+  this->AddPass(std::make_unique<DeadConstantStorePass>());
+  this->AddPass(std::make_unique<NarrowLdcPass>());
+  this->AddPass(std::make_unique<ShortLocalFormsPass>());
+}
+
+ErrorOr<void> PeepholeOptimizer::Optimize(ClassFile& classFile)
+{
+  for (auto& method : classFile.Methods)
+  {
+    for (auto& pAttr : method.Attributes)
+    {
+      //don't decode lazy attributes that can't be code
+      if (pAttr->GetType() == AttributeInfo::Type::Lazy &&
+          static_cast<const LazyAttribute&>(*pAttr).GetBodyType() != AttributeInfo::Type::Code)
+        continue;
+
+      auto errOrAttr = LazyAttribute::Resolve(*pAttr, classFile.ConstPool);
+      VERIFY(errOrAttr);
+
+      if (errOrAttr.Get().get().GetType() != AttributeInfo::Type::Code)
+        continue;
+
+      TRY(this->Optimize(classFile.ConstPool, static_cast<CodeAttribute&>(errOrAttr.Get().get())));
+      break;
+    }
+  }
+
+  return {};
+}
+
+ErrorOr<bool> PeepholeOptimizer::Optimize(const ConstantPool& constPool, CodeAttribute& code)
+{
+  m_context.m_constPool = &constPool;
+
+  auto errOrSupported = this->CollectAttributes(constPool, code);
+  VERIFY(errOrSupported);
+
+  if (!errOrSupported.Get())
+    return false;
+
+  TRY(this->Decode(code));
+
+  auto& instructions = m_context.m_instructions;
+  U32 count = static_cast<U32>(instructions.size());
+
+  bool changed{false};
+
+  for (U32 i = 0; i < count; i++)
+  {
+    for (auto& pass : m_passes)
+    {
+      if (instructions[i].IsRemoved)
+        break;
+
+      changed |= pass->Apply(m_context, i);
+    }
+  }
+
+  if (!changed)
+    return false;
+
+  //every referenced instruction gets a label, before any of them is bound
+  m_builder.Reset();
+  m_labels.assign(count + 1, NoLabel);
+
+  for (U32 i = 0; i < count; i++)
+  {
+    const OpCodeInfo& info = GetOpCodeInfo(instructions[i].OpCode);
+
+    if (instructions[i].IsRemoved || !info.IsBranch())
+      continue;
+
+    if (!info.IsSwitch())
+    {
+      this->GetLabel(instructions[i].Operand);
+      continue;
+    }
+
+    const U8* bytes = code.Code.GetBytes().data();
+    U32 pc = instructions[i].PC;
+    const U8* operands = bytes + pc + 1 + GetSwitchPadding(pc);
+
+    this->GetLabel(this->GetInstructionIndex(pc + LoadBigEndian<S32>(operands)));
+
+    U32 caseCount = instructions[i].OpCode == OP_TABLESWITCH
+      ? static_cast<U32>(LoadBigEndian<S32>(operands + 8) - LoadBigEndian<S32>(operands + 4) + 1)
+      : LoadBigEndian<U32>(operands + 4);
+
+    for (U32 j = 0; j < caseCount; j++)
+    {
+      S32 offset = instructions[i].OpCode == OP_TABLESWITCH
+        ? LoadBigEndian<S32>(operands + 12 + j * 4)
+        : LoadBigEndian<S32>(operands + 12 + j * 8);
+
+      this->GetLabel(this->GetInstructionIndex(pc + offset));
+    }
+  }
+
+  for (const auto& handler : code.ExceptionTable)
+  {
+    m_builder.AddExceptionHandler(this->GetLabel(this->GetInstructionIndex(handler.StartPC)),
+        this->GetLabel(this->GetInstructionIndex(handler.EndPC)),
+        this->GetLabel(this->GetInstructionIndex(handler.HandlerPC)), handler.CatchType);
+  }
+
+  for (U32 index : m_frameOffsets)
+    this->GetLabel(index);
+
+  for (U32 index : m_uninitializedOffsets)
+    this->GetLabel(index);
+
+  for (LineNumberTableAttribute* pTable : m_lineNumberTables)
+  {
+    for (const auto& entry : pTable->LineNumbers)
+      this->GetLabel(this->GetInstructionIndex(entry.StartPC));
+  }
+
+  for (std::vector<LocalVariable>* pTable : m_localVariableTables)
+  {
+    for (const auto& var : *pTable)
+    {
+      this->GetLabel(this->GetInstructionIndex(var.StartPC));
+      this->GetLabel(this->GetInstructionIndex(var.StartPC + var.Length));
+    }
+  }
+
+  for (U32 i = 0; i < count; i++)
+    this->Emit(code, i);
+
+  if (m_labels[count] != NoLabel)
+    m_builder.Bind(Label{ m_labels[count] });
+
+  //an inverted branch makes the instruction after its GOTO_W a branch target,
+  //whose frame can't be derived from the existing ones, keep the code then
+  if (!m_stackMapTables.empty())
+  {
+    auto errOrInverts = m_builder.InvertsBranches();
+    VERIFY(errOrInverts);
+
+    if (errOrInverts.Get())
+      return false;
+  }
+
+  TRY(m_builder.Build(code));
+
+  //all of the codes attributes reference offsets, which are remapped below
+  for (auto& pAttr : code.Attributes)
+    pAttr->MarkModified();
+
+  //the frames & tables were validated while decoding
+  size_t frame{0}, uninitialized{0};
+  for (StackMapTableAttribute* pTable : m_stackMapTables)
+  {
+    U32 previousPC{0};
+
+    for (size_t i = 0; i < pTable->Frames.size(); i++, frame++)
+    {
+      U32 pc = this->GetNewPC(m_frameOffsets[frame]);
+      setOffsetDelta(pTable->Frames[i], static_cast<U16>(i == 0 ? pc : pc - previousPC - 1));
+      previousPC = pc;
+    }
+
+    for (auto& type : pTable->Types)
+    {
+      if (type.TypeTag == VerificationType::Tag::Uninitialized)
+        type.Data = static_cast<U16>(this->GetNewPC(m_uninitializedOffsets[uninitialized++]));
+    }
+  }
+
+  for (LineNumberTableAttribute* pTable : m_lineNumberTables)
+  {
+    for (auto& entry : pTable->LineNumbers)
+      entry.StartPC = static_cast<U16>(this->GetNewPC(this->GetInstructionIndex(entry.StartPC)));
+  }
+
+  for (std::vector<LocalVariable>* pTable : m_localVariableTables)
+  {
+    for (auto& var : *pTable)
+    {
+      U32 newStartPC = this->GetNewPC(this->GetInstructionIndex(var.StartPC));
+      U32 newEndPC = this->GetNewPC(this->GetInstructionIndex(var.StartPC + var.Length));
+
+      var.StartPC = static_cast<U16>(newStartPC);
+      var.Length = static_cast<U16>(newEndPC - newStartPC);
+    }
+  }
+
+  return true;
+}
+
+//Collects the attributes of the code that reference offsets, false if it has
+//one that can't be remapped
+ErrorOr<bool> PeepholeOptimizer::CollectAttributes(const ConstantPool& constPool, CodeAttribute& code)
+{
+  m_stackMapTables.clear();
+  m_lineNumberTables.clear();
+  m_localVariableTables.clear();
+
+  for (auto& pAttr : code.Attributes)
+  {
+    auto errOrAttr = LazyAttribute::Resolve(*pAttr, constPool);
+    VERIFY(errOrAttr);
+
+    AttributeInfo& attr = errOrAttr.Get().get();
+
+    switch (attr.GetType())
+    {
+      case AttributeInfo::Type::StackMapTable:
+        m_stackMapTables.push_back(&static_cast<StackMapTableAttribute&>(attr));
+        break;
+
+      case AttributeInfo::Type::LineNumberTable:
+        m_lineNumberTables.push_back(&static_cast<LineNumberTableAttribute&>(attr));
+        break;
+
+      case AttributeInfo::Type::LocalVariableTable:
+        m_localVariableTables.push_back(&static_cast<LocalVariableTableAttribute&>(attr).LocalVariables);
+        break;
+
+      case AttributeInfo::Type::LocalVariableTypeTable:
+        m_localVariableTables.push_back(&static_cast<LocalVariableTypeTableAttribute&>(attr).LocalVariableTypes);
+        break;
+
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+ErrorOr<void> PeepholeOptimizer::Decode(const CodeAttribute& code)
+{
+  auto& instructions = m_context.m_instructions;
+  instructions.clear();
+
+  const U8* bytes = code.Code.GetBytes().data();
+  m_codeLength = code.GetCodeLength();
+
+  for (InstructionView view : code.Code)
+  {
+    PeepholeInstruction instr{};
+    instr.PC = view.GetOffset();
+    instr.OpCode = view.GetOpCode();
+
+    const U8* operands = view.GetBytes().data() + 1;
+
+    switch (view.GetOperandLayout())
+    {
+      case OperandLayout::None:
+        if (isLoad(instr.OpCode) || isStore(instr.OpCode))
+          instr.Operand = instr.OpCode >= OP_ISTORE_0 ? (instr.OpCode - OP_ISTORE_0) % 4 : (instr.OpCode - OP_ILOAD_0) % 4;
+        break;
+
+      case OperandLayout::UByte:
+        instr.Operand = operands[0];
+        break;
+
+      case OperandLayout::SByte:
+      case OperandLayout::AType:
+        instr.Value = instr.OpCode == OP_BIPUSH ? static_cast<S8>(operands[0]) : operands[0];
+        break;
+
+      case OperandLayout::UShort:
+      case OperandLayout::InvokeDynamic:
+        instr.Operand = LoadBigEndian<U16>(operands);
+        break;
+
+      //branch targets are stored as offsets until all instructions are known
+      case OperandLayout::SShort:
+        if (view.GetInfo().IsBranch())
+          instr.Operand = static_cast<U32>(instr.PC + LoadBigEndian<S16>(operands));
+        else
+          instr.Value = LoadBigEndian<S16>(operands);
+        break;
+
+      case OperandLayout::SInt:
+        instr.Operand = static_cast<U32>(instr.PC + LoadBigEndian<S32>(operands));
+        break;
+
+      case OperandLayout::IInc:
+        instr.Operand = operands[0];
+        instr.Value = static_cast<S8>(operands[1]);
+        break;
+
+      case OperandLayout::MultiANewArray:
+      case OperandLayout::InvokeInterface:
+        instr.Operand = LoadBigEndian<U16>(operands);
+        instr.Value = operands[2];
+        break;
+
+      case OperandLayout::Wide:
+        instr.OpCode = operands[0];
+        instr.Operand = LoadBigEndian<U16>(operands + 1);
+
+        if (instr.OpCode == OP_IINC)
+          instr.Value = LoadBigEndian<S16>(operands + 3);
+        break;
+
+      default:
+        break;
+    }
+
+    instructions.push_back(instr);
+  }
+
+  auto markTarget = [&](U32 pc, U32 from) -> ErrorOr<U32>
+  {
+    U32 index = this->GetInstructionIndex(pc);
+
+    if (index == NoLabel || index == instructions.size())
+      return Error::FromFormatStr("PeepholeOptimizer: the instruction at offset %u references offset %u, which isn't an instruction",
+          from, pc);
+
+    instructions[index].IsTarget = true;
+    return index;
+  };
+
+  for (auto& instr : instructions)
+  {
+    const OpCodeInfo& info = GetOpCodeInfo(instr.OpCode);
+
+    if (info.IsSwitch())
+    {
+      const U8* operands = bytes + instr.PC + 1 + GetSwitchPadding(instr.PC);
+      TRY(markTarget(instr.PC + LoadBigEndian<S32>(operands), instr.PC));
+
+      if (instr.OpCode == OP_TABLESWITCH)
+      {
+        S64 caseCount = S64{LoadBigEndian<S32>(operands + 8)} - LoadBigEndian<S32>(operands + 4) + 1;
+
+        for (S64 j = 0; j < caseCount; j++)
+          TRY(markTarget(instr.PC + LoadBigEndian<S32>(operands + 12 + j * 4), instr.PC));
+      }
+      else
+      {
+        for (U32 j = 0; j < LoadBigEndian<U32>(operands + 4); j++)
+          TRY(markTarget(instr.PC + LoadBigEndian<S32>(operands + 12 + j * 8), instr.PC));
+      }
+    }
+    else if (info.IsBranch())
+    {
+      auto errOrIndex = markTarget(instr.Operand, instr.PC);
+      VERIFY(errOrIndex);
+
+      instr.Operand = errOrIndex.Get();
+    }
+  }
+
+  for (const auto& handler : code.ExceptionTable)
+  {
+    if (this->GetInstructionIndex(handler.EndPC) == NoLabel)
+      return Error::FromFormatStr("PeepholeOptimizer: exception handler range end %u isn't an instruction", handler.EndPC);
+
+    TRY(markTarget(handler.StartPC, handler.StartPC));
+    TRY(markTarget(handler.HandlerPC, handler.StartPC));
+  }
+
+  m_frameOffsets.clear();
+  m_uninitializedOffsets.clear();
+  for (StackMapTableAttribute* pTable : m_stackMapTables)
+  {
+    U32 pc{0};
+
+    for (size_t i = 0; i < pTable->Frames.size(); i++)
+    {
+      pc = i == 0 ? pTable->Frames[i].OffsetDelta : pc + pTable->Frames[i].OffsetDelta + 1;
+
+      auto errOrIndex = markTarget(pc, pc);
+      VERIFY(errOrIndex);
+
+      m_frameOffsets.push_back(errOrIndex.Get());
+    }
+
+    //Uninitialized types hold the offset of their NEW instruction
+    for (const auto& type : pTable->Types)
+    {
+      if (type.TypeTag != VerificationType::Tag::Uninitialized)
+        continue;
+
+      U32 index = this->GetInstructionIndex(type.Data);
+
+      if (index == NoLabel || index == instructions.size() || instructions[index].OpCode != OP_NEW)
+        return Error::FromFormatStr("PeepholeOptimizer: a stack map frame references offset %u as the NEW of an "
+            "uninitialized object, which isn't a NEW instruction", U32{type.Data});
+
+      instructions[index].IsTarget = true;
+      m_uninitializedOffsets.push_back(index);
+    }
+  }
+
+  auto checkRange = [&](U32 startPC, U32 endPC) -> ErrorOr<void>
+  {
+    if (this->GetInstructionIndex(startPC) == instructions.size() || this->GetInstructionIndex(startPC) == NoLabel
+        || this->GetInstructionIndex(endPC) == NoLabel)
+      return Error::FromFormatStr("PeepholeOptimizer: a debug table references offset %u, which isn't an instruction", startPC);
+
+    return {};
+  };
+
+  for (LineNumberTableAttribute* pTable : m_lineNumberTables)
+  {
+    for (const auto& entry : pTable->LineNumbers)
+      TRY(checkRange(entry.StartPC, entry.StartPC));
+  }
+
+  for (std::vector<LocalVariable>* pTable : m_localVariableTables)
+  {
+    for (const auto& var : *pTable)
+      TRY(checkRange(var.StartPC, U32{var.StartPC} + var.Length));
+  }
+
+  auto& readLocals = m_context.m_readLocals;
+  readLocals.assign(code.MaxLocals + 1, 0);
+
+  for (const auto& instr : instructions)
+  {
+    if (!isLoad(instr.OpCode) && instr.OpCode != OP_IINC && instr.OpCode != OP_RET)
+      continue;
+
+    for (U32 slot = 0; slot < getLocalSize(instr.OpCode); slot++)
+    {
+      if (instr.Operand + slot >= readLocals.size())
+        readLocals.resize(instr.Operand + slot + 1, 0);
+
+      readLocals[instr.Operand + slot] = 1;
+    }
+  }
+
+  m_context.m_hasStackMapTable = !m_stackMapTables.empty();
+  return {};
+}
+
+//Index of the instruction at pc, the instruction count for the end of the
+//code, NoLabel if pc isn't the start of an instruction
+U32 PeepholeOptimizer::GetInstructionIndex(U32 pc) const
+{
+  const auto& instructions = m_context.m_instructions;
+
+  auto itr = std::lower_bound(instructions.begin(), instructions.end(), pc,
+      [](const PeepholeInstruction& instr, U32 pc) { return instr.PC < pc; });
+
+  if (itr == instructions.end())
+    return pc == m_codeLength ? static_cast<U32>(instructions.size()) : NoLabel;
+
+  return itr->PC == pc ? static_cast<U32>(itr - instructions.begin()) : NoLabel;
+}
+
+Label PeepholeOptimizer::GetLabel(U32 index)
+{
+  if (m_labels[index] == NoLabel)
+    m_labels[index] = m_builder.NewLabel().Id;
+
+  return Label{ m_labels[index] };
+}
+
+U32 PeepholeOptimizer::GetNewPC(U32 index) const
+{
+  return *m_builder.GetOffset(Label{ m_labels[index] });
+}
+
+void PeepholeOptimizer::Emit(const CodeAttribute& code, U32 index)
+{
+  const PeepholeInstruction& instr = m_context.m_instructions[index];
+
+  if (m_labels[index] != NoLabel)
+    m_builder.Bind(Label{ m_labels[index] });
+
+  if (instr.IsRemoved)
+    return;
+
+  U8 opCode = instr.OpCode;
+  const OpCodeInfo& info = GetOpCodeInfo(opCode);
+
+  if (info.IsSwitch())
+  {
+    const U8* operands = code.Code.GetBytes().data() + instr.PC + 1 + GetSwitchPadding(instr.PC);
+    auto getLabel = [&](S32 offset) { return Label{ m_labels[this->GetInstructionIndex(instr.PC + offset)] }; };
+
+    Label defaultTarget = getLabel(LoadBigEndian<S32>(operands));
+
+    if (opCode == OP_TABLESWITCH)
+    {
+      S32 low = LoadBigEndian<S32>(operands + 4);
+      U32 caseCount = static_cast<U32>(LoadBigEndian<S32>(operands + 8) - low + 1);
+
+      m_switchTargets.clear();
+      for (U32 i = 0; i < caseCount; i++)
+        m_switchTargets.push_back(getLabel(LoadBigEndian<S32>(operands + 12 + i * 4)));
+
+      m_builder.EmitTableSwitch(defaultTarget, low, m_switchTargets);
+    }
+    else
+    {
+      m_switchCases.clear();
+      for (U32 i = 0; i < LoadBigEndian<U32>(operands + 4); i++)
+      {
+        m_switchCases.push_back({ LoadBigEndian<S32>(operands + 8 + i * 8),
+            getLabel(LoadBigEndian<S32>(operands + 12 + i * 8)) });
+      }
+
+      m_builder.EmitLookupSwitch(defaultTarget, m_switchCases);
+    }
+
+    return;
+  }
+
+  //the CodeBuilder widens branches again where needed
+  if (info.IsBranch())
+  {
+    if (opCode == OP_GOTO_W)
+      opCode = OP_GOTO;
+    else if (opCode == OP_JSR_W)
+      opCode = OP_JSR;
+
+    m_builder.EmitBranch(opCode, Label{ m_labels[instr.Operand] });
+    return;
+  }
+
+  constexpr U32 maxByte = std::numeric_limits<U8>::max();
+
+  switch (info.Layout)
+  {
+    case OperandLayout::None:
+      m_builder.Emit(opCode);
+      break;
+
+    case OperandLayout::UByte:
+      assert(opCode != OP_LDC || instr.Operand <= maxByte);
+
+      if (instr.Operand > maxByte)
+        m_builder.Emit(OP_WIDE, opCode, static_cast<U16>(instr.Operand));
+      else
+        m_builder.Emit(opCode, static_cast<U8>(instr.Operand));
+      break;
+
+    case OperandLayout::SByte:
+      m_builder.Emit(opCode, static_cast<S8>(instr.Value));
+      break;
+
+    case OperandLayout::AType:
+      m_builder.Emit(opCode, static_cast<U8>(instr.Value));
+      break;
+
+    case OperandLayout::UShort:
+      m_builder.Emit(opCode, static_cast<U16>(instr.Operand));
+      break;
+
+    case OperandLayout::SShort:
+      m_builder.Emit(opCode, static_cast<S16>(instr.Value));
+      break;
+
+    case OperandLayout::IInc:
+      if (instr.Operand > maxByte || instr.Value < std::numeric_limits<S8>::min() || instr.Value > std::numeric_limits<S8>::max())
+        m_builder.Emit(OP_WIDE, opCode, static_cast<U16>(instr.Operand), static_cast<S16>(instr.Value));
+      else
+        m_builder.Emit(opCode, static_cast<U8>(instr.Operand), static_cast<S8>(instr.Value));
+      break;
+
+    case OperandLayout::MultiANewArray:
+      m_builder.Emit(opCode, static_cast<U16>(instr.Operand), static_cast<U8>(instr.Value));
+      break;
+
+    case OperandLayout::InvokeInterface:
+      m_builder.Emit(opCode, static_cast<U16>(instr.Operand), static_cast<U8>(instr.Value), U8{0});
+      break;
+
+    case OperandLayout::InvokeDynamic:
+      m_builder.Emit(opCode, static_cast<U16>(instr.Operand), U16{0});
+      break;
+
+    default:
+      assert(false && "PeepholeOptimizer: can't encode the instruction");
+      break;
+  }
+}
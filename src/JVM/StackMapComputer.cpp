@@ -0,0 +1,1098 @@
+#include "FileFormats/JVM/StackMapComputer.hpp"
+#include "FileFormats/JVM/Descriptor.hpp"
+
+#include "Util/Error.hpp"
+
+#include <algorithm>
+
+using namespace FileFormats;
+using namespace FileFormats::JVM;
+
+using Tag = VerificationType::Tag;
+
+static constexpr U16 AccStatic = 0x0008;
+
+//Values are U32's holding the verification type tag in the upper 8 bits and
+//the interned class name (Object) or the offset of the NEW instruction
+//(Uninitialized) in the lower 24. Long & double take two slots, the second
+//one being Top.
+static constexpr U32 makeValue(Tag tag, U32 data = 0) { return (static_cast<U32>(tag) << 24) | data; }
+static constexpr Tag getTag(U32 value) { return static_cast<Tag>(value >> 24); }
+static constexpr U32 getData(U32 value) { return value & 0xFFFFFF; }
+
+static constexpr U32 Top     = makeValue(Tag::Top);
+static constexpr U32 Integer = makeValue(Tag::Integer);
+static constexpr U32 Float   = makeValue(Tag::Float);
+static constexpr U32 Long    = makeValue(Tag::Long);
+static constexpr U32 Double  = makeValue(Tag::Double);
+static constexpr U32 Null    = makeValue(Tag::Null);
+
+static bool isWide(U32 value) { return value == Long || value == Double; }
+static bool isReference(U32 value) { return value == Null || getTag(value) == Tag::Object; }
+
+static std::string_view getNewArrayName(AType type)
+{
+  switch (type)
+  {
+    case AType::T_BOOLEAN: return "[Z";
+    case AType::T_CHAR:    return "[C";
+    case AType::T_FLOAT:   return "[F";
+    case AType::T_DOUBLE:  return "[D";
+    case AType::T_BYTE:    return "[B";
+    case AType::T_SHORT:   return "[S";
+    case AType::T_INT:     return "[I";
+    case AType::T_LONG:    return "[J";
+  }
+
+  return {};
+}
+
+static ClassHierarchyResolver defaultResolver;
+
+StackMapComputer::StackMapComputer(ClassHierarchyResolver* resolver)
+  : m_resolver{resolver != nullptr ? resolver : &defaultResolver}
+{
+}
+
+ErrorOr<void> StackMapComputer::Update(ClassFile& classFile, FieldMethodInfo& method)
+{
+  ConstantPool& constPool = classFile.ConstPool;
+  CodeAttribute* code{nullptr};
+
+  for (auto& pAttr : method.Attributes)
+  {
+    auto errOrAttr = LazyAttribute::Resolve(*pAttr, constPool);
+    VERIFY(errOrAttr);
+
+    if (errOrAttr.Get().get().GetType() == AttributeInfo::Type::Code)
+    {
+      code = static_cast<CodeAttribute*>(&errOrAttr.Get().get());
+      break;
+    }
+  }
+
+  if (code == nullptr)
+    return {};
+
+  auto isStackMapTable = [](const ArenaPtr<AttributeInfo>& pAttr)
+  {
+    if (pAttr->GetType() == AttributeInfo::Type::Lazy)
+      return static_cast<const LazyAttribute&>(*pAttr).GetBodyType() == AttributeInfo::Type::StackMapTable;
+
+    return pAttr->GetType() == AttributeInfo::Type::StackMapTable;
+  };
+
+  auto itr = std::find_if(code->Attributes.begin(), code->Attributes.end(), isStackMapTable);
+
+  //the existing attribute is reused, unless it hasn't been decoded
+  if (itr == code->Attributes.end() || (*itr)->GetType() != AttributeInfo::Type::StackMapTable)
+  {
+    auto errOrName = constPool.FindOrAddUTF8(AttributeInfo::GetTypeName(AttributeInfo::Type::StackMapTable));
+    VERIFY(errOrName);
+
+    ArenaPtr<AttributeInfo> attr{ new StackMapTableAttribute() };
+    attr->NameIndex = errOrName.Get();
+
+    if (itr == code->Attributes.end())
+      itr = code->Attributes.insert(itr, std::move(attr));
+    else
+      *itr = std::move(attr);
+  }
+
+  auto& table = static_cast<StackMapTableAttribute&>(**itr);
+  TRY(this->Compute(constPool, classFile.ThisClass, method, *code, table));
+
+  table.MarkModified();
+
+  if (table.Frames.empty())
+  {
+    code->Attributes.erase(itr);
+    code->MarkModified();
+  }
+
+  return {};
+}
+
+ErrorOr<void> StackMapComputer::Compute(ConstantPool& constPool, U16 thisClass,
+    const FieldMethodInfo& method, const CodeAttribute& code, StackMapTableAttribute& out)
+{
+  out.Frames.clear();
+  out.Types.clear();
+
+  TRY(this->Initialize(constPool, thisClass, method, code));
+
+  while (!m_worklist.empty())
+  {
+    U32 block = m_worklist.back();
+    m_worklist.pop_back();
+    m_queued[block] = false;
+
+    TRY(this->ExecuteBlock(constPool, code, block));
+  }
+
+  for (U32 i = 0; i < m_cfg.GetBlockCount(); i++)
+  {
+    if (!m_reached[i])
+      return Error::FromFormatStr("StackMapComputer: the code at offset %u is unreachable",
+          m_cfg.GetBlocks()[i].StartPC);
+  }
+
+  return this->Encode(constPool, out);
+}
+
+ErrorOr<void> StackMapComputer::Initialize(const ConstantPool& constPool, U16 thisClass,
+    const FieldMethodInfo& method, const CodeAttribute& code)
+{
+  if (code.Code.IsEmpty())
+    return Error::FromLiteralStr("StackMapComputer: the method has no code");
+
+  TRY(m_cfgBuilder.Build(code, m_cfg));
+
+  m_names.clear();
+  m_nameIds.clear();
+  m_ownedNames.clear();
+  m_mergeCache.clear();
+  m_classIndices.clear();
+
+  m_maxLocals = code.MaxLocals;
+  m_maxStack = code.MaxStack;
+
+  U32 blockCount = static_cast<U32>(m_cfg.GetBlockCount());
+  U32 frameSize = m_maxLocals + m_maxStack;
+
+  m_entryFrames.resize(static_cast<size_t>(blockCount) * frameSize);
+  m_entryStackSizes.assign(blockCount, 0);
+  m_reached.assign(blockCount, false);
+  m_queued.assign(blockCount, false);
+  m_worklist.clear();
+
+  m_locals.assign(m_maxLocals, Top);
+  m_stack.assign(m_maxStack, Top);
+  m_stackSize = 0;
+
+  TRY(this->CollectHandlers(constPool, code));
+
+  //the initial frame holds this & the parameters
+  auto errOrThisName = this->GetClassName(constPool, thisClass);
+  VERIFY(errOrThisName);
+
+  m_thisType = makeValue(Tag::Object, this->Intern(errOrThisName.Get()));
+
+  if (!constPool.Is(method.NameIndex, CPInfo::Type::UTF8) || !constPool.Is(method.DescriptorIndex, CPInfo::Type::UTF8))
+    return Error::FromLiteralStr("StackMapComputer: the methods name or descriptor isn't a UTF8 constant");
+
+  auto errOrDescriptor = MethodDescriptor::Parse(constPool.GetUTF8(method.DescriptorIndex));
+  VERIFY(errOrDescriptor);
+
+  const MethodDescriptor& descriptor = errOrDescriptor.Get();
+  bool isStatic = method.AccessFlags & AccStatic;
+
+  if (descriptor.GetParameterSlots() + (isStatic ? 0u : 1u) > m_maxLocals)
+    return Error::FromFormatStr("StackMapComputer: the parameters don't fit into max_locals (%u)", m_maxLocals);
+
+  U32 local{0};
+  if (!isStatic)
+  {
+    bool isConstructor = constPool.GetUTF8(method.NameIndex) == "<init>"
+      && errOrThisName.Get() != "java/lang/Object";
+
+    m_locals[local++] = isConstructor ? makeValue(Tag::UninitializedThis) : m_thisType;
+  }
+
+  for (std::string_view param : descriptor)
+  {
+    U32 value = this->GetDescriptorType(param);
+    m_locals[local++] = value;
+
+    if (isWide(value))
+      m_locals[local++] = Top;
+  }
+
+  m_initialLocals.assign(m_locals.begin(), m_locals.end());
+
+  TRY(this->MergeInto(0, m_stack.data(), 0));
+  return {};
+}
+
+ErrorOr<void> StackMapComputer::CollectHandlers(const ConstantPool& constPool, const CodeAttribute& code)
+{
+  U32 blockCount = static_cast<U32>(m_cfg.GetBlockCount());
+  U32 codeLength = code.GetCodeLength();
+
+  m_handlerBlocks.clear();
+  m_catchTypes.clear();
+
+  for (const auto& handler : code.ExceptionTable)
+  {
+    std::string_view catchType = "java/lang/Throwable";
+
+    if (handler.CatchType != 0)
+    {
+      auto errOrName = this->GetClassName(constPool, handler.CatchType);
+      VERIFY(errOrName);
+
+      catchType = errOrName.Get();
+    }
+
+    m_handlerBlocks.push_back(*m_cfg.GetBlockIndex(handler.HandlerPC));
+    m_catchTypes.push_back(makeValue(Tag::Object, this->Intern(catchType)));
+  }
+
+  //counting sort the exception table entries by the blocks they cover
+  m_handlersBegin.assign(blockCount + 1, 0);
+
+  for (const auto& handler : code.ExceptionTable)
+  {
+    U32 first = *m_cfg.GetBlockIndex(handler.StartPC);
+    U32 end = handler.EndPC == codeLength ? blockCount : *m_cfg.GetBlockIndex(handler.EndPC);
+
+    for (U32 i = first; i < end; i++)
+      m_handlersBegin[i + 1]++;
+  }
+
+  for (U32 i = 0; i < blockCount; i++)
+    m_handlersBegin[i + 1] += m_handlersBegin[i];
+
+  m_handlerEntries.resize(m_handlersBegin[blockCount]);
+
+  for (U32 entry = 0; entry < code.ExceptionTable.size(); entry++)
+  {
+    const auto& handler = code.ExceptionTable[entry];
+
+    U32 first = *m_cfg.GetBlockIndex(handler.StartPC);
+    U32 end = handler.EndPC == codeLength ? blockCount : *m_cfg.GetBlockIndex(handler.EndPC);
+
+    //m_handlersBegin[i] is used as the insert position and ends up at the
+    //start of block i + 1's entries, which gets fixed below
+    for (U32 i = first; i < end; i++)
+      m_handlerEntries[m_handlersBegin[i]++] = entry;
+  }
+
+  for (U32 i = blockCount; i > 0; i--)
+    m_handlersBegin[i] = m_handlersBegin[i - 1];
+
+  m_handlersBegin[0] = 0;
+  return {};
+}
+
+ErrorOr<void> StackMapComputer::ExecuteBlock(const ConstantPool& constPool, const CodeAttribute& code, U32 block)
+{
+  const BasicBlock& info = m_cfg.GetBlocks()[block];
+  const U32* entry = m_entryFrames.data() + static_cast<size_t>(block) * (m_maxLocals + m_maxStack);
+
+  std::copy(entry, entry + m_maxLocals, m_locals.begin());
+  std::copy(entry + m_maxLocals, entry + m_maxLocals + m_maxStack, m_stack.begin());
+  m_stackSize = m_entryStackSizes[block];
+
+  std::span<const U8> bytes = code.Code.GetBytes();
+  bool hasHandlers = m_handlersBegin[block] != m_handlersBegin[block + 1];
+  m_localsChanged = true;
+
+  for (U32 pc = info.StartPC; pc < info.EndPC; )
+  {
+    //the handlers have to accept the locals before every instruction they
+    //cover, which only need to be merged again once they changed
+    if (hasHandlers && m_localsChanged)
+    {
+      TRY(this->MergeIntoHandlers(block));
+      m_localsChanged = false;
+    }
+
+    auto errOrLength = this->Execute(constPool, bytes, pc);
+    VERIFY(errOrLength);
+
+    if (m_stackError)
+    {
+      m_stackError = false;
+      return Error::FromFormatStr("StackMapComputer: the instruction at offset %u under- or overflows the "
+          "operand stack (max_stack = %u)", pc, m_maxStack);
+    }
+
+    pc += errOrLength.Get();
+  }
+
+  for (const CFGEdge& edge : m_cfg.GetSuccessors(block))
+  {
+    if (edge.EdgeType != CFGEdge::Type::Exception)
+      TRY(this->MergeInto(edge.Block, m_stack.data(), m_stackSize));
+  }
+
+  return {};
+}
+
+//A handler is entered with the locals of the throwing instruction and the
+//caught exception as the only stack value
+ErrorOr<void> StackMapComputer::MergeIntoHandlers(U32 block)
+{
+  for (U32 i = m_handlersBegin[block]; i < m_handlersBegin[block + 1]; i++)
+  {
+    U32 entry = m_handlerEntries[i];
+    TRY(this->MergeInto(m_handlerBlocks[entry], &m_catchTypes[entry], 1));
+  }
+
+  return {};
+}
+
+ErrorOr<void> StackMapComputer::MergeInto(U32 block, const U32* stack, U32 stackSize)
+{
+  U32* entry = m_entryFrames.data() + static_cast<size_t>(block) * (m_maxLocals + m_maxStack);
+  U32* entryStack = entry + m_maxLocals;
+
+  bool changed{false};
+
+  if (!m_reached[block])
+  {
+    std::copy(m_locals.begin(), m_locals.end(), entry);
+    std::copy(stack, stack + stackSize, entryStack);
+
+    m_entryStackSizes[block] = stackSize;
+    m_reached[block] = true;
+    changed = true;
+  }
+  else
+  {
+    if (m_entryStackSizes[block] != stackSize)
+      return Error::FromFormatStr("StackMapComputer: the code at offset %u is reached with different stack sizes (%u and %u)",
+          m_cfg.GetBlocks()[block].StartPC, m_entryStackSizes[block], stackSize);
+
+    for (U32 i = 0; i < m_maxLocals; i++)
+    {
+      U32 merged = this->Merge(entry[i], m_locals[i]);
+      changed |= merged != entry[i];
+      entry[i] = merged;
+    }
+
+    for (U32 i = 0; i < stackSize; i++)
+    {
+      U32 merged = this->Merge(entryStack[i], stack[i]);
+
+      //unlike locals, incompatible stack values can't just become unusable
+      if (merged == Top && entryStack[i] != Top)
+        return Error::FromFormatStr("StackMapComputer: the code at offset %u is reached with incompatible stack values",
+            m_cfg.GetBlocks()[block].StartPC);
+
+      changed |= merged != entryStack[i];
+      entryStack[i] = merged;
+    }
+  }
+
+  if (changed && !m_queued[block])
+  {
+    m_queued[block] = true;
+    m_worklist.push_back(block);
+  }
+
+  return {};
+}
+
+//Executes the instruction at pc on the current frame, returns its length
+ErrorOr<U32> StackMapComputer::Execute(const ConstantPool& constPool, std::span<const U8> code, U32 pc)
+{
+  const U8* bytes = code.data() + pc;
+  U8 opCode = bytes[0];
+
+  switch (opCode)
+  {
+    case OP_NOP:
+      break;
+
+    case OP_ACONST_NULL:
+      this->Push(Null);
+      break;
+
+    case OP_ICONST_M1: case OP_ICONST_0: case OP_ICONST_1: case OP_ICONST_2:
+    case OP_ICONST_3:  case OP_ICONST_4: case OP_ICONST_5: case OP_BIPUSH:
+    case OP_SIPUSH:
+      this->Push(Integer);
+      break;
+
+    case OP_LCONST_0: case OP_LCONST_1:
+      this->Push(Long);
+      break;
+
+    case OP_FCONST_0: case OP_FCONST_1: case OP_FCONST_2:
+      this->Push(Float);
+      break;
+
+    case OP_DCONST_0: case OP_DCONST_1:
+      this->Push(Double);
+      break;
+
+    case OP_LDC: case OP_LDC_W: case OP_LDC2_W:
+    {
+      U16 index = opCode == OP_LDC ? bytes[1] : LoadBigEndian<U16>(bytes + 1);
+
+      switch (constPool.GetType(index))
+      {
+        case CPInfo::Type::Integer:      this->Push(Integer); break;
+        case CPInfo::Type::Float:        this->Push(Float);   break;
+        case CPInfo::Type::Long:         this->Push(Long);    break;
+        case CPInfo::Type::Double:       this->Push(Double);  break;
+        case CPInfo::Type::String:       this->Push(makeValue(Tag::Object, this->Intern("java/lang/String")));    break;
+        case CPInfo::Type::Class:        this->Push(makeValue(Tag::Object, this->Intern("java/lang/Class")));     break;
+        case CPInfo::Type::MethodType:   this->Push(makeValue(Tag::Object, this->Intern("java/lang/invoke/MethodType")));   break;
+        case CPInfo::Type::MethodHandle: this->Push(makeValue(Tag::Object, this->Intern("java/lang/invoke/MethodHandle"))); break;
+
+        default:
+          return Error::FromFormatStr("StackMapComputer: %s at offset %u loads constant %u, which can't be loaded",
+              GetOpCodeMnemonic(opCode).data(), pc, index);
+      }
+      break;
+    }
+
+    case OP_ILOAD: this->Push(Integer); break;
+    case OP_LLOAD: this->Push(Long);    break;
+    case OP_FLOAD: this->Push(Float);   break;
+    case OP_DLOAD: this->Push(Double);  break;
+
+    case OP_ILOAD_0: case OP_ILOAD_1: case OP_ILOAD_2: case OP_ILOAD_3: this->Push(Integer); break;
+    case OP_LLOAD_0: case OP_LLOAD_1: case OP_LLOAD_2: case OP_LLOAD_3: this->Push(Long);    break;
+    case OP_FLOAD_0: case OP_FLOAD_1: case OP_FLOAD_2: case OP_FLOAD_3: this->Push(Float);   break;
+    case OP_DLOAD_0: case OP_DLOAD_1: case OP_DLOAD_2: case OP_DLOAD_3: this->Push(Double);  break;
+
+    case OP_ALOAD:
+    case OP_ALOAD_0: case OP_ALOAD_1: case OP_ALOAD_2: case OP_ALOAD_3:
+    {
+      U32 index = opCode == OP_ALOAD ? bytes[1] : opCode - OP_ALOAD_0;
+      if (index >= m_maxLocals)
+        return Error::FromFormatStr("StackMapComputer: ALOAD at offset %u loads local %u, which exceeds max_locals", pc, index);
+
+      this->Push(m_locals[index]);
+      break;
+    }
+
+    case OP_IALOAD: case OP_BALOAD: case OP_CALOAD: case OP_SALOAD:
+      this->Pop(2);
+      this->Push(Integer);
+      break;
+
+    case OP_LALOAD: this->Pop(2); this->Push(Long);   break;
+    case OP_FALOAD: this->Pop(2); this->Push(Float);  break;
+    case OP_DALOAD: this->Pop(2); this->Push(Double); break;
+
+    case OP_AALOAD:
+    {
+      this->Pop();
+      this->Push(this->GetArrayElementType(this->Pop()));
+      break;
+    }
+
+    case OP_ISTORE: case OP_LSTORE: case OP_FSTORE: case OP_DSTORE: case OP_ASTORE:
+    case OP_ISTORE_0: case OP_ISTORE_1: case OP_ISTORE_2: case OP_ISTORE_3:
+    case OP_LSTORE_0: case OP_LSTORE_1: case OP_LSTORE_2: case OP_LSTORE_3:
+    case OP_FSTORE_0: case OP_FSTORE_1: case OP_FSTORE_2: case OP_FSTORE_3:
+    case OP_DSTORE_0: case OP_DSTORE_1: case OP_DSTORE_2: case OP_DSTORE_3:
+    case OP_ASTORE_0: case OP_ASTORE_1: case OP_ASTORE_2: case OP_ASTORE_3:
+    {
+      U32 index = opCode <= OP_ASTORE ? bytes[1] : (opCode - OP_ISTORE_0) % 4;
+
+      U32 value = this->Pop();
+      if (value == Top && m_stackSize > 0 && isWide(m_stack[m_stackSize - 1]))
+        value = this->Pop();
+
+      if (index + (isWide(value) ? 2u : 1u) > m_maxLocals)
+        return Error::FromFormatStr("StackMapComputer: %s at offset %u stores local %u, which exceeds max_locals",
+            GetOpCodeMnemonic(opCode).data(), pc, index);
+
+      this->Store(index, value);
+      break;
+    }
+
+    case OP_IINC:
+      break;
+
+    case OP_WIDE:
+    {
+      U8 modified = bytes[1];
+      U16 index = LoadBigEndian<U16>(bytes + 2);
+
+      switch (modified)
+      {
+        case OP_ILOAD: this->Push(Integer); break;
+        case OP_LLOAD: this->Push(Long);    break;
+        case OP_FLOAD: this->Push(Float);   break;
+        case OP_DLOAD: this->Push(Double);  break;
+
+        case OP_ALOAD:
+          if (index >= m_maxLocals)
+            return Error::FromFormatStr("StackMapComputer: ALOAD at offset %u loads local %u, which exceeds max_locals", pc, index);
+
+          this->Push(m_locals[index]);
+          break;
+
+        case OP_ISTORE: case OP_LSTORE: case OP_FSTORE: case OP_DSTORE: case OP_ASTORE:
+        {
+          U32 value = this->Pop();
+          if (value == Top && m_stackSize > 0 && isWide(m_stack[m_stackSize - 1]))
+            value = this->Pop();
+
+          if (index + (isWide(value) ? 2u : 1u) > m_maxLocals)
+            return Error::FromFormatStr("StackMapComputer: %s at offset %u stores local %u, which exceeds max_locals",
+                GetOpCodeMnemonic(modified).data(), pc, index);
+
+          this->Store(index, value);
+          break;
+        }
+
+        case OP_IINC:
+          break;
+
+        default:
+          return Error::FromFormatStr("StackMapComputer: JSR / RET at offset %u aren't supported", pc);
+      }
+      break;
+    }
+
+    case OP_IASTORE: case OP_LASTORE: case OP_FASTORE: case OP_DASTORE:
+    case OP_AASTORE: case OP_BASTORE: case OP_CASTORE: case OP_SASTORE:
+    case OP_POP:     case OP_POP2:
+    case OP_IFEQ:      case OP_IFNE:      case OP_IFLT:      case OP_IFGE:
+    case OP_IFGT:      case OP_IFLE:      case OP_IF_ICMPEQ: case OP_IF_ICMPNE:
+    case OP_IF_ICMPLT: case OP_IF_ICMPGE: case OP_IF_ICMPGT: case OP_IF_ICMPLE:
+    case OP_IF_ACMPEQ: case OP_IF_ACMPNE: case OP_IFNULL:    case OP_IFNONNULL:
+    case OP_TABLESWITCH: case OP_LOOKUPSWITCH:
+    case OP_IRETURN: case OP_LRETURN: case OP_FRETURN: case OP_DRETURN:
+    case OP_ARETURN: case OP_RETURN:  case OP_ATHROW:
+    case OP_MONITORENTER: case OP_MONITOREXIT:
+    case OP_GOTO: case OP_GOTO_W:
+      this->Pop(GetOpCodeInfo(opCode).Pops);
+      break;
+
+    //the stack manipulations work on slots, so they don't have to care
+    //about long & double
+    case OP_DUP:
+    {
+      U32 a = this->Pop();
+      this->Push(a); this->Push(a);
+      break;
+    }
+
+    case OP_DUP_X1:
+    {
+      U32 a = this->Pop(), b = this->Pop();
+      this->Push(a); this->Push(b); this->Push(a);
+      break;
+    }
+
+    case OP_DUP_X2:
+    {
+      U32 a = this->Pop(), b = this->Pop(), c = this->Pop();
+      this->Push(a); this->Push(c); this->Push(b); this->Push(a);
+      break;
+    }
+
+    case OP_DUP2:
+    {
+      U32 a = this->Pop(), b = this->Pop();
+      this->Push(b); this->Push(a); this->Push(b); this->Push(a);
+      break;
+    }
+
+    case OP_DUP2_X1:
+    {
+      U32 a = this->Pop(), b = this->Pop(), c = this->Pop();
+      this->Push(b); this->Push(a); this->Push(c); this->Push(b); this->Push(a);
+      break;
+    }
+
+    case OP_DUP2_X2:
+    {
+      U32 a = this->Pop(), b = this->Pop(), c = this->Pop(), d = this->Pop();
+      this->Push(b); this->Push(a); this->Push(d); this->Push(c); this->Push(b); this->Push(a);
+      break;
+    }
+
+    case OP_SWAP:
+    {
+      U32 a = this->Pop(), b = this->Pop();
+      this->Push(a); this->Push(b);
+      break;
+    }
+
+    case OP_LCMP: case OP_FCMPL: case OP_FCMPG: case OP_DCMPL: case OP_DCMPG:
+      this->Pop(GetOpCodeInfo(opCode).Pops);
+      this->Push(Integer);
+      break;
+
+    case OP_GETSTATIC: case OP_PUTSTATIC: case OP_GETFIELD: case OP_PUTFIELD:
+    {
+      auto errOrField = this->GetMemberRef(constPool, LoadBigEndian<U16>(bytes + 1));
+      VERIFY(errOrField);
+
+      std::string_view descriptor = errOrField.Get().Descriptor;
+      if (!IsValidFieldDescriptor(descriptor))
+        return Error::FromFormatStr("StackMapComputer: %s at offset %u references a field with an invalid descriptor",
+            GetOpCodeMnemonic(opCode).data(), pc);
+
+      U8 slots = GetDescriptorSlotCount(descriptor[0]);
+
+      if (opCode == OP_PUTSTATIC || opCode == OP_PUTFIELD)
+        this->Pop(slots);
+
+      if (opCode == OP_GETFIELD || opCode == OP_PUTFIELD)
+        this->Pop();
+
+      if (opCode == OP_GETSTATIC || opCode == OP_GETFIELD)
+        this->PushDescriptor(descriptor);
+      break;
+    }
+
+    case OP_INVOKEVIRTUAL: case OP_INVOKESPECIAL: case OP_INVOKESTATIC:
+    case OP_INVOKEINTERFACE: case OP_INVOKEDYNAMIC:
+      TRY(this->Invoke(constPool, code, opCode, LoadBigEndian<U16>(bytes + 1)));
+      break;
+
+    case OP_NEW:
+      this->Push(makeValue(Tag::Uninitialized, pc));
+      break;
+
+    case OP_NEWARRAY:
+    {
+      std::string_view name = getNewArrayName(static_cast<AType>(bytes[1]));
+      if (name.empty())
+        return Error::FromFormatStr("StackMapComputer: NEWARRAY at offset %u has invalid type %u", pc, bytes[1]);
+
+      this->Pop();
+      this->Push(makeValue(Tag::Object, this->Intern(name)));
+      break;
+    }
+
+    case OP_ANEWARRAY: case OP_CHECKCAST: case OP_MULTIANEWARRAY:
+    {
+      auto errOrName = this->GetClassName(constPool, LoadBigEndian<U16>(bytes + 1));
+      VERIFY(errOrName);
+
+      this->Pop(opCode == OP_MULTIANEWARRAY ? bytes[3] : 1);
+      this->Push(makeValue(Tag::Object, opCode == OP_ANEWARRAY
+            ? this->InternArrayOf(errOrName.Get())
+            : this->Intern(errOrName.Get())));
+      break;
+    }
+
+    case OP_ARRAYLENGTH: case OP_INSTANCEOF:
+      this->Pop();
+      this->Push(Integer);
+      break;
+
+    case OP_JSR: case OP_JSR_W: case OP_RET:
+      return Error::FromFormatStr("StackMapComputer: %s at offset %u isn't supported",
+          GetOpCodeMnemonic(opCode).data(), pc);
+
+    default:
+    {
+      //arithmetic & conversions
+      const OpCodeInfo& info = GetOpCodeInfo(opCode);
+
+      U32 result;
+      if (opCode >= OP_IADD && opCode <= OP_DNEG)
+      {
+        constexpr U32 types[] = { Integer, Long, Float, Double };
+        result = types[(opCode - OP_IADD) % 4];
+      }
+      else if (opCode >= OP_ISHL && opCode <= OP_LXOR)
+        result = (opCode - OP_ISHL) % 2 == 0 ? Integer : Long;
+      else if (opCode >= OP_I2L && opCode <= OP_I2S)
+      {
+        constexpr U32 types[] = 
+        { 
+          Long,    Float, Double,  //I2x
+          Integer, Float, Double,  //L2x
+          Integer, Long,  Double,  //F2x
+          Integer, Long,  Float,   //D2x
+          Integer, Integer, Integer, //I2B, I2C, I2S
+        };
+        result = types[opCode - OP_I2L];
+      }
+      else
+        return Error::FromFormatStr("StackMapComputer: unsupported opcode 0x%02X at offset %u", opCode, pc);
+
+      this->Pop(info.Pops);
+      this->Push(result);
+      break;
+    }
+  }
+
+  return Bytecode::GetLengthUnchecked(code.data(), pc);
+}
+
+ErrorOr<void> StackMapComputer::Invoke(const ConstantPool& constPool, std::span<const U8> code, U8 opCode, U16 index)
+{
+  auto errOrMethod = this->GetMemberRef(constPool, index);
+  VERIFY(errOrMethod);
+
+  auto errOrDescriptor = MethodDescriptor::Parse(errOrMethod.Get().Descriptor);
+  VERIFY(errOrDescriptor);
+
+  const MethodDescriptor& descriptor = errOrDescriptor.Get();
+  this->Pop(descriptor.GetParameterSlots());
+
+  if (opCode != OP_INVOKESTATIC && opCode != OP_INVOKEDYNAMIC)
+  {
+    U32 receiver = this->Pop();
+
+    //a constructor call initializes every copy of the object
+    if (opCode == OP_INVOKESPECIAL && errOrMethod.Get().Name == "<init>")
+    {
+      if (getTag(receiver) == Tag::UninitializedThis)
+        this->ReplaceUninitialized(receiver, m_thisType);
+      else if (getTag(receiver) == Tag::Uninitialized)
+      {
+        U32 newPC = getData(receiver);
+        auto errOrName = this->GetClassName(constPool, LoadBigEndian<U16>(code.data() + newPC + 1));
+        VERIFY(errOrName);
+
+        this->ReplaceUninitialized(receiver, makeValue(Tag::Object, this->Intern(errOrName.Get())));
+      }
+    }
+  }
+
+  if (descriptor.GetReturnType() != "V")
+    this->PushDescriptor(descriptor.GetReturnType());
+
+  return {};
+}
+
+ErrorOr<StackMapComputer::MemberRef> StackMapComputer::GetMemberRef(const ConstantPool& constPool, U16 index) const
+{
+  switch (constPool.GetType(index))
+  {
+    case CPInfo::Type::Fieldref:
+    case CPInfo::Type::Methodref:
+    case CPInfo::Type::InterfaceMethodref:
+    case CPInfo::Type::InvokeDynamic:
+    {
+      U16 nameAndType = constPool.GetSecondIndex(index);
+
+      if (constPool.Is(nameAndType, CPInfo::Type::NameAndType) 
+          && constPool.Is(constPool.GetFirstIndex(nameAndType), CPInfo::Type::UTF8)
+          && constPool.Is(constPool.GetSecondIndex(nameAndType), CPInfo::Type::UTF8))
+      {
+        return MemberRef{ constPool.GetUTF8(constPool.GetFirstIndex(nameAndType)),
+          constPool.GetUTF8(constPool.GetSecondIndex(nameAndType)) };
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  return Error::FromFormatStr("StackMapComputer: constant %u isn't a valid field, method or invokedynamic reference", index);
+}
+
+ErrorOr<std::string_view> StackMapComputer::GetClassName(const ConstantPool& constPool, U16 index) const
+{
+  if (!constPool.Is(index, CPInfo::Type::Class) || !constPool.Is(constPool.GetFirstIndex(index), CPInfo::Type::UTF8))
+    return Error::FromFormatStr("StackMapComputer: constant %u isn't a valid Class constant", index);
+
+  return constPool.GetClassName(index);
+}
+
+U32 StackMapComputer::Intern(std::string_view name)
+{
+  auto [itr, inserted] = m_nameIds.try_emplace(name, static_cast<U32>(m_names.size()));
+
+  if (inserted)
+    m_names.push_back(name);
+
+  return itr->second;
+}
+
+U32 StackMapComputer::InternCopy(std::string_view name)
+{
+  auto itr = m_nameIds.find(name);
+  if (itr != m_nameIds.end())
+    return itr->second;
+
+  return this->Intern(m_ownedNames.emplace_back(name));
+}
+
+U32 StackMapComputer::InternArrayOf(std::string_view elementName)
+{
+  m_scratch.clear();
+  m_scratch += '[';
+
+  if (elementName.starts_with('['))
+    m_scratch += elementName;
+  else
+  {
+    m_scratch += 'L';
+    m_scratch += elementName;
+    m_scratch += ';';
+  }
+
+  return this->InternCopy(m_scratch);
+}
+
+//the value of a field type, whose second slot (if any) is pushed separately
+U32 StackMapComputer::GetDescriptorType(std::string_view descriptor)
+{
+  switch (descriptor[0])
+  {
+    case 'B': case 'C': case 'I': case 'S': case 'Z': return Integer;
+    case 'F': return Float;
+    case 'J': return Long;
+    case 'D': return Double;
+    case 'L': return makeValue(Tag::Object, this->Intern(descriptor.substr(1, descriptor.size() - 2)));
+    case '[': return makeValue(Tag::Object, this->Intern(descriptor));
+  }
+
+  return Top;
+}
+
+U32 StackMapComputer::GetArrayElementType(U32 arrayType)
+{
+  if (arrayType == Null)
+    return Null;
+
+  if (getTag(arrayType) != Tag::Object)
+    return Top;
+
+  std::string_view name = m_names[getData(arrayType)];
+  if (!name.starts_with('[') || name.size() < 2)
+    return Top;
+
+  return this->GetDescriptorType(name.substr(1));
+}
+
+U32 StackMapComputer::Merge(U32 a, U32 b)
+{
+  if (a == b)
+    return a;
+
+  if (!isReference(a) || !isReference(b))
+    return Top;
+
+  if (a == Null)
+    return b;
+
+  if (b == Null)
+    return a;
+
+  return makeValue(Tag::Object, this->GetCommonSuperClass(getData(a), getData(b)));
+}
+
+U32 StackMapComputer::GetCommonSuperClass(U32 a, U32 b)
+{
+  U64 key = (U64{std::min(a, b)} << 32) | std::max(a, b);
+
+  auto itr = m_mergeCache.find(key);
+  if (itr != m_mergeCache.end())
+    return itr->second;
+
+  std::string_view nameA = m_names[a];
+  std::string_view nameB = m_names[b];
+
+  U32 result;
+
+  if (nameA.starts_with('[') && nameB.starts_with('['))
+  {
+    //arrays of references merge to an array of the merged element type
+    U32 elementA = this->GetDescriptorType(nameA.substr(1));
+    U32 elementB = this->GetDescriptorType(nameB.substr(1));
+
+    if (getTag(elementA) == Tag::Object && getTag(elementB) == Tag::Object)
+    {
+      U32 merged = this->GetCommonSuperClass(getData(elementA), getData(elementB));
+      result = this->InternArrayOf(m_names[merged]);
+    }
+    else
+      result = this->Intern("java/lang/Object");
+  }
+  else if (nameA.starts_with('[') || nameB.starts_with('['))
+    result = this->Intern("java/lang/Object");
+  else
+    result = this->InternCopy(m_resolver->GetCommonSuperClass(nameA, nameB));
+
+  m_mergeCache.emplace(key, result);
+  return result;
+}
+
+void StackMapComputer::Push(U32 value)
+{
+  if (m_stackSize + (isWide(value) ? 2 : 1) > m_maxStack)
+  {
+    m_stackError = true;
+    return;
+  }
+
+  m_stack[m_stackSize++] = value;
+
+  if (isWide(value))
+    m_stack[m_stackSize++] = Top;
+}
+
+void StackMapComputer::PushDescriptor(std::string_view descriptor)
+{
+  this->Push(this->GetDescriptorType(descriptor));
+}
+
+U32 StackMapComputer::Pop()
+{
+  if (m_stackSize == 0)
+  {
+    m_stackError = true;
+    return Top;
+  }
+
+  return m_stack[--m_stackSize];
+}
+
+void StackMapComputer::Pop(U32 slots)
+{
+  if (slots > m_stackSize)
+  {
+    m_stackError = true;
+    m_stackSize = 0;
+    return;
+  }
+
+  m_stackSize -= slots;
+}
+
+void StackMapComputer::Store(U32 index, U32 value)
+{
+  //overwriting the second half of a long / double invalidates it
+  if (index > 0 && isWide(m_locals[index - 1]))
+    m_locals[index - 1] = Top;
+
+  m_locals[index] = value;
+
+  if (isWide(value))
+    m_locals[index + 1] = Top;
+
+  m_localsChanged = true;
+}
+
+void StackMapComputer::ReplaceUninitialized(U32 uninitialized, U32 initialized)
+{
+  std::replace(m_locals.begin(), m_locals.end(), uninitialized, initialized);
+  std::replace(m_stack.begin(), m_stack.begin() + m_stackSize, uninitialized, initialized);
+
+  m_localsChanged = true;
+}
+
+ErrorOr<void> StackMapComputer::AppendTypes(ConstantPool& constPool, const U32* values, U32 count, std::vector<VerificationType>& types)
+{
+  for (U32 i = 0; i < count; i++)
+  {
+    U32 value = values[i];
+    VerificationType type{ getTag(value), 0 };
+
+    if (type.TypeTag == Tag::Object)
+    {
+      U32 name = getData(value);
+      if (name >= m_classIndices.size())
+        m_classIndices.resize(m_names.size(), 0);
+
+      if (m_classIndices[name] == 0)
+      {
+        auto errOrClass = constPool.FindOrAddClass(m_names[name]);
+        VERIFY(errOrClass);
+
+        m_classIndices[name] = errOrClass.Get();
+      }
+
+      type.Data = m_classIndices[name];
+    }
+    else if (type.TypeTag == Tag::Uninitialized)
+      type.Data = static_cast<U16>(getData(value));
+
+    types.push_back(type);
+
+    //the second slot of long & double is implicit
+    if (isWide(value))
+      i++;
+  }
+
+  return {};
+}
+
+ErrorOr<void> StackMapComputer::Encode(ConstantPool& constPool, StackMapTableAttribute& out)
+{
+  auto getTrimmedLocalsCount = [this](const U32* locals)
+  {
+    U32 count = m_maxLocals;
+    while (count > 0 && locals[count - 1] == Top)
+      count--;
+
+    return count;
+  };
+
+  const U32* initial = m_initialLocals.data();
+
+  m_previousLocals.clear();
+  TRY(this->AppendTypes(constPool, initial, getTrimmedLocalsCount(initial), m_previousLocals));
+
+  S64 previousPC{-1};
+  const auto& blocks = m_cfg.GetBlocks();
+
+  for (U32 i = 0; i < blocks.size(); i++)
+  {
+    //blocks that are only entered by falling through from the previous one
+    //don't need a frame, neither does the first block unless it's a branch
+    //target (its frame is then encoded with offset_delta 0)
+    auto predecessors = m_cfg.GetPredecessors(i);
+    bool onlyFallThrough = i == 0 
+      ? predecessors.empty()
+      : predecessors.size() == 1 && predecessors[0].EdgeType == CFGEdge::Type::FallThrough;
+
+    if (onlyFallThrough && !blocks[i].IsExceptionHandler)
+      continue;
+
+    const U32* locals = m_entryFrames.data() + static_cast<size_t>(i) * (m_maxLocals + m_maxStack);
+    const U32* stack = locals + m_maxLocals;
+
+    m_currentLocals.clear();
+    m_currentStack.clear();
+    TRY(this->AppendTypes(constPool, locals, getTrimmedLocalsCount(locals), m_currentLocals));
+    TRY(this->AppendTypes(constPool, stack, m_entryStackSizes[i], m_currentStack));
+
+    U32 delta = static_cast<U32>(blocks[i].StartPC - previousPC - 1);
+    previousPC = blocks[i].StartPC;
+
+    StackMapFrame frame{};
+    frame.OffsetDelta = static_cast<U16>(delta);
+    frame.TypesBegin = static_cast<U32>(out.Types.size());
+
+    size_t previousCount = m_previousLocals.size();
+    size_t currentCount = m_currentLocals.size();
+
+    bool sameLocals = m_currentLocals == m_previousLocals;
+    auto isPrefix = [](const auto& shorter, const auto& longer)
+    {
+      return std::equal(shorter.begin(), shorter.end(), longer.begin());
+    };
+
+    if (sameLocals && m_currentStack.empty())
+      frame.FrameType = delta < 64 ? static_cast<U8>(delta) : 251;
+    else if (sameLocals && m_currentStack.size() == 1)
+    {
+      frame.FrameType = delta < 64 ? static_cast<U8>(64 + delta) : 247;
+      frame.StackCount = 1;
+    }
+    else if (m_currentStack.empty() && currentCount > previousCount && currentCount - previousCount <= 3
+        && isPrefix(m_previousLocals, m_currentLocals))
+    {
+      frame.FrameType = static_cast<U8>(251 + (currentCount - previousCount));
+      frame.LocalsCount = static_cast<U16>(currentCount - previousCount);
+    }
+    else if (m_currentStack.empty() && currentCount < previousCount && previousCount - currentCount <= 3
+        && isPrefix(m_currentLocals, m_previousLocals))
+      frame.FrameType = static_cast<U8>(251 - (previousCount - currentCount));
+    else
+    {
+      frame.FrameType = 255;
+      frame.LocalsCount = static_cast<U16>(currentCount);
+      frame.StackCount = static_cast<U16>(m_currentStack.size());
+    }
+
+    out.Types.insert(out.Types.end(), m_currentLocals.end() - frame.LocalsCount, m_currentLocals.end());
+    out.Types.insert(out.Types.end(), m_currentStack.end() - frame.StackCount, m_currentStack.end());
+    out.Frames.push_back(frame);
+
+    std::swap(m_previousLocals, m_currentLocals);
+  }
+
+  return {};
+}
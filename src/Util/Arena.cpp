@@ -0,0 +1,67 @@
+#include "FileFormats/Arena.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace FileFormats;
+
+void* Arena::AllocateSlow(size_t size, size_t alignment)
+{
+  //blocks kept by Reset() get reused first, the current one didn't fit
+  for (m_current++; m_current < m_blocks.size(); m_current++)
+  {
+    m_offset = 0;
+
+    if (size + alignment <= m_blocks[m_current].Size)
+      return this->Allocate(size, alignment);
+  }
+
+  //oversized allocations get a block of their own
+  size_t blockSize = std::max(m_blockSize, size + alignment);
+
+  m_blocks.push_back(Block{ std::unique_ptr<U8[]>{ new U8[blockSize] }, blockSize });
+  m_current = m_blocks.size() - 1;
+  m_offset = 0;
+
+  return this->Allocate(size, alignment);
+}
+
+std::span<const U8> Arena::CopyBytes(std::span<const U8> bytes)
+{
+  if (bytes.empty())
+    return {};
+
+  U8* mem = static_cast<U8*>(this->Allocate(bytes.size(), 1));
+  std::memcpy(mem, bytes.data(), bytes.size());
+
+  return { mem, bytes.size() };
+}
+
+std::string_view Arena::CopyString(std::string_view str)
+{
+  auto bytes = this->CopyBytes({ reinterpret_cast<const U8*>(str.data()), str.size() });
+  return { reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+}
+
+void Arena::Reset()
+{
+  m_current = 0;
+  m_offset = 0;
+  m_bytesAllocated = 0;
+}
+
+void Arena::Release()
+{
+  m_blocks.clear();
+  this->Reset();
+}
+
+size_t Arena::GetCapacity() const
+{
+  size_t capacity = 0;
+
+  for (const Block& block : m_blocks)
+    capacity += block.Size;
+
+  return capacity;
+}
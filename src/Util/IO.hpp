@@ -2,6 +2,22 @@
 
 #include "FileFormats/Defs.hpp"
 #include "FileFormats/Error.hpp"
+#include "FileFormats/ByteReader.hpp"
+#include "FileFormats/ByteWriter.hpp"
+
+#include <cstring>
+#include <array>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <typeinfo>
+#include <type_traits>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#elif defined(__SSSE3__)
+  #include <tmmintrin.h>
+#endif
 
 using namespace FileFormats;
 
@@ -26,17 +42,127 @@ constexpr ByteOrder GetHostByteOrder()
 template <typename T>
 void SwapByteOrder(T& t)
 {
-  char* bytes = reinterpret_cast<char*>(&t);
-  size_t len = sizeof(t);
+  if constexpr (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)
+  {
+    using UintT = std::conditional_t<sizeof(T) == 2, U16, 
+                  std::conditional_t<sizeof(T) == 4, U32, U64>>;
+
+    UintT value;
+    std::memcpy(&value, &t, sizeof(T));
+
+    if constexpr (sizeof(T) == 2)
+      value = __builtin_bswap16(value);
+    else if constexpr (sizeof(T) == 4)
+      value = __builtin_bswap32(value);
+    else
+      value = __builtin_bswap64(value);
+
+    std::memcpy(&t, &value, sizeof(T));
+  }
+  else
+  {
+    char* bytes = reinterpret_cast<char*>(&t);
+    size_t len = sizeof(t);
+
+    char tmp;
+    for (size_t i = 0; i < (len / 2); i++)
+    {
+      tmp = bytes[i];
+      bytes[i] = bytes[len - 1 - i];
+      bytes[len - 1 - i] = tmp;
+    }
+  }
+}
+
+//The unit in which the bytes of an array element have to be swapped. This is
+//the type itself for scalars. POD structs that consist of nothing but fields of
+//one integer type can declare "using SwapUnit = U16;" (etc.) so arrays of them
+//can be bulk read / written and byte swapped as one flat array of that type.
+template <typename T>
+struct SwapUnitOf { using Type = T; };
+
+template <typename T> requires requires { typename T::SwapUnit; }
+struct SwapUnitOf<T> { using Type = typename T::SwapUnit; };
+
+template <typename T>
+using SwapUnitT = typename SwapUnitOf<std::remove_const_t<T>>::Type;
+
+//shuffle control that reverses every UnitSize wide group of bytes in a vector
+template <size_t UnitSize, size_t VectorSize>
+constexpr std::array<U8, VectorSize> MakeByteSwapShuffle()
+{
+  std::array<U8, VectorSize> shuffle{};
+
+  for (size_t i = 0; i < VectorSize; i++)
+  {
+    //_mm256_shuffle_epi8 shuffles within each 128 bit lane, so indices are lane relative
+    size_t laneIndex = i % 16;
+    shuffle[i] = static_cast<U8>((laneIndex / UnitSize) * UnitSize + (UnitSize - 1 - laneIndex % UnitSize));
+  }
+
+  return shuffle;
+}
+
+//Swaps the byte order of count consecutive UnitT values in place. Uses 
+//AVX2 / SSSE3 byte shuffles when the target supports them and falls back to 
+//bswap for the remainder.
+template <typename UnitT>
+void SwapByteOrderArray(UnitT* data, size_t count)
+{
+  static_assert(std::is_integral_v<UnitT> || std::is_floating_point_v<UnitT> || std::is_enum_v<UnitT>, 
+      "SwapByteOrderArray only operates on arrays of scalars");
+
+  if constexpr (sizeof(UnitT) == 1)
+    return;
+
+  U8* bytes = reinterpret_cast<U8*>(data);
+  size_t size = count * sizeof(UnitT);
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  {
+    static constexpr auto shuffle = MakeByteSwapShuffle<sizeof(UnitT), 32>();
+    const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(shuffle.data()));
+
+    for (; i + 32 <= size; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes + i), _mm256_shuffle_epi8(v, mask));
+    }
+  }
+#endif
+
+#if defined(__SSSE3__)
+  {
+    static constexpr auto shuffle = MakeByteSwapShuffle<sizeof(UnitT), 16>();
+    const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle.data()));
 
-  char tmp;
-  for (size_t i = 0; i < (len / 2); i++)
+    for (; i + 16 <= size; i += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i), _mm_shuffle_epi8(v, mask));
+    }
+  }
+#endif
+
+  for (; i < size; i += sizeof(UnitT))
   {
-    tmp = bytes[i];
-    bytes[i] = bytes[len - 1 - i];
-    bytes[len - 1 - i] = tmp;
+    UnitT unit;
+    std::memcpy(&unit, bytes + i, sizeof(UnitT));
+    SwapByteOrder(unit);
+    std::memcpy(bytes + i, &unit, sizeof(UnitT));
   }
+}
 
+//Swaps every element of values, using the element types SwapUnit
+template <typename T, size_t Extent>
+void SwapByteOrderArray(std::span<T, Extent> values)
+{
+  using UnitT = SwapUnitT<T>;
+  static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(UnitT) == 0,
+      "array elements have to be trivially copyable and consist of SwapUnit's only");
+
+  SwapByteOrderArray(reinterpret_cast<UnitT*>(values.data()), values.size_bytes() / sizeof(UnitT));
 }
 
 template <ByteOrder Order = LittleEndian, typename T>
@@ -84,3 +210,188 @@ ErrorOr<void> Write(std::ostream& stream, const Args&... args)
 {
   return (Write<Order>(stream, args), ...);
 }
+
+//Reads values.size() elements with one bulk read and swaps them afterwards
+template <ByteOrder Order = LittleEndian, typename T, size_t Extent>
+ErrorOr<void> ReadArray(std::istream& stream, std::span<T, Extent> values)
+{
+  stream.read(reinterpret_cast<char*>(values.data()), values.size_bytes());
+
+  if (stream.bad())
+    return Error::FromFormatStr("ReadArray() failed: streams badbit got set after read. (steampos = 0x%X) (T = %s) (count = %zu)", stream.tellg(), typeid(T).name(), values.size());
+
+  if (Order != GetHostByteOrder())
+    SwapByteOrderArray(values);
+
+  return {};
+}
+
+//Writes values with bulk writes. If the byte order has to be swapped, this
+//happens in chunks on a stack buffer so values isn't modified.
+template <ByteOrder Order = LittleEndian, typename T, size_t Extent>
+ErrorOr<void> WriteArray(std::ostream& stream, std::span<T, Extent> values)
+{
+  using ValueT = std::remove_const_t<T>;
+
+  if (Order == GetHostByteOrder() || sizeof(SwapUnitT<T>) == 1)
+  {
+    stream.write(reinterpret_cast<const char*>(values.data()), values.size_bytes());
+  }
+  else
+  {
+    constexpr size_t chunkSize = 4096 / sizeof(ValueT) > 0 ? 4096 / sizeof(ValueT) : 1;
+    ValueT chunk[chunkSize];
+
+    for (size_t i = 0; i < values.size(); i += chunkSize)
+    {
+      size_t n = std::min(chunkSize, values.size() - i);
+      std::memcpy(chunk, values.data() + i, n * sizeof(ValueT));
+
+      SwapByteOrderArray(std::span<ValueT>{chunk, n});
+      stream.write(reinterpret_cast<const char*>(chunk), n * sizeof(ValueT));
+    }
+  }
+
+  if (stream.bad())
+    return Error::FromFormatStr("WriteArray() failed: streams badbit got set after write. (steampos = 0x%X) (T = %s) (count = %zu)", stream.tellp(), typeid(T).name(), values.size());
+
+  return {};
+}
+
+//ByteReader overloads of the above. The bounds check happens once per call, so
+//reading several fields with one Read<>(reader, a, b, c) call is cheaper than
+//reading them one by one.
+
+inline Error ReadOutOfBoundsError(const ByteReader& reader, size_t size)
+{
+  return Error::FromFormatStr("Read() failed: tried to read %zu bytes at offset 0x%zX, but only %zu bytes remain", 
+      size, reader.Tell(), reader.Remaining());
+}
+
+//Unchecked, callers have to make sure that reader.CanRead(sizeof(T)) holds
+template <ByteOrder Order = LittleEndian, typename T>
+void ReadUnchecked(ByteReader& reader, T& t)
+{
+  std::memcpy(&t, reader.Data(), sizeof(T));
+  reader.Advance(sizeof(T));
+
+  if (Order != GetHostByteOrder())
+    SwapByteOrder(t);
+}
+
+template <ByteOrder Order = LittleEndian, typename T>
+ErrorOr<void> Read(ByteReader& reader, T& t)
+{
+  if (!reader.CanRead(sizeof(T)))
+    return ReadOutOfBoundsError(reader, sizeof(T));
+
+  ReadUnchecked<Order>(reader, t);
+  return {};
+}
+
+template <ByteOrder Order = LittleEndian, typename... Args>
+ErrorOr<void> Read(ByteReader& reader, Args&... args)
+{
+  constexpr size_t size = (sizeof(Args) + ...);
+
+  if (!reader.CanRead(size))
+    return ReadOutOfBoundsError(reader, size);
+
+  (ReadUnchecked<Order>(reader, args), ...);
+  return {};
+}
+
+template <ByteOrder Order = LittleEndian, typename T, size_t Extent>
+ErrorOr<void> ReadArray(ByteReader& reader, std::span<T, Extent> values)
+{
+  if (!reader.CanRead(values.size_bytes()))
+    return ReadOutOfBoundsError(reader, values.size_bytes());
+
+  //memcpy requires non null pointers, which empty spans / vectors don't guarantee
+  if (values.empty())
+    return {};
+
+  std::memcpy(values.data(), reader.Data(), values.size_bytes());
+  reader.Advance(values.size_bytes());
+
+  if (Order != GetHostByteOrder())
+    SwapByteOrderArray(values);
+
+  return {};
+}
+
+//Replaces the contents of values with count elements read from reader
+template <ByteOrder Order = LittleEndian, typename T>
+ErrorOr<void> ReadArray(ByteReader& reader, std::vector<T>& values, size_t count)
+{
+  if (!reader.CanRead(count * sizeof(T)))
+    return ReadOutOfBoundsError(reader, count * sizeof(T));
+
+  values.resize(count);
+  return ReadArray<Order>(reader, std::span<T>{values});
+}
+
+//Returns a view of the next n bytes without copying them
+inline ErrorOr<void> ReadBytes(ByteReader& reader, size_t n, std::span<const U8>& bytes)
+{
+  if (!reader.CanRead(n))
+    return ReadOutOfBoundsError(reader, n);
+
+  bytes = std::span<const U8>{reader.Data(), n};
+  reader.Advance(n);
+  return {};
+}
+
+inline ErrorOr<void> Skip(ByteReader& reader, size_t n)
+{
+  if (!reader.CanRead(n))
+    return ReadOutOfBoundsError(reader, n);
+
+  reader.Advance(n);
+  return {};
+}
+
+//ByteWriter overloads. These don't check bounds (see ByteWriter), they only
+//return an ErrorOr so the same templated serialization code can target either
+//a std::ostream or a ByteWriter.
+
+template <ByteOrder Order = LittleEndian, typename T>
+ErrorOr<void> Write(ByteWriter& writer, const T& t)
+{
+  T value(t);
+
+  if (Order != GetHostByteOrder())
+    SwapByteOrder(value);
+
+  std::memcpy(writer.Data(), &value, sizeof(T));
+  writer.Advance(sizeof(T));
+
+  return {};
+}
+
+template <ByteOrder Order = LittleEndian, typename... Args>
+ErrorOr<void> Write(ByteWriter& writer, const Args&... args)
+{
+  (Write<Order>(writer, args), ...);
+  return {};
+}
+
+//Copies values into the destination and swaps them there, no temporaries needed
+template <ByteOrder Order = LittleEndian, typename T, size_t Extent>
+ErrorOr<void> WriteArray(ByteWriter& writer, std::span<T, Extent> values)
+{
+  using ValueT = std::remove_const_t<T>;
+
+  if (values.empty())
+    return {};
+
+  U8* dest = writer.Data();
+  writer.Advance(values.size_bytes());
+
+  std::memcpy(dest, values.data(), values.size_bytes());
+
+  if (Order != GetHostByteOrder())
+    SwapByteOrderArray(reinterpret_cast<SwapUnitT<ValueT>*>(dest), values.size_bytes() / sizeof(SwapUnitT<ValueT>));
+
+  return {};
+}
@@ -1,4 +0,0 @@
-#pragma once
-
-#define NAMED_TUPLE(arg) {arg, #arg}
-
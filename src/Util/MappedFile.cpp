@@ -0,0 +1,153 @@
+#include "FileFormats/MappedFile.hpp"
+
+#include <utility>
+
+#if defined(_WIN32)
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <cerrno>
+  #include <cstring>
+#endif
+
+using namespace FileFormats;
+
+#if defined(_WIN32)
+
+ErrorOr<MappedFile> MappedFile::Open(const std::string& path)
+{
+  MappedFile file;
+
+  HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (fileHandle == INVALID_HANDLE_VALUE)
+    return Error::FromFormatStr("MappedFile::Open failed to open \"%s\" (GetLastError = %lu)", path.c_str(), GetLastError());
+
+  file.m_fileHandle = fileHandle;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(fileHandle, &size))
+    return Error::FromFormatStr("MappedFile::Open failed to get size of \"%s\" (GetLastError = %lu)", path.c_str(), GetLastError());
+
+  file.m_size = static_cast<size_t>(size.QuadPart);
+
+  //empty files can't be mapped, they are represented as an empty span instead
+  if (file.m_size == 0)
+    return file;
+
+  HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mappingHandle == nullptr)
+    return Error::FromFormatStr("MappedFile::Open failed to create mapping of \"%s\" (GetLastError = %lu)", path.c_str(), GetLastError());
+
+  file.m_mappingHandle = mappingHandle;
+
+  void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr)
+    return Error::FromFormatStr("MappedFile::Open failed to map \"%s\" (GetLastError = %lu)", path.c_str(), GetLastError());
+
+  file.m_data = static_cast<const U8*>(data);
+  return file;
+}
+
+void MappedFile::Close()
+{
+  if (m_data != nullptr)
+    UnmapViewOfFile(m_data);
+
+  if (m_mappingHandle != nullptr)
+    CloseHandle(m_mappingHandle);
+
+  if (m_fileHandle != nullptr)
+    CloseHandle(m_fileHandle);
+
+  m_data = nullptr;
+  m_size = 0;
+  m_mappingHandle = nullptr;
+  m_fileHandle = nullptr;
+}
+
+#else
+
+ErrorOr<MappedFile> MappedFile::Open(const std::string& path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return Error::FromFormatStr("MappedFile::Open failed to open \"%s\" (%s)", path.c_str(), std::strerror(errno));
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+  {
+    int err = errno;
+    ::close(fd);
+    return Error::FromFormatStr("MappedFile::Open failed to stat \"%s\" (%s)", path.c_str(), std::strerror(err));
+  }
+
+  MappedFile file;
+  file.m_size = static_cast<size_t>(st.st_size);
+
+  //empty files can't be mapped, they are represented as an empty span instead
+  if (file.m_size == 0)
+  {
+    ::close(fd);
+    return file;
+  }
+
+  void* data = ::mmap(nullptr, file.m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int err = errno;
+
+  //the mapping keeps its own reference to the file
+  ::close(fd);
+
+  if (data == MAP_FAILED)
+  {
+    file.m_size = 0;
+    return Error::FromFormatStr("MappedFile::Open failed to map \"%s\" (%s)", path.c_str(), std::strerror(err));
+  }
+
+  file.m_data = static_cast<const U8*>(data);
+  return file;
+}
+
+void MappedFile::Close()
+{
+  if (m_data != nullptr)
+    ::munmap(const_cast<U8*>(m_data), m_size);
+
+  m_data = nullptr;
+  m_size = 0;
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this == &other)
+    return *this;
+
+  this->Close();
+
+  m_data = std::exchange(other.m_data, nullptr);
+  m_size = std::exchange(other.m_size, 0);
+
+#if defined(_WIN32)
+  m_fileHandle = std::exchange(other.m_fileHandle, nullptr);
+  m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+#endif
+
+  return *this;
+}
+
+MappedFile::~MappedFile()
+{
+  this->Close();
+}
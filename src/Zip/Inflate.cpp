@@ -0,0 +1,428 @@
+#include "FileFormats/Zip/Inflate.hpp"
+
+#include "Util/Error.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace FileFormats;
+using namespace FileFormats::Zip;
+
+static constexpr int MaxCodeBits = 15;
+static constexpr int FastBits = 10;
+
+static constexpr U16 lengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static constexpr U8 lengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static constexpr U16 distBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static constexpr U8 distExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+//order in which the code length code lengths are stored
+static constexpr U8 codeLengthOrder[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+namespace
+{
+
+//Canonical huffman code. Codes up to FastBits long are decoded with a single
+//table lookup, longer ones by walking the per length counts.
+struct Huffman
+{
+  //(symbol << 4) | length, 0 if the code is longer than FastBits / unused
+  U16 Fast[1 << FastBits];
+
+  U16 Count[MaxCodeBits + 1];
+  U16 Symbols[288];
+};
+
+} //namespace
+
+static U32 reverseBits(U32 code, int length)
+{
+  U32 reversed = 0;
+
+  for (int i = 0; i < length; i++)
+  {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+
+  return reversed;
+}
+
+static ErrorOr<void> buildHuffman(Huffman& huffman, const U8* lengths, int symbolCount)
+{
+  std::memset(huffman.Count, 0, sizeof(huffman.Count));
+  std::memset(huffman.Fast, 0, sizeof(huffman.Fast));
+
+  for (int symbol = 0; symbol < symbolCount; symbol++)
+    huffman.Count[ lengths[symbol] ]++;
+
+  huffman.Count[0] = 0;
+
+  //incomplete codes are allowed (e.g. a single distance code), decoding an
+  //unused code fails though
+  int left = 1;
+  for (int length = 1; length <= MaxCodeBits; length++)
+  {
+    left = (left << 1) - huffman.Count[length];
+    if (left < 0)
+      return Error::FromLiteralStr("Inflate encountered an over-subscribed huffman code");
+  }
+
+  U16 offsets[MaxCodeBits + 2];
+  U32 nextCode[MaxCodeBits + 1];
+
+  offsets[1] = 0;
+  nextCode[0] = 0;
+
+  U32 code = 0;
+  for (int length = 1; length <= MaxCodeBits; length++)
+  {
+    offsets[length + 1] = offsets[length] + huffman.Count[length];
+
+    code = (code + huffman.Count[length - 1]) << 1;
+    nextCode[length] = code;
+  }
+
+  for (int symbol = 0; symbol < symbolCount; symbol++)
+  {
+    int length = lengths[symbol];
+    if (length == 0)
+      continue;
+
+    huffman.Symbols[ offsets[length]++ ] = static_cast<U16>(symbol);
+
+    U32 symbolCode = nextCode[length]++;
+
+    if (length <= FastBits)
+    {
+      U16 entry = static_cast<U16>((symbol << 4) | length);
+
+      //codes are read LSB first, fill every entry that starts with this code
+      for (U32 i = reverseBits(symbolCode, length); i < (1u << FastBits); i += (1u << length))
+        huffman.Fast[i] = entry;
+    }
+  }
+
+  return {};
+}
+
+namespace
+{
+
+class BitReader
+{
+  public:
+    BitReader(std::span<const U8> bytes) : m_bytes{bytes} {}
+
+    //Past the end of the input zeros are shifted in, Overrun() tells if any of
+    //them got consumed.
+    void Refill()
+    {
+      while (m_bitCount <= 56)
+      {
+        U64 byte = m_pos < m_bytes.size() ? m_bytes[m_pos] : 0;
+        m_pos++;
+
+        m_bits |= byte << m_bitCount;
+        m_bitCount += 8;
+      }
+    }
+
+    U32 Peek(int count) const { return static_cast<U32>(m_bits & ((U64{1} << count) - 1)); }
+
+    void Consume(int count)
+    {
+      m_bits >>= count;
+      m_bitCount -= count;
+    }
+
+    U32 Get(int count)
+    {
+      if (m_bitCount < count)
+        this->Refill();
+
+      U32 value = this->Peek(count);
+      this->Consume(count);
+
+      return value;
+    }
+
+    //Drops the bits up to the next byte boundary and returns the position of
+    //that byte. The reader has to be Seek()'d before reading bits again.
+    size_t AlignToByte()
+    {
+      this->Consume(m_bitCount % 8);
+      return m_pos - m_bitCount / 8;
+    }
+
+    void Seek(size_t pos)
+    {
+      m_pos = pos;
+      m_bits = 0;
+      m_bitCount = 0;
+    }
+
+    bool Overrun() const { return m_pos * 8 - m_bitCount > m_bytes.size() * 8; }
+
+  private:
+    std::span<const U8> m_bytes;
+    size_t m_pos{0};
+
+    U64 m_bits{0};
+    int m_bitCount{0};
+};
+
+} //namespace
+
+//-1 on an invalid code
+static int decodeSymbol(BitReader& reader, const Huffman& huffman)
+{
+  reader.Refill();
+
+  U16 entry = huffman.Fast[ reader.Peek(FastBits) ];
+  if (entry != 0)
+  {
+    reader.Consume(entry & 0xF);
+    return entry >> 4;
+  }
+
+  //walk the canonical code one bit at a time
+  U32 bits = reader.Peek(MaxCodeBits);
+  int code = 0, first = 0, index = 0;
+
+  for (int length = 1; length <= MaxCodeBits; length++)
+  {
+    code |= (bits >> (length - 1)) & 1;
+    int count = huffman.Count[length];
+
+    if (code - count < first)
+    {
+      reader.Consume(length);
+      return huffman.Symbols[ index + (code - first) ];
+    }
+
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+
+  return -1;
+}
+
+static ErrorOr<void> readDynamicTables(BitReader& reader, Huffman& literals, Huffman& distances)
+{
+  int literalCount  = reader.Get(5) + 257;
+  int distanceCount = reader.Get(5) + 1;
+  int codeLengthCount = reader.Get(4) + 4;
+
+  if (literalCount > 286 || distanceCount > 30)
+    return Error::FromLiteralStr("Inflate encountered too many literal / distance codes");
+
+  U8 lengths[286 + 30] = {};
+
+  for (int i = 0; i < codeLengthCount; i++)
+    lengths[ codeLengthOrder[i] ] = static_cast<U8>(reader.Get(3));
+
+  Huffman codeLengths;
+  TRY(buildHuffman(codeLengths, lengths, 19));
+
+  std::memset(lengths, 0, 19);
+
+  int total = literalCount + distanceCount;
+  for (int i = 0; i < total; )
+  {
+    int symbol = decodeSymbol(reader, codeLengths);
+    if (symbol < 0)
+      return Error::FromLiteralStr("Inflate encountered an invalid code length code");
+
+    if (symbol < 16)
+    {
+      lengths[i++] = static_cast<U8>(symbol);
+      continue;
+    }
+
+    U8 value = 0;
+    int repeat;
+
+    if (symbol == 16)
+    {
+      if (i == 0)
+        return Error::FromLiteralStr("Inflate encountered a repeat code without a previous length");
+
+      value = lengths[i - 1];
+      repeat = 3 + reader.Get(2);
+    }
+    else if (symbol == 17)
+      repeat = 3 + reader.Get(3);
+    else
+      repeat = 11 + reader.Get(7);
+
+    if (i + repeat > total)
+      return Error::FromLiteralStr("Inflate encountered code lengths exceeding the code count");
+
+    std::memset(lengths + i, value, repeat);
+    i += repeat;
+  }
+
+  if (lengths[256] == 0)
+    return Error::FromLiteralStr("Inflate encountered a block without an end of block code");
+
+  TRY(buildHuffman(literals, lengths, literalCount));
+  TRY(buildHuffman(distances, lengths + literalCount, distanceCount));
+
+  return {};
+}
+
+static const Huffman& getFixedLiterals()
+{
+  static const Huffman fixed = []()
+  {
+    U8 lengths[288];
+    std::fill(lengths,       lengths + 144, U8{8});
+    std::fill(lengths + 144, lengths + 256, U8{9});
+    std::fill(lengths + 256, lengths + 280, U8{7});
+    std::fill(lengths + 280, lengths + 288, U8{8});
+
+    Huffman huffman;
+    buildHuffman(huffman, lengths, 288);
+    return huffman;
+  }();
+
+  return fixed;
+}
+
+static const Huffman& getFixedDistances()
+{
+  static const Huffman fixed = []()
+  {
+    U8 lengths[30];
+    std::fill(lengths, lengths + 30, U8{5});
+
+    Huffman huffman;
+    buildHuffman(huffman, lengths, 30);
+    return huffman;
+  }();
+
+  return fixed;
+}
+
+static ErrorOr<void> inflateBlock(BitReader& reader, const Huffman& literals,
+    const Huffman& distances, std::span<U8> out, size_t& outPos)
+{
+  while (true)
+  {
+    int symbol = decodeSymbol(reader, literals);
+
+    if (symbol < 0)
+      return Error::FromLiteralStr("Inflate encountered an invalid literal / length code");
+
+    if (symbol < 256)
+    {
+      if (outPos >= out.size())
+        return Error::FromLiteralStr("Inflate ran out of output space");
+
+      out[outPos++] = static_cast<U8>(symbol);
+      continue;
+    }
+
+    if (symbol == 256)
+      return {};
+
+    symbol -= 257;
+    if (symbol >= 29)
+      return Error::FromLiteralStr("Inflate encountered an invalid length code");
+
+    size_t length = lengthBase[symbol] + reader.Get(lengthExtra[symbol]);
+
+    int distanceSymbol = decodeSymbol(reader, distances);
+    if (distanceSymbol < 0 || distanceSymbol >= 30)
+      return Error::FromLiteralStr("Inflate encountered an invalid distance code");
+
+    size_t distance = distBase[distanceSymbol] + reader.Get(distExtra[distanceSymbol]);
+
+    if (distance > outPos)
+      return Error::FromLiteralStr("Inflate encountered a distance reaching before the start of the output");
+
+    if (length > out.size() - outPos)
+      return Error::FromLiteralStr("Inflate ran out of output space");
+
+    //the ranges overlap if distance < length, so this has to go forwards
+    U8* dst = out.data() + outPos;
+    const U8* src = dst - distance;
+
+    for (size_t i = 0; i < length; i++)
+      dst[i] = src[i];
+
+    outPos += length;
+
+    if (reader.Overrun())
+      return Error::FromLiteralStr("Inflate ran past the end of the compressed data");
+  }
+}
+
+ErrorOr<size_t> FileFormats::Zip::Inflate(std::span<const U8> compressed, std::span<U8> out)
+{
+  BitReader reader{compressed};
+  size_t outPos = 0;
+
+  bool lastBlock;
+  do
+  {
+    lastBlock = reader.Get(1);
+    U32 type = reader.Get(2);
+
+    if (type == 0)
+    {
+      size_t pos = reader.AlignToByte();
+
+      if (pos + 4 > compressed.size())
+        return Error::FromLiteralStr("Inflate ran past the end of the compressed data");
+
+      U16 length = static_cast<U16>(compressed[pos] | (compressed[pos + 1] << 8));
+      U16 lengthComplement = static_cast<U16>(compressed[pos + 2] | (compressed[pos + 3] << 8));
+      pos += 4;
+
+      if (length != static_cast<U16>(~lengthComplement))
+        return Error::FromLiteralStr("Inflate encountered a stored block with a corrupt length");
+
+      if (length > compressed.size() - pos)
+        return Error::FromLiteralStr("Inflate ran past the end of the compressed data");
+
+      if (length > out.size() - outPos)
+        return Error::FromLiteralStr("Inflate ran out of output space");
+
+      if (length != 0)
+        std::memcpy(out.data() + outPos, compressed.data() + pos, length);
+
+      outPos += length;
+      reader.Seek(pos + length);
+    }
+    else if (type == 1)
+    {
+      TRY(inflateBlock(reader, getFixedLiterals(), getFixedDistances(), out, outPos));
+    }
+    else if (type == 2)
+    {
+      Huffman literals, distances;
+      TRY(readDynamicTables(reader, literals, distances));
+      TRY(inflateBlock(reader, literals, distances, out, outPos));
+    }
+    else
+      return Error::FromLiteralStr("Inflate encountered an invalid block type");
+
+    if (reader.Overrun())
+      return Error::FromLiteralStr("Inflate ran past the end of the compressed data");
+  }
+  while (!lastBlock);
+
+  return outPos;
+}
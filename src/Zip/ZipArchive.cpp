@@ -0,0 +1,337 @@
+#include "FileFormats/Zip/ZipArchive.hpp"
+#include "FileFormats/Zip/Inflate.hpp"
+
+#include "Util/IO.hpp"
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <array>
+
+using namespace FileFormats;
+using namespace FileFormats::Zip;
+
+static constexpr U32 LocalHeaderSignature       = 0x04034B50;
+static constexpr U32 CentralHeaderSignature     = 0x02014B50;
+static constexpr U32 EndOfDirSignature          = 0x06054B50;
+static constexpr U32 Zip64EndOfDirSignature     = 0x06064B50;
+static constexpr U32 Zip64EndOfDirLocatorSignature = 0x07064B50;
+
+static constexpr size_t EndOfDirSize = 22;
+static constexpr size_t Zip64EndOfDirLocatorSize = 20;
+
+static constexpr U16 Zip64ExtraFieldId = 0x0001;
+
+//DEFLATE can't compress better than ~1032:1 (258 byte matches coded in 2
+//bits), so entries claiming more are corrupt. Checked before allocating the
+//output, so their sizes can't cause huge allocations.
+static constexpr U64 MaxDeflateRatio = 1032;
+
+static constexpr std::array<U32, 256> makeCRC32Table()
+{
+  std::array<U32, 256> table{};
+
+  for (U32 i = 0; i < 256; i++)
+  {
+    U32 crc = i;
+
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+
+    table[i] = crc;
+  }
+
+  return table;
+}
+
+static constexpr std::array<U32, 256> CRC32Table = makeCRC32Table();
+
+//CRC-32 as used by zip (reflected, polynomial 0x04C11DB7)
+static U32 computeCRC32(std::span<const U8> bytes)
+{
+  U32 crc = 0xFFFFFFFF;
+
+  for (U8 byte : bytes)
+    crc = CRC32Table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+ErrorOr<ZipArchive> ZipArchive::Open(const std::string& path)
+{
+  auto errOrFile = MappedFile::Open(path);
+  VERIFY(errOrFile);
+
+  ZipArchive archive;
+  archive.m_file.emplace(errOrFile.Release());
+  archive.m_bytes = archive.m_file->GetBytes();
+
+  TRY(archive.ReadCentralDirectory());
+  return archive;
+}
+
+ErrorOr<ZipArchive> ZipArchive::FromBytes(std::span<const U8> bytes)
+{
+  ZipArchive archive;
+  archive.m_bytes = bytes;
+
+  TRY(archive.ReadCentralDirectory());
+  return archive;
+}
+
+struct EndOfDir
+{
+  U64 EntryCount;
+  U64 DirSize;
+  U64 DirOffset;
+};
+
+static ErrorOr<EndOfDir> readZip64EndOfDir(std::span<const U8> bytes, size_t endOfDirPos)
+{
+  if (endOfDirPos < Zip64EndOfDirLocatorSize)
+    return Error::FromLiteralStr("ZipArchive is missing the zip64 end of central directory locator");
+
+  ByteReader locator{ bytes.subspan(endOfDirPos - Zip64EndOfDirLocatorSize) };
+
+  U32 signature, disk, diskCount;
+  U64 offset;
+  TRY(Read<LittleEndian>(locator, signature, disk, offset, diskCount));
+
+  if (signature != Zip64EndOfDirLocatorSignature)
+    return Error::FromLiteralStr("ZipArchive is missing the zip64 end of central directory locator");
+
+  if (offset >= bytes.size())
+    return Error::FromFormatStr("ZipArchive zip64 end of central directory offset 0x%llX is out of bounds",
+        static_cast<unsigned long long>(offset));
+
+  ByteReader reader{ bytes.subspan(offset) };
+
+  U64 recordSize, entryCountOnDisk;
+  U16 versionMadeBy, versionNeeded;
+  U32 diskNumber, dirDisk;
+  EndOfDir endOfDir;
+
+  TRY(Read<LittleEndian>(reader, signature, recordSize, versionMadeBy, versionNeeded,
+                                 diskNumber, dirDisk, entryCountOnDisk,
+                                 endOfDir.EntryCount, endOfDir.DirSize, endOfDir.DirOffset));
+
+  if (signature != Zip64EndOfDirSignature)
+    return Error::FromLiteralStr("ZipArchive zip64 end of central directory has an invalid signature");
+
+  return endOfDir;
+}
+
+static ErrorOr<EndOfDir> readEndOfDir(std::span<const U8> bytes)
+{
+  if (bytes.size() < EndOfDirSize)
+    return Error::FromLiteralStr("ZipArchive is too small to be a zip archive");
+
+  //the record is followed by a comment of up to 64KB, so search backwards
+  size_t lowest = bytes.size() - std::min(bytes.size(), EndOfDirSize + 0xFFFF);
+
+  for (size_t pos = bytes.size() - EndOfDirSize + 1; pos-- > lowest; )
+  {
+    U32 candidate = bytes[pos] | (bytes[pos + 1] << 8) | (bytes[pos + 2] << 16) | (static_cast<U32>(bytes[pos + 3]) << 24);
+    if (candidate != EndOfDirSignature)
+      continue;
+
+    ByteReader reader{ bytes.subspan(pos) };
+
+    U32 signature, dirSize, dirOffset;
+    U16 disk, dirDisk, entryCountOnDisk, entryCount, commentLength;
+
+    TRY(Read<LittleEndian>(reader, signature, disk, dirDisk, entryCountOnDisk,
+                                   entryCount, dirSize, dirOffset, commentLength));
+
+    if (entryCount == 0xFFFF || dirSize == 0xFFFFFFFF || dirOffset == 0xFFFFFFFF)
+      return readZip64EndOfDir(bytes, pos);
+
+    return EndOfDir{ entryCount, dirSize, dirOffset };
+  }
+
+  return Error::FromLiteralStr("ZipArchive is missing the end of central directory record");
+}
+
+//replaces the 32 bit fields set to 0xFFFFFFFF by their 64 bit value
+static ErrorOr<void> readZip64Extra(std::span<const U8> extra, ZipEntry& entry)
+{
+  ByteReader reader{extra};
+
+  while (reader.Remaining() >= 4)
+  {
+    U16 id, size;
+    TRY(Read<LittleEndian>(reader, id, size));
+
+    std::span<const U8> field;
+    TRY(ReadBytes(reader, size, field));
+
+    if (id != Zip64ExtraFieldId)
+      continue;
+
+    ByteReader fieldReader{field};
+
+    if (entry.UncompressedSize == 0xFFFFFFFF)
+      TRY(Read<LittleEndian>(fieldReader, entry.UncompressedSize));
+    if (entry.CompressedSize == 0xFFFFFFFF)
+      TRY(Read<LittleEndian>(fieldReader, entry.CompressedSize));
+    if (entry.LocalHeaderOffset == 0xFFFFFFFF)
+      TRY(Read<LittleEndian>(fieldReader, entry.LocalHeaderOffset));
+
+    break;
+  }
+
+  return {};
+}
+
+ErrorOr<void> ZipArchive::ReadCentralDirectory()
+{
+  auto errOrEndOfDir = readEndOfDir(m_bytes);
+  VERIFY(errOrEndOfDir);
+
+  EndOfDir endOfDir = errOrEndOfDir.Get();
+
+  if (endOfDir.DirOffset > m_bytes.size() || endOfDir.DirSize > m_bytes.size() - endOfDir.DirOffset)
+    return Error::FromLiteralStr("ZipArchive central directory is out of bounds");
+
+  ByteReader reader{ m_bytes.subspan(endOfDir.DirOffset, endOfDir.DirSize) };
+
+  //every header is at least 46 bytes, don't trust the count for reserving
+  m_entries.reserve( std::min<U64>(endOfDir.EntryCount, endOfDir.DirSize / 46) );
+
+  for (U64 i = 0; i < endOfDir.EntryCount; i++)
+  {
+    U32 signature, crc32, compressedSize, uncompressedSize, externalAttributes, localHeaderOffset;
+    U16 versionMadeBy, versionNeeded, flags, method, time, date;
+    U16 nameLength, extraLength, commentLength, diskStart, internalAttributes;
+
+    TRY(Read<LittleEndian>(reader, signature, versionMadeBy, versionNeeded, flags, method,
+                                   time, date, crc32, compressedSize, uncompressedSize,
+                                   nameLength, extraLength, commentLength, diskStart,
+                                   internalAttributes, externalAttributes, localHeaderOffset));
+
+    if (signature != CentralHeaderSignature)
+      return Error::FromFormatStr("ZipArchive central directory header %llu has an invalid signature",
+          static_cast<unsigned long long>(i));
+
+    std::span<const U8> name, extra, comment;
+    TRY(ReadBytes(reader, nameLength, name));
+    TRY(ReadBytes(reader, extraLength, extra));
+    TRY(ReadBytes(reader, commentLength, comment));
+
+    ZipEntry entry;
+    entry.Name = { reinterpret_cast<const char*>(name.data()), name.size() };
+    entry.CompressionMethod = static_cast<ZipEntry::Method>(method);
+    entry.Flags = flags;
+    entry.CRC32 = crc32;
+    entry.CompressedSize = compressedSize;
+    entry.UncompressedSize = uncompressedSize;
+    entry.LocalHeaderOffset = localHeaderOffset;
+
+    TRY(readZip64Extra(extra, entry));
+
+    m_entries.push_back(entry);
+  }
+
+  return {};
+}
+
+const ZipEntry* ZipArchive::FindEntry(std::string_view name) const
+{
+  auto itr = std::find_if(m_entries.begin(), m_entries.end(),
+      [&](const ZipEntry& entry) { return entry.Name == name; });
+
+  return itr != m_entries.end() ? &*itr : nullptr;
+}
+
+ErrorOr< std::span<const U8> > ZipArchive::GetCompressedData(const ZipEntry& entry) const
+{
+  if (entry.LocalHeaderOffset > m_bytes.size())
+    return Error::FromFormatStr("ZipArchive local header of \"%.*s\" is out of bounds",
+        static_cast<int>(entry.Name.size()), entry.Name.data());
+
+  ByteReader reader{ m_bytes.subspan(entry.LocalHeaderOffset) };
+
+  //the sizes in the local header may be deferred to a data descriptor, so
+  //only the name & extra field lengths are taken from it
+  U32 signature, crc32, compressedSize, uncompressedSize;
+  U16 versionNeeded, flags, method, time, date, nameLength, extraLength;
+
+  TRY(Read<LittleEndian>(reader, signature, versionNeeded, flags, method, time, date,
+                                 crc32, compressedSize, uncompressedSize, nameLength, extraLength));
+
+  if (signature != LocalHeaderSignature)
+    return Error::FromFormatStr("ZipArchive local header of \"%.*s\" has an invalid signature",
+        static_cast<int>(entry.Name.size()), entry.Name.data());
+
+  if (!reader.CanRead(static_cast<size_t>(nameLength) + extraLength))
+    return Error::FromFormatStr("ZipArchive local header of \"%.*s\" is truncated",
+        static_cast<int>(entry.Name.size()), entry.Name.data());
+
+  reader.Advance(static_cast<size_t>(nameLength) + extraLength);
+
+  if (entry.CompressedSize > reader.Remaining())
+    return Error::FromFormatStr("ZipArchive data of \"%.*s\" is out of bounds",
+        static_cast<int>(entry.Name.size()), entry.Name.data());
+
+  return std::span<const U8>{ reader.Data(), static_cast<size_t>(entry.CompressedSize) };
+}
+
+ErrorOr< std::span<const U8> > ZipArchive::GetData(const ZipEntry& entry, std::vector<U8>& buffer) const
+{
+  if (entry.IsEncrypted())
+    return Error::FromFormatStr("ZipArchive entry \"%.*s\" is encrypted",
+        static_cast<int>(entry.Name.size()), entry.Name.data());
+
+  auto errOrData = this->GetCompressedData(entry);
+  VERIFY(errOrData);
+
+  std::span<const U8> data = errOrData.Get();
+
+  switch(entry.CompressionMethod)
+  {
+    case ZipEntry::Method::Stored:
+    {
+      if (entry.UncompressedSize != data.size())
+        return Error::FromFormatStr("ZipArchive stored entry \"%.*s\" has mismatching sizes",
+            static_cast<int>(entry.Name.size()), entry.Name.data());
+
+      return data;
+    }
+
+    case ZipEntry::Method::Deflated:
+    {
+      if (entry.UncompressedSize > data.size() * MaxDeflateRatio)
+        return Error::FromFormatStr("ZipArchive entry \"%.*s\" claims to inflate %zu to %llu bytes, more than DEFLATE can",
+            static_cast<int>(entry.Name.size()), entry.Name.data(), data.size(),
+            static_cast<unsigned long long>(entry.UncompressedSize));
+
+      if (buffer.size() < entry.UncompressedSize)
+        buffer.resize(entry.UncompressedSize);
+
+      std::span<U8> out{ buffer.data(), static_cast<size_t>(entry.UncompressedSize) };
+
+      auto errOrSize = Inflate(data, out);
+      VERIFY(errOrSize);
+
+      if (errOrSize.Get() != entry.UncompressedSize)
+        return Error::FromFormatStr("ZipArchive entry \"%.*s\" inflated to %zu instead of %llu bytes",
+            static_cast<int>(entry.Name.size()), entry.Name.data(), errOrSize.Get(),
+            static_cast<unsigned long long>(entry.UncompressedSize));
+
+      U32 crc = computeCRC32(out);
+      if (crc != entry.CRC32)
+        return Error::FromFormatStr("ZipArchive entry \"%.*s\" has CRC-32 0x%08X instead of 0x%08X after inflating",
+            static_cast<int>(entry.Name.size()), entry.Name.data(), crc, entry.CRC32);
+
+      return std::span<const U8>{out};
+    }
+  }
+
+  return Error::FromFormatStr("ZipArchive entry \"%.*s\" uses unsupported compression method %u",
+      static_cast<int>(entry.Name.size()), entry.Name.data(), static_cast<unsigned int>(entry.CompressionMethod));
+}
+
+ErrorOr< std::span<const U8> > ZipArchive::GetData(const ZipEntry& entry) const
+{
+  static thread_local std::vector<U8> buffer;
+  return this->GetData(entry, buffer);
+}